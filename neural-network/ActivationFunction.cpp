@@ -0,0 +1,107 @@
+﻿#include "ActivationFunction.h"
+#include "Kernels.h"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    std::atomic<bool> useApproximations{ false };
+
+    template <typename Scalar>
+    void softmax(const Scalar* inputs, Scalar* outputs, size_t count)
+    {
+        if (count == 0)
+            return;
+
+        // Shift the inputs so the largest is 0. Doesn't change the result, and the exponentials can't overflow.
+        const Scalar largest = *std::max_element(inputs, inputs + count);
+        for (size_t i = 0; i < count; i++)
+            outputs[i] = inputs[i] - largest;
+
+        if (useApproximations.load(std::memory_order_relaxed))
+            Kernels::expApprox(outputs, outputs, count);
+        else
+        {
+            for (size_t i = 0; i < count; i++)
+                outputs[i] = std::exp(outputs[i]);
+        }
+
+        Scalar sum = 0;
+        for (size_t i = 0; i < count; i++)
+            sum += outputs[i];
+
+        const Scalar inverseSum = 1 / sum;
+        for (size_t i = 0; i < count; i++)
+            outputs[i] *= inverseSum;
+    }
+}
+
+template <typename Scalar>
+void activate(ActiviationFunction activationFunction, const Scalar* inputs, Scalar* outputs, size_t count)
+{
+    if (useApproximations.load(std::memory_order_relaxed))
+    {
+        if (activationFunction == Sigmoid)
+        {
+            Kernels::sigmoidApprox(inputs, outputs, count);
+            return;
+        }
+        if (activationFunction == Tanh)
+        {
+            Kernels::tanhApprox(inputs, outputs, count);
+            return;
+        }
+    }
+
+    if (activationFunction == Softmax)
+    {
+        softmax(inputs, outputs, count);
+        return;
+    }
+
+    dispatchActivation(activationFunction, [&](auto activation)
+    {
+        for (size_t i = 0; i < count; i++)
+            outputs[i] = activation.activate(inputs[i]);
+    });
+}
+
+template <typename Scalar>
+void activateRows(ActiviationFunction activationFunction, const Scalar* inputs, Scalar* outputs, size_t numRows, size_t rowSize)
+{
+    if (isElementWise(activationFunction))
+    {
+        activate(activationFunction, inputs, outputs, numRows * rowSize);
+        return;
+    }
+
+    for (size_t row = 0; row < numRows; row++)
+        activate(activationFunction, inputs + row * rowSize, outputs + row * rowSize, rowSize);
+}
+
+template <typename Scalar>
+void multiplyByDerivative(ActiviationFunction activationFunction, const Scalar* outputs, Scalar* gradients, size_t count)
+{
+    dispatchActivation(activationFunction, [&](auto activation)
+    {
+        for (size_t i = 0; i < count; i++)
+            gradients[i] *= activation.derivative(outputs[i]);
+    });
+}
+
+void useApproximateActivations(bool approximate)
+{
+    useApproximations.store(approximate);
+}
+
+bool approximateActivations()
+{
+    return useApproximations.load();
+}
+
+template void activate<float>(ActiviationFunction activationFunction, const float* inputs, float* outputs, size_t count);
+template void activate<double>(ActiviationFunction activationFunction, const double* inputs, double* outputs, size_t count);
+template void activateRows<float>(ActiviationFunction activationFunction, const float* inputs, float* outputs, size_t numRows, size_t rowSize);
+template void activateRows<double>(ActiviationFunction activationFunction, const double* inputs, double* outputs, size_t numRows, size_t rowSize);
+template void multiplyByDerivative<float>(ActiviationFunction activationFunction, const float* outputs, float* gradients, size_t count);
+template void multiplyByDerivative<double>(ActiviationFunction activationFunction, const double* outputs, double* gradients, size_t count);
@@ -1,8 +1,170 @@
 ﻿#pragma once
 
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
 enum ActiviationFunction
 {
     Sigmoid,
     ReLU,
-    Tanh
-};
\ No newline at end of file
+    Tanh,
+    // Output layer only. Normalizes the layer's outputs into probabilities that sum to 1, and trains on the
+    // cross-entropy loss instead of the mean squared error.
+    Softmax
+};
+
+/*
+ * Every activation function as a compile-time policy: activate(x) and derivative(y), where y is the
+ * activated output. dispatchActivation switches on the function once and hands the policy to a template,
+ * so loops over a whole layer are branch-free and the compiler can vectorize them.
+ */
+struct SigmoidActivation
+{
+    template <typename Scalar>
+    static Scalar activate(Scalar input) { return 1 / (1 + std::exp(-input)); }
+    template <typename Scalar>
+    static Scalar derivative(Scalar output) { return output * (1 - output); }
+};
+
+struct ReLUActivation
+{
+    template <typename Scalar>
+    static Scalar activate(Scalar input) { return input > 0 ? input : 0; }
+    template <typename Scalar>
+    static Scalar derivative(Scalar output) { return output > 0 ? 1 : 0; }
+};
+
+struct TanhActivation
+{
+    template <typename Scalar>
+    static Scalar activate(Scalar input) { return std::tanh(input); }
+    template <typename Scalar>
+    static Scalar derivative(Scalar output) { return 1 - output * output; }
+};
+
+/*
+ * Softmax isn't element-wise: activate only gives the unnormalized e^x, the range version of activate divides
+ * by the sum. With the cross-entropy loss, the gradient at the softmax inputs is simply target - output,
+ * so the derivative is 1.
+ */
+struct SoftmaxActivation
+{
+    template <typename Scalar>
+    static Scalar activate(Scalar input) { return std::exp(input); }
+    template <typename Scalar>
+    static Scalar derivative(Scalar) { return 1; }
+};
+
+/**
+ * \brief The policy of an activation function known at compile time, ActivationPolicy<Tanh>::type is TanhActivation.
+ */
+template <ActiviationFunction activationFunction>
+struct ActivationPolicy;
+
+template <>
+struct ActivationPolicy<Sigmoid> { using type = SigmoidActivation; };
+template <>
+struct ActivationPolicy<ReLU> { using type = ReLUActivation; };
+template <>
+struct ActivationPolicy<Tanh> { using type = TanhActivation; };
+template <>
+struct ActivationPolicy<Softmax> { using type = SoftmaxActivation; };
+
+/**
+ * \brief Call function with the policy (SigmoidActivation, ReLUActivation, TanhActivation or SoftmaxActivation)
+ * of the given activation function.
+ */
+template <typename Function>
+inline void dispatchActivation(ActiviationFunction activationFunction, const Function& function)
+{
+    switch (activationFunction)
+    {
+    case Sigmoid:
+        function(SigmoidActivation());
+        break;
+    case ReLU:
+        function(ReLUActivation());
+        break;
+    case Tanh:
+        function(TanhActivation());
+        break;
+    case Softmax:
+        function(SoftmaxActivation());
+        break;
+    default:
+        std::cerr << "dispatchActivation: Unknown activation function.\n";
+        break;
+    }
+}
+
+/**
+ * \brief Calculates the activation amount for a neuron.
+ * \param activationFunction Which activation function to apply.
+ * \param input The summed input to the neuron.
+ * \return The activation amount.
+ */
+template <typename Scalar>
+inline Scalar activate(ActiviationFunction activationFunction, Scalar input)
+{
+    Scalar output = 0;
+    dispatchActivation(activationFunction, [&](auto activation) { output = activation.activate(input); });
+    return output;
+}
+
+/**
+ * \brief Calculates the derivative of the activation function for a neuron.
+ * \param activationFunction Which activation function was applied.
+ * \param input The activated output from the neuron.
+ * \return The derivative, expressed in terms of the activated output.
+ */
+template <typename Scalar>
+inline Scalar activateDerivative(ActiviationFunction activationFunction, Scalar input)
+{
+    Scalar derivative = 0;
+    dispatchActivation(activationFunction, [&](auto activation) { derivative = activation.derivative(input); });
+    return derivative;
+}
+
+/**
+ * \return False for Softmax, which needs the whole layer at once and can't be applied to a slice of the neurons.
+ */
+inline bool isElementWise(ActiviationFunction activationFunction)
+{
+    return activationFunction != Softmax;
+}
+
+/**
+ * \brief Apply the activation function to a whole layer, outputs[i] = f(inputs[i]).
+ * Sigmoid, tanh and the exponentials of softmax use the SIMD polynomial approximations from the kernels
+ * if useApproximateActivations is on, libm otherwise. ReLU is always exact.
+ * \param inputs The summed inputs to the neurons.
+ * \param outputs Receives the activation amounts. Can be the same array as inputs.
+ * \param count The number of neurons.
+ */
+template <typename Scalar>
+void activate(ActiviationFunction activationFunction, const Scalar* inputs, Scalar* outputs, size_t count);
+
+/**
+ * \brief Apply the activation function to numRows layers' worth of values, one row of rowSize values per sample.
+ * Same as activate over all of them, except that softmax normalizes every row on its own.
+ */
+template <typename Scalar>
+void activateRows(ActiviationFunction activationFunction, const Scalar* inputs, Scalar* outputs, size_t numRows, size_t rowSize);
+
+/**
+ * \brief gradients[i] *= f'(outputs[i]) for a whole layer, with the derivative expressed in terms of the activated outputs.
+ */
+template <typename Scalar>
+void multiplyByDerivative(ActiviationFunction activationFunction, const Scalar* outputs, Scalar* gradients, size_t count);
+
+/**
+ * \brief Choose between exact (libm) sigmoid and tanh and the faster SIMD polynomial approximations
+ * (see Kernels::KernelTable for their maximum error). Applies to every network. Exact by default.
+ */
+void useApproximateActivations(bool approximate);
+
+/**
+ * \return Whether the layers use the approximate sigmoid and tanh.
+ */
+bool approximateActivations();
@@ -0,0 +1,145 @@
+﻿#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <malloc.h>
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef NN_COUNT_ALLOCATIONS
+
+namespace
+{
+    std::atomic<size_t> allocationCount{ 0 };
+}
+
+// Replacements for the global allocation functions. The nothrow versions aren't replaced, they call these.
+// The aligned ones are, std::pmr::new_delete_resource (the heap for the buffers of networks without an Arena)
+// allocates through them.
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    if (void* memory = _aligned_malloc(size == 0 ? 1 : size, (size_t)alignment))
+        return memory;
+#else
+    // aligned_alloc takes whole multiples of the alignment only
+    const size_t multiple = (size_t)alignment;
+    if (void* memory = std::aligned_alloc(multiple, (std::max<size_t>(size, 1) + multiple - 1) / multiple * multiple))
+        return memory;
+#endif
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
+
+#endif
+
+namespace AllocationCounter
+{
+    bool enabled()
+    {
+#ifdef NN_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    size_t allocations()
+    {
+#ifdef NN_COUNT_ALLOCATIONS
+        return allocationCount.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+    size_t residentBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+        return counters.WorkingSetSize;
+#else
+        // The second number is the resident pages. Only Linux has /proc/self/statm.
+        FILE* file = std::fopen("/proc/self/statm", "r");
+        if (file == nullptr)
+            return 0;
+
+        unsigned long long totalPages = 0, residentPages = 0;
+        const bool read = std::fscanf(file, "%llu %llu", &totalPages, &residentPages) == 2;
+        std::fclose(file);
+        return read ? (size_t)residentPages * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+    }
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include <cstddef>
+
+/**
+ * \brief Test hook that counts heap allocations, to check that hot paths like predict don't allocate.
+ * Only counts when the program is built with NN_COUNT_ALLOCATIONS defined (the Debug configurations),
+ * which replaces the global operator new. Otherwise enabled() is false and allocations() stays at 0.
+ */
+namespace AllocationCounter
+{
+    bool enabled();
+
+    /**
+     * \return How many times operator new has been called so far, on any thread.
+     * Take the difference between two calls to count the allocations of the code in between.
+     */
+    size_t allocations();
+
+    /**
+     * \return How many bytes of the process are in physical memory right now (the resident set size),
+     * or 0 where the operating system doesn't say. Counts in whole pages, on every build.
+     */
+    size_t residentBytes();
+}
@@ -0,0 +1,176 @@
+﻿#include "Arena.h"
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+    // The smallest block added when an arena runs out, so a burst of small allocations doesn't add one block each
+    constexpr size_t MIN_BLOCK_SIZE = 1 << 20;
+
+#ifndef _WIN32
+    constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+#endif
+
+    size_t roundUpTo(size_t value, size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+}
+
+Arena::Arena(size_t capacity, bool hugePages)
+    : hugePages(hugePages)
+{
+    blocks.reserve(8);
+    if (capacity > 0)
+        addBlock(capacity);
+}
+
+Arena::~Arena()
+{
+    for (const Block& block : blocks)
+        freeBlock(block);
+}
+
+void Arena::reset(size_t capacity)
+{
+    for (size_t i = 1; i < blocks.size(); i++)
+        freeBlock(blocks[i]);
+    if (!blocks.empty())
+        blocks.resize(1);
+
+    if (!blocks.empty() && blocks[0].size < capacity)
+    {
+        freeBlock(blocks[0]);
+        blocks.clear();
+    }
+
+    if (blocks.empty())
+    {
+        if (capacity > 0)
+            addBlock(capacity);
+        return;
+    }
+    blocks[0].used = 0;
+}
+
+size_t Arena::bytesUsed() const
+{
+    size_t used = 0;
+    for (const Block& block : blocks)
+        used += block.used;
+    return used;
+}
+
+size_t Arena::bytesReserved() const
+{
+    size_t reserved = 0;
+    for (const Block& block : blocks)
+        reserved += block.size;
+    return reserved;
+}
+
+bool Arena::usesHugePages() const
+{
+    if (blocks.empty())
+        return false;
+    for (const Block& block : blocks)
+    {
+        if (!block.hugePages)
+            return false;
+    }
+    return true;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment)
+{
+    alignment = std::max(alignment, ALIGNMENT);
+
+    // Only the newest block is bumped, whatever is left at the end of the older ones stays unused
+    if (!blocks.empty())
+    {
+        Block& block = blocks.back();
+        const uintptr_t start = roundUpTo((uintptr_t)(block.data + block.used), alignment);
+        const size_t offset = (size_t)(start - (uintptr_t)block.data);
+        if (offset + bytes <= block.size)
+        {
+            block.used = offset + bytes;
+            return block.data + offset;
+        }
+    }
+
+    addBlock(std::max(bytes + alignment, MIN_BLOCK_SIZE));
+    return do_allocate(bytes, alignment);
+}
+
+void Arena::addBlock(size_t size)
+{
+    Block block{ nullptr, roundUp(size), 0, false };
+
+#ifdef _WIN32
+    if (hugePages)
+    {
+        const size_t largePageSize = GetLargePageMinimum();
+        if (largePageSize > 0)
+        {
+            const size_t largeSize = roundUpTo(block.size, largePageSize);
+            block.data = static_cast<uint8_t*>(VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+            if (block.data != nullptr)
+            {
+                block.size = largeSize;
+                block.hugePages = true;
+            }
+        }
+    }
+
+    // Large pages need the "Lock pages in memory" privilege, normal pages are used without it
+    if (block.data == nullptr)
+        block.data = static_cast<uint8_t*>(VirtualAlloc(nullptr, block.size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+    if (hugePages)
+    {
+        // Huge pages have to start on a huge page boundary. Map one more than needed and trim both ends.
+        block.size = roundUpTo(block.size, HUGE_PAGE_SIZE);
+        void* mapping = mmap(nullptr, block.size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED)
+        {
+            uint8_t* start = static_cast<uint8_t*>(mapping);
+            uint8_t* aligned = reinterpret_cast<uint8_t*>(roundUpTo((uintptr_t)start, HUGE_PAGE_SIZE));
+            if (aligned > start)
+                munmap(start, (size_t)(aligned - start));
+            if (aligned < start + HUGE_PAGE_SIZE)
+                munmap(aligned + block.size, (size_t)(start + HUGE_PAGE_SIZE - aligned));
+
+            block.data = aligned;
+#ifdef MADV_HUGEPAGE
+            block.hugePages = madvise(aligned, block.size, MADV_HUGEPAGE) == 0;
+#endif
+        }
+    }
+    else
+    {
+        void* mapping = mmap(nullptr, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED)
+            block.data = static_cast<uint8_t*>(mapping);
+    }
+#endif
+
+    if (block.data == nullptr)
+        throw std::bad_alloc();
+    blocks.push_back(block);
+}
+
+void Arena::freeBlock(const Block& block)
+{
+#ifdef _WIN32
+    VirtualFree(block.data, 0, MEM_RELEASE);
+#else
+    munmap(block.data, block.size);
+#endif
+}
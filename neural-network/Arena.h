@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+/**
+ * \brief A bump allocator for buffers that live and die together, like every buffer of a network. Memory comes from
+ * the operating system in large blocks, every allocation starts on a cache line (ALIGNMENT bytes), and deallocating
+ * does nothing: the memory is only given back by reset or when the arena goes. Use it through std::pmr containers.
+ * An arena sized up front holds everything in its first block. When it runs out, it adds another block.
+ * Not thread-safe, allocate from one thread at a time.
+ */
+class Arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    /**
+     * \param capacity The size of the first block in bytes, allocated right away. 0 waits for the first allocation.
+     * \param hugePages Back the blocks with huge pages (2 MB on x86) when the operating system allows it, which takes
+     * far fewer TLB entries for large networks. Rounds the blocks up to whole huge pages.
+     */
+    explicit Arena(size_t capacity = 0, bool hugePages = false);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * \brief Forget every allocation, so the memory can be handed out again. Keeps the first block if it holds at
+     * least capacity bytes and replaces it with one that does otherwise, and gives the other blocks back.
+     * Everything allocated before is invalid afterwards.
+     */
+    void reset(size_t capacity = 0);
+
+    size_t bytesUsed() const;
+    size_t bytesReserved() const;
+    size_t blockCount() const { return blocks.size(); }
+
+    bool hugePagesRequested() const { return hugePages; }
+
+    /**
+     * \return Whether the operating system accepted huge pages for every block. Linux only promises to use them
+     * where it can (transparent huge pages).
+     */
+    bool usesHugePages() const;
+
+    /**
+     * \return bytes rounded up to a whole number of cache lines, what an allocation of that many bytes takes up.
+     */
+    static size_t roundUp(size_t bytes) { return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+    /**
+     * \return What count values of T take up in an arena.
+     */
+    template <typename T>
+    static size_t bytes(size_t count) { return roundUp(count * sizeof(T)); }
+
+protected:
+    struct Block
+    {
+        uint8_t* data;
+        size_t size;
+        size_t used;
+        bool hugePages;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void addBlock(size_t size);
+    void freeBlock(const Block& block);
+
+    std::vector<Block> blocks;
+    bool hugePages;
+};
@@ -0,0 +1,143 @@
+﻿#include "BatchPrefetcher.h"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+template <typename Scalar>
+BatchPrefetcher<Scalar>::BatchPrefetcher(const IdxFile& images, const IdxFile& labels, size_t batchSize, size_t numClasses,
+    size_t numSamples, unsigned int seed)
+    : images(images), labels(labels), batchSize(batchSize), numClasses(numClasses),
+      numSamples(numSamples != 0 ? std::min(numSamples, images.count()) : images.count())
+{
+    // The files come from outside, so they're checked once here instead of on every batch: every image needs a label,
+    // and every label needs a place in the one-hot targets
+    const char* error = nullptr;
+    if (!images.isOpen() || !labels.isOpen())
+        error = "The images or the labels aren't open.";
+    else if (batchSize == 0 || numClasses == 0 || this->numSamples == 0)
+        error = "The batch size, the number of classes and the number of samples have to be at least 1.";
+    else if (labels.itemSize() != 1 || labels.count() < this->numSamples)
+        error = "There has to be a one byte label for every image.";
+    else if (std::any_of(labels.item(0).data, labels.item(0).data + this->numSamples, [&](uint8_t label) { return label >= numClasses; }))
+        error = "A label is out of range for the number of classes.";
+
+    if (error != nullptr)
+    {
+        std::cerr << "BatchPrefetcher: " << error << "\n";
+        this->numSamples = 0;
+        return;
+    }
+
+    std::random_device randomDevice;
+    generator.seed(seed != 0 ? seed : randomDevice());
+
+    order.resize(this->numSamples);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::shuffle(order.begin(), order.end(), generator);
+
+    for (Buffer& buffer : buffers)
+    {
+        buffer.inputs.resize(batchSize * images.itemSize());
+        buffer.targetOutputs.resize(batchSize * numClasses);
+    }
+
+    thread = std::thread(&BatchPrefetcher::prefetchLoop, this);
+}
+
+template <typename Scalar>
+BatchPrefetcher<Scalar>::~BatchPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+
+    // Not started if the constructor found a problem
+    if (thread.joinable())
+        thread.join();
+}
+
+template <typename Scalar>
+typename BatchPrefetcher<Scalar>::Batch BatchPrefetcher<Scalar>::next()
+{
+    if (!isValid())
+        return Batch{ nullptr, nullptr, 0, 0 };
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Hand the last batch back so the background thread can refill it, and move on to the other buffer
+    size_t nextBuffer = 0;
+    if (current < 2)
+    {
+        buffers[current].ready = false;
+        nextBuffer = current ^ 1;
+        changed.notify_all();
+    }
+    current = nextBuffer;
+
+    changed.wait(lock, [&] { return buffers[current].ready; });
+
+    const Buffer& buffer = buffers[current];
+    return Batch{ buffer.inputs.data(), buffer.targetOutputs.data(), buffer.size, buffer.epoch };
+}
+
+template <typename Scalar>
+void BatchPrefetcher<Scalar>::prefetchLoop()
+{
+    // Fill the buffers in turn, each one as soon as next hands it back
+    for (size_t index = 0; ; index ^= 1)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return stopping || !buffers[index].ready; });
+            if (stopping)
+                return;
+        }
+
+        // The buffer isn't ready, so next won't touch it until it is
+        fill(buffers[index]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers[index].ready = true;
+        }
+        changed.notify_all();
+    }
+}
+
+template <typename Scalar>
+void BatchPrefetcher<Scalar>::fill(Buffer& buffer)
+{
+    if (position == numSamples)
+    {
+        // New epoch, new order
+        std::shuffle(order.begin(), order.end(), generator);
+        position = 0;
+        epoch++;
+    }
+
+    buffer.size = std::min(batchSize, numSamples - position);
+    buffer.epoch = epoch;
+
+    const size_t itemSize = images.itemSize();
+    std::fill(buffer.targetOutputs.begin(), buffer.targetOutputs.end(), Scalar(0));
+    for (size_t b = 0; b < buffer.size; b++)
+    {
+        const size_t sample = order[position + b];
+
+        // Normalize the value for each pixel to between 0 - 1
+        const IdxFile::Span image = images.item(sample);
+        Scalar* inputs = buffer.inputs.data() + b * itemSize;
+        for (size_t k = 0; k < itemSize; k++)
+            inputs[k] = image[k] / Scalar(255);
+
+        // In range, the constructor checked every label
+        buffer.targetOutputs[b * numClasses + labels.item(sample)[0]] = 1;
+    }
+
+    position += buffer.size;
+}
+
+template class BatchPrefetcher<float>;
+template class BatchPrefetcher<double>;
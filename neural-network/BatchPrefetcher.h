@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "IdxFile.h"
+
+/**
+ * \brief Streams shuffled mini-batches out of a pair of IDX files for training.
+ * A background thread reads the next batch's images from the mapped file, normalizes the pixels to [0, 1],
+ * turns the labels into one-hot targets and writes both into one of two reusable buffers, while the batch
+ * in the other buffer trains. Preparing the data never allocates after the first two batches, and stays off
+ * the training thread unless it takes longer than a training step.
+ * \tparam Scalar The floating point type of the network the batches are for, float or double.
+ */
+template <typename Scalar>
+class BatchPrefetcher
+{
+public:
+    /**
+     * \brief One mini-batch, in the layout BasicNeuralNetwork::trainBatch takes.
+     * Stays valid until the next call to next.
+     */
+    struct Batch
+    {
+        // size x itemSize inputs, one row per sample
+        const Scalar* inputs;
+        // size x numClasses one-hot targets, one row per sample
+        const Scalar* targetOutputs;
+        size_t size;
+        // Which pass over the data the batch belongs to, starting at 0
+        size_t epoch;
+    };
+
+    /**
+     * \brief Start preparing the first batch in the background.
+     * \param images The images. Only referenced, has to outlive the prefetcher.
+     * \param labels One byte label per image, from 0 to numClasses - 1. Only referenced, has to outlive the prefetcher.
+     * \param batchSize The number of samples per batch. The last batch of every epoch is smaller if
+     * the number of samples isn't divisible by batchSize.
+     * \param numClasses The length of the one-hot targets.
+     * \param numSamples How many samples from the start of the files to use. 0 uses all of them.
+     * \param seed Seed for the shuffle, the same seed gives the same order every time. 0 picks a random seed.
+     * Check isValid afterwards. Files that aren't open, too few labels or a label of numClasses or more are reported,
+     * and leave the prefetcher without any batches.
+     */
+    BatchPrefetcher(const IdxFile& images, const IdxFile& labels, size_t batchSize, size_t numClasses,
+        size_t numSamples = 0, unsigned int seed = 0);
+    ~BatchPrefetcher();
+
+    BatchPrefetcher(const BatchPrefetcher&) = delete;
+    BatchPrefetcher& operator=(const BatchPrefetcher&) = delete;
+
+    /**
+     * \brief Hand the current batch back, and wait for the next one. Every sample is visited once per epoch,
+     * in a new shuffled order each epoch. Never runs out, keeps going with the next epoch.
+     */
+    Batch next();
+
+    /**
+     * \return false if the constructor found a problem with the files or the arguments. next then returns empty batches.
+     */
+    bool isValid() const { return numSamples > 0; }
+
+    size_t batchesPerEpoch() const { return isValid() ? (numSamples + batchSize - 1) / batchSize : 0; }
+
+protected:
+    struct Buffer
+    {
+        std::vector<Scalar> inputs;
+        std::vector<Scalar> targetOutputs;
+        size_t size = 0;
+        size_t epoch = 0;
+        // Filled and waiting for next, or in use by whoever called next
+        bool ready = false;
+    };
+
+    void prefetchLoop();
+    void fill(Buffer& buffer);
+
+    const IdxFile& images;
+    const IdxFile& labels;
+    size_t batchSize;
+    size_t numClasses;
+    size_t numSamples;
+
+    // Only touched by the background thread
+    std::vector<size_t> order;
+    size_t position = 0;
+    size_t epoch = 0;
+    std::mt19937 generator;
+
+    Buffer buffers[2];
+    // The buffer the last next returned. Starts out past the end, when nothing has been handed out yet.
+    size_t current = 2;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+    std::thread thread;
+};
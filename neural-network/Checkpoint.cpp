@@ -0,0 +1,220 @@
+﻿#include "Checkpoint.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    const char MAGIC[4] = { 'N', 'N', 'C', 'K' };
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    // Weights and biases start on a multiple of this, so they are aligned for any vector width when mapped
+    constexpr uint64_t DATA_ALIGNMENT = 64;
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    }
+}
+
+template <typename Scalar>
+bool Checkpoint::save(const BasicNeuralNetwork<Scalar>& network, const std::string& path)
+{
+    const std::vector<NetworkLayer<Scalar>>& layers = network.layers();
+
+    // The layer records only describe dense layers
+    for (const NetworkLayer<Scalar>& layer : layers)
+    {
+        if (layer.type != Dense)
+        {
+            std::cerr << "Checkpoint::save: Only networks of dense layers can be saved.\n";
+            return false;
+        }
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.scalarSize = sizeof(Scalar);
+    header.numLayers = layers.size();
+
+    // Lay out the data first, so every record knows where its weights and biases end up
+    std::vector<LayerRecord> records(layers.size());
+    uint64_t offset = sizeof(FileHeader) + layers.size() * sizeof(LayerRecord);
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        LayerRecord& record = records[i];
+        record.numNeurons = layers[i].numNeurons;
+        record.learningRate = (double)layers[i].learningRate;
+        record.activationFunction = (uint32_t)layers[i].activationFunction;
+
+        // The input layer doesn't have any weights or biases
+        if (i == 0)
+            continue;
+
+        record.weightsOffset = alignUp(offset);
+        offset = record.weightsOffset + layers[i].weights.size() * sizeof(Scalar);
+        record.biasesOffset = alignUp(offset);
+        offset = record.biasesOffset + layers[i].biases.size() * sizeof(Scalar);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Checkpoint::save: Couldn't open " << path << " for writing.\n";
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(LayerRecord));
+
+    const char padding[DATA_ALIGNMENT] = {};
+    auto writeAt = [&](uint64_t at, const std::pmr::vector<Scalar>& values)
+    {
+        file.write(padding, at - (uint64_t)file.tellp());
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(Scalar));
+    };
+
+    for (size_t i = 1; i < layers.size(); i++)
+    {
+        writeAt(records[i].weightsOffset, layers[i].weights);
+        writeAt(records[i].biasesOffset, layers[i].biases);
+    }
+
+    if (!file)
+    {
+        std::cerr << "Checkpoint::save: Writing " << path << " failed.\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Scalar>
+std::optional<BasicNeuralNetwork<Scalar>> Checkpoint::load(const std::string& path)
+{
+    const MappedFile file(path);
+    if (!file.isOpen())
+    {
+        std::cerr << "Checkpoint::load: Couldn't open " << path << ".\n";
+        return std::nullopt;
+    }
+
+    std::vector<LayerView> views;
+    size_t scalarSize;
+    if (!read(file, views, scalarSize))
+        return std::nullopt;
+
+    NNConstructionInfo constructionInfo(views.front().info.numNeurons, views.back().info);
+    for (size_t i = 1; i + 1 < views.size(); i++)
+        constructionInfo.addHiddenLayer(views[i].info);
+
+    std::optional<BasicNeuralNetwork<Scalar>> network(std::in_place, constructionInfo);
+    for (size_t i = 1; i < views.size(); i++)
+    {
+        NetworkLayer<Scalar>& layer = network->networkLayers[i];
+        if (scalarSize == sizeof(float))
+        {
+            copyValues<Scalar, float>(views[i].weights, layer.weights.size(), layer.weights);
+            copyValues<Scalar, float>(views[i].biases, layer.biases.size(), layer.biases);
+        }
+        else
+        {
+            copyValues<Scalar, double>(views[i].weights, layer.weights.size(), layer.weights);
+            copyValues<Scalar, double>(views[i].biases, layer.biases.size(), layer.biases);
+        }
+    }
+    return network;
+}
+
+template <typename To, typename From>
+void Checkpoint::copyValues(const void* from, size_t count, std::pmr::vector<To>& to)
+{
+    const From* values = static_cast<const From*>(from);
+    std::transform(values, values + count, to.begin(), [](From value) { return (To)value; });
+}
+
+bool Checkpoint::read(const MappedFile& file, std::vector<LayerView>& layers, size_t& scalarSize)
+{
+    const uint8_t* bytes = file.data();
+    const size_t size = file.size();
+
+    FileHeader header;
+    if (size < sizeof(FileHeader))
+    {
+        std::cerr << "Checkpoint::read: File is too small to be a checkpoint.\n";
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        std::cerr << "Checkpoint::read: Not a checkpoint file.\n";
+        return false;
+    }
+    if (header.byteOrder != BYTE_ORDER_MARK)
+    {
+        std::cerr << "Checkpoint::read: The checkpoint was written on a machine with another byte order.\n";
+        return false;
+    }
+    if (header.version != VERSION)
+    {
+        std::cerr << "Checkpoint::read: Checkpoint version " << header.version << " isn't supported, expected " << VERSION << ".\n";
+        return false;
+    }
+    if ((header.scalarSize != sizeof(float) && header.scalarSize != sizeof(double)) || header.numLayers < 2
+        || header.numLayers > (size - sizeof(FileHeader)) / sizeof(LayerRecord))
+    {
+        std::cerr << "Checkpoint::read: Corrupt checkpoint header.\n";
+        return false;
+    }
+    scalarSize = header.scalarSize;
+
+    layers.clear();
+    layers.reserve(header.numLayers);
+    for (size_t i = 0; i < header.numLayers; i++)
+    {
+        LayerRecord record;
+        std::memcpy(&record, bytes + sizeof(FileHeader) + i * sizeof(LayerRecord), sizeof(record));
+
+        if (record.activationFunction > Softmax)
+        {
+            std::cerr << "Checkpoint::read: Layer " << i << " has an unknown activation function.\n";
+            return false;
+        }
+
+        LayerView view;
+        view.info = LayerInfo((size_t)record.numNeurons, record.learningRate, (ActiviationFunction)record.activationFunction);
+        view.numInputs = i == 0 ? 0 : layers[i - 1].info.numNeurons;
+        view.weights = nullptr;
+        view.biases = nullptr;
+
+        if (i > 0)
+        {
+            // Check sizes by division, so a corrupt neuron count can't overflow the multiplication
+            const uint64_t weightCount = (uint64_t)view.info.numNeurons * view.numInputs;
+            const bool fits = view.numInputs > 0 && view.info.numNeurons > 0
+                && view.info.numNeurons <= size / view.numInputs / scalarSize
+                && record.weightsOffset % DATA_ALIGNMENT == 0 && record.biasesOffset % DATA_ALIGNMENT == 0
+                && record.weightsOffset <= size && weightCount * scalarSize <= size - record.weightsOffset
+                && record.biasesOffset <= size && view.info.numNeurons * scalarSize <= size - record.biasesOffset;
+            if (!fits)
+            {
+                std::cerr << "Checkpoint::read: Layer " << i << " doesn't fit in the file, the checkpoint is cut short or corrupt.\n";
+                return false;
+            }
+
+            view.weights = bytes + record.weightsOffset;
+            view.biases = bytes + record.biasesOffset;
+        }
+
+        layers.push_back(view);
+    }
+    return true;
+}
+
+template bool Checkpoint::save(const BasicNeuralNetwork<float>&, const std::string&);
+template bool Checkpoint::save(const BasicNeuralNetwork<double>&, const std::string&);
+template std::optional<BasicNeuralNetwork<float>> Checkpoint::load(const std::string&);
+template std::optional<BasicNeuralNetwork<double>> Checkpoint::load(const std::string&);
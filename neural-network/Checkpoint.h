@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "NeuralNetwork.h"
+
+/**
+ * \brief Saves and loads networks in a versioned binary format.
+ * A checkpoint starts with a FileHeader, followed by one LayerRecord per layer (input layer first), and then
+ * the weights (numNeurons x numInputs, row-major, like NetworkLayer::weights) and biases of every layer except
+ * the input layer. The weights and biases each start on a 64 byte boundary of the file, so a memory-mapped
+ * checkpoint can be used for inference as is, see MappedNetwork. Everything is stored in the byte order
+ * of the machine that wrote it, and loading a checkpoint from a machine with the other byte order fails.
+ */
+class Checkpoint
+{
+public:
+    // Bumped whenever the layout changes. Files with another version are rejected instead of misread.
+    static constexpr uint32_t VERSION = 1;
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        // Written as 0x01020304, reads differently on a machine with the other byte order
+        uint32_t byteOrder;
+        // sizeof(float) or sizeof(double), whichever the network was saved with
+        uint32_t scalarSize;
+        uint64_t numLayers;
+    };
+
+    struct LayerRecord
+    {
+        uint64_t numNeurons;
+        double learningRate;
+        uint32_t activationFunction;
+        uint32_t reserved;
+        // Byte offsets from the start of the file. 0 for the input layer, which has no weights or biases.
+        uint64_t weightsOffset;
+        uint64_t biasesOffset;
+    };
+
+    /**
+     * \brief One layer of a checkpoint, pointing into the bytes of the file it was read from.
+     */
+    struct LayerView
+    {
+        LayerInfo info;
+        size_t numInputs;
+        const void* weights;
+        const void* biases;
+    };
+
+    /**
+     * \brief Write the topology, weights and biases of a network to a file, replacing it if it exists.
+     * \return false if the file couldn't be written.
+     */
+    template <typename Scalar>
+    static bool save(const BasicNeuralNetwork<Scalar>& network, const std::string& path);
+
+    /**
+     * \brief Build a network from a checkpoint, copying the weights and biases into it.
+     * The checkpoint can be either precision, the values are converted to Scalar.
+     * The optimizer isn't saved, the network trains on with SGD.
+     * \return The network, or nothing if the file is missing or isn't a valid checkpoint.
+     */
+    template <typename Scalar>
+    static std::optional<BasicNeuralNetwork<Scalar>> load(const std::string& path);
+
+    /**
+     * \brief Check the header of a mapped checkpoint and find every layer in it.
+     * \param layers Receives one view per layer, input layer first.
+     * \param scalarSize Receives the size of the floating point type the checkpoint was saved with.
+     * \return false (and a message on std::cerr) if the file isn't a checkpoint, has another version
+     * or byte order, or is cut short.
+     */
+    static bool read(const MappedFile& file, std::vector<LayerView>& layers, size_t& scalarSize);
+
+protected:
+    template <typename To, typename From>
+    static void copyValues(const void* from, size_t count, std::pmr::vector<To>& to);
+};
@@ -0,0 +1,320 @@
+﻿#include "Convolution.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+namespace
+{
+    std::atomic<bool> useDirect{ true };
+
+    // Inputs with more channels than this go through im2col and GEMM even for 3x3 filters. Above a few channels
+    // the windows are long enough for the GEMM kernels to beat the direct loops, copies included.
+    constexpr size_t DIRECT_MAX_CHANNELS = 4;
+
+    /**
+     * The kernel rows (or columns) [first, last) of a window that starts at start, which are inside an input of the given size.
+     */
+    void windowRange(ptrdiff_t start, size_t kernelSize, size_t size, size_t& first, size_t& last)
+    {
+        const ptrdiff_t end = std::min<ptrdiff_t>((ptrdiff_t)kernelSize, (ptrdiff_t)size - start);
+        last = (size_t)std::max<ptrdiff_t>(0, end);
+        first = std::min(start < 0 ? (size_t)-start : 0, last);
+    }
+
+    /**
+     * Call function with the number of channels as an std::integral_constant, for the direct kernels.
+     */
+    template <typename Function>
+    void dispatchChannels(size_t channels, const Function& function)
+    {
+        // isDirect only allows up to DIRECT_MAX_CHANNELS
+        static_assert(DIRECT_MAX_CHANNELS == 4, "Every channel count the direct kernels take needs a case here");
+        switch (channels)
+        {
+        case 1:
+            function(std::integral_constant<size_t, 1>());
+            break;
+        case 2:
+            function(std::integral_constant<size_t, 2>());
+            break;
+        case 3:
+            function(std::integral_constant<size_t, 3>());
+            break;
+        case 4:
+            function(std::integral_constant<size_t, 4>());
+            break;
+        default:
+            assert(false);
+        }
+    }
+
+    /**
+     * Where the window of output pixel p starts in the input, which is negative in the padding.
+     */
+    void windowStart(const Convolution::Geometry& geometry, size_t p, ptrdiff_t& top, ptrdiff_t& left)
+    {
+        top = (ptrdiff_t)(p / geometry.outputWidth * geometry.stride) - (ptrdiff_t)geometry.padding;
+        left = (ptrdiff_t)(p % geometry.outputWidth * geometry.stride) - (ptrdiff_t)geometry.padding;
+    }
+
+    /**
+     * The 3x3 window of row r of the im2col matrix, with zeros for the padding. Small enough to stay in registers,
+     * where a whole im2col matrix is 9 times the size of the input.
+     */
+    template <size_t Channels, typename Scalar>
+    void window3x3(const Convolution::Geometry& geometry, const Scalar* images, size_t r, Scalar* window)
+    {
+        const size_t pixels = geometry.outputPixels();
+        const Scalar* image = images + r / pixels * geometry.inputSize();
+        ptrdiff_t top, left;
+        windowStart(geometry, r % pixels, top, left);
+
+        for (size_t ky = 0; ky < 3; ky++)
+        {
+            const ptrdiff_t y = top + (ptrdiff_t)ky;
+            for (size_t kx = 0; kx < 3; kx++)
+            {
+                const ptrdiff_t x = left + (ptrdiff_t)kx;
+                Scalar* out = window + (ky * 3 + kx) * Channels;
+                if (y < 0 || y >= (ptrdiff_t)geometry.inputHeight || x < 0 || x >= (ptrdiff_t)geometry.inputWidth)
+                {
+                    for (size_t c = 0; c < Channels; c++)
+                        out[c] = 0;
+                }
+                else
+                {
+                    const Scalar* in = image + ((size_t)y * geometry.inputWidth + (size_t)x) * Channels;
+                    for (size_t c = 0; c < Channels; c++)
+                        out[c] = in[c];
+                }
+            }
+        }
+    }
+}
+
+namespace Convolution
+{
+    template <typename Scalar>
+    void im2col(const Geometry& geometry, const Scalar* images, size_t firstRow, size_t lastRow, Scalar* rows)
+    {
+        const size_t pixels = geometry.outputPixels();
+        const size_t kernelSize = geometry.kernelSize;
+        const size_t channels = geometry.inputChannels;
+        const size_t rowLength = kernelSize * channels;
+
+        for (size_t r = firstRow; r < lastRow; r++)
+        {
+            const Scalar* image = images + r / pixels * geometry.inputSize();
+            ptrdiff_t top, left;
+            windowStart(geometry, r % pixels, top, left);
+
+            size_t firstColumn, lastColumn;
+            windowRange(left, kernelSize, geometry.inputWidth, firstColumn, lastColumn);
+
+            Scalar* row = rows + r * geometry.patchSize();
+            for (size_t ky = 0; ky < kernelSize; ky++)
+            {
+                Scalar* out = row + ky * rowLength;
+                const ptrdiff_t y = top + (ptrdiff_t)ky;
+                if (y < 0 || y >= (ptrdiff_t)geometry.inputHeight)
+                {
+                    std::fill(out, out + rowLength, Scalar(0));
+                    continue;
+                }
+
+                // The part of the window's row inside the image is contiguous in the input, channels and all
+                const Scalar* in = image + ((size_t)y * geometry.inputWidth + (size_t)(left + (ptrdiff_t)firstColumn)) * channels;
+                std::fill(out, out + firstColumn * channels, Scalar(0));
+                std::copy(in, in + (lastColumn - firstColumn) * channels, out + firstColumn * channels);
+                std::fill(out + lastColumn * channels, out + rowLength, Scalar(0));
+            }
+        }
+    }
+
+    template <typename Scalar>
+    void col2im(const Geometry& geometry, const Scalar* rows, size_t firstImage, size_t lastImage, Scalar* images)
+    {
+        const size_t pixels = geometry.outputPixels();
+        const size_t channels = geometry.inputChannels;
+
+        for (size_t b = firstImage; b < lastImage; b++)
+        {
+            Scalar* image = images + b * geometry.inputSize();
+            std::fill(image, image + geometry.inputSize(), Scalar(0));
+
+            for (size_t p = 0; p < pixels; p++)
+            {
+                ptrdiff_t top, left;
+                windowStart(geometry, p, top, left);
+                size_t firstRow, lastRow, firstColumn, lastColumn;
+                windowRange(top, geometry.kernelSize, geometry.inputHeight, firstRow, lastRow);
+                windowRange(left, geometry.kernelSize, geometry.inputWidth, firstColumn, lastColumn);
+
+                const Scalar* row = rows + (b * pixels + p) * geometry.patchSize();
+                for (size_t ky = firstRow; ky < lastRow; ky++)
+                {
+                    const Scalar* in = row + (ky * geometry.kernelSize + firstColumn) * channels;
+                    Scalar* out = image + ((size_t)(top + (ptrdiff_t)ky) * geometry.inputWidth + (size_t)(left + (ptrdiff_t)firstColumn)) * channels;
+                    const size_t count = (lastColumn - firstColumn) * channels;
+                    for (size_t i = 0; i < count; i++)
+                        out[i] += in[i];
+                }
+            }
+        }
+    }
+
+    bool isDirect(const Geometry& geometry)
+    {
+        return useDirect.load() && geometry.kernelSize == 3 && geometry.inputChannels <= DIRECT_MAX_CHANNELS;
+    }
+
+    template <typename Scalar>
+    void convolve3x3(const Geometry& geometry, const Scalar* weights, const Scalar* biases, const Scalar* images,
+        size_t firstRow, size_t lastRow, Scalar* outputs)
+    {
+        dispatchChannels(geometry.inputChannels, [&](auto channels)
+        {
+            constexpr size_t patchSize = 9 * decltype(channels)::value;
+            const size_t filters = geometry.outputChannels;
+            Scalar window[patchSize];
+
+            for (size_t r = firstRow; r < lastRow; r++)
+            {
+                window3x3<decltype(channels)::value>(geometry, images, r, window);
+
+                Scalar* out = outputs + r * filters;
+                for (size_t f = 0; f < filters; f++)
+                {
+                    const Scalar* filter = weights + f * patchSize;
+                    Scalar sum = biases[f];
+                    for (size_t i = 0; i < patchSize; i++)
+                        sum += filter[i] * window[i];
+                    out[f] = sum;
+                }
+            }
+        });
+    }
+
+    template <typename Scalar>
+    void updateFilters3x3(const Geometry& geometry, Scalar rate, const Scalar* gradients, const Scalar* images, size_t numRows,
+        Scalar* weights, size_t firstFilter, size_t lastFilter)
+    {
+        dispatchChannels(geometry.inputChannels, [&](auto channels)
+        {
+            constexpr size_t patchSize = 9 * decltype(channels)::value;
+            const size_t filters = geometry.outputChannels;
+            Scalar window[patchSize];
+
+            for (size_t r = 0; r < numRows; r++)
+            {
+                bool hasWindow = false;
+                for (size_t f = firstFilter; f < lastFilter; f++)
+                {
+                    // ReLU layers have a lot of zero gradients, which don't change anything
+                    const Scalar change = rate * gradients[r * filters + f];
+                    if (change == 0)
+                        continue;
+
+                    if (!hasWindow)
+                    {
+                        window3x3<decltype(channels)::value>(geometry, images, r, window);
+                        hasWindow = true;
+                    }
+
+                    Scalar* filter = weights + f * patchSize;
+                    for (size_t i = 0; i < patchSize; i++)
+                        filter[i] += change * window[i];
+                }
+            }
+        });
+    }
+
+    template <typename Scalar>
+    void maxPool(const Geometry& geometry, const Scalar* images, size_t firstImage, size_t lastImage, Scalar* outputs, uint32_t* indices)
+    {
+        const size_t channels = geometry.inputChannels;
+
+        for (size_t b = firstImage; b < lastImage; b++)
+        {
+            const Scalar* image = images + b * geometry.inputSize();
+            for (size_t p = 0; p < geometry.outputPixels(); p++)
+            {
+                const size_t top = p / geometry.outputWidth * geometry.stride;
+                const size_t left = p % geometry.outputWidth * geometry.stride;
+                Scalar* out = outputs + (b * geometry.outputPixels() + p) * channels;
+                uint32_t* index = indices + (b * geometry.outputPixels() + p) * channels;
+
+                // Channels innermost, they are next to each other in the image
+                const size_t first = (top * geometry.inputWidth + left) * channels;
+                for (size_t c = 0; c < channels; c++)
+                {
+                    out[c] = image[first + c];
+                    index[c] = (uint32_t)(first + c);
+                }
+
+                for (size_t ky = 0; ky < geometry.kernelSize; ky++)
+                {
+                    for (size_t kx = 0; kx < geometry.kernelSize; kx++)
+                    {
+                        const size_t pixel = ((top + ky) * geometry.inputWidth + left + kx) * channels;
+                        for (size_t c = 0; c < channels; c++)
+                        {
+                            if (image[pixel + c] > out[c])
+                            {
+                                out[c] = image[pixel + c];
+                                index[c] = (uint32_t)(pixel + c);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Scalar>
+    void maxPoolGradients(const Geometry& geometry, const Scalar* gradients, const uint32_t* indices, size_t firstImage, size_t lastImage,
+        Scalar* inputGradients)
+    {
+        for (size_t b = firstImage; b < lastImage; b++)
+        {
+            Scalar* image = inputGradients + b * geometry.inputSize();
+            std::fill(image, image + geometry.inputSize(), Scalar(0));
+
+            // Overlapping windows can pick the same input more than once
+            const size_t first = b * geometry.outputSize();
+            for (size_t o = first; o < first + geometry.outputSize(); o++)
+                image[indices[o]] += gradients[o];
+        }
+    }
+
+    void useDirectConvolution(bool direct)
+    {
+        useDirect.store(direct);
+    }
+
+    bool directConvolution()
+    {
+        return useDirect.load();
+    }
+
+    template void im2col<float>(const Geometry& geometry, const float* images, size_t firstRow, size_t lastRow, float* rows);
+    template void im2col<double>(const Geometry& geometry, const double* images, size_t firstRow, size_t lastRow, double* rows);
+    template void col2im<float>(const Geometry& geometry, const float* rows, size_t firstImage, size_t lastImage, float* images);
+    template void col2im<double>(const Geometry& geometry, const double* rows, size_t firstImage, size_t lastImage, double* images);
+    template void convolve3x3<float>(const Geometry& geometry, const float* weights, const float* biases, const float* images,
+        size_t firstRow, size_t lastRow, float* outputs);
+    template void convolve3x3<double>(const Geometry& geometry, const double* weights, const double* biases, const double* images,
+        size_t firstRow, size_t lastRow, double* outputs);
+    template void updateFilters3x3<float>(const Geometry& geometry, float rate, const float* gradients, const float* images, size_t numRows,
+        float* weights, size_t firstFilter, size_t lastFilter);
+    template void updateFilters3x3<double>(const Geometry& geometry, double rate, const double* gradients, const double* images, size_t numRows,
+        double* weights, size_t firstFilter, size_t lastFilter);
+    template void maxPool<float>(const Geometry& geometry, const float* images, size_t firstImage, size_t lastImage, float* outputs, uint32_t* indices);
+    template void maxPool<double>(const Geometry& geometry, const double* images, size_t firstImage, size_t lastImage, double* outputs, uint32_t* indices);
+    template void maxPoolGradients<float>(const Geometry& geometry, const float* gradients, const uint32_t* indices, size_t firstImage,
+        size_t lastImage, float* inputGradients);
+    template void maxPoolGradients<double>(const Geometry& geometry, const double* gradients, const uint32_t* indices, size_t firstImage,
+        size_t lastImage, double* inputGradients);
+}
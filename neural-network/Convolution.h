@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Image kernels for the Conv2D and MaxPool layers. Images are stored height x width x channels,
+ * channels last, and batches of images back to back. With that layout a convolution is a dense layer
+ * applied to every window of the image: im2col copies the windows into the rows of a matrix, which then
+ * goes through the same GEMM kernels as the dense layers.
+ */
+namespace Convolution
+{
+    /**
+     * \brief The input and output images of a Conv2D or MaxPool layer, and the size of its filters or windows.
+     */
+    struct Geometry
+    {
+        size_t inputHeight = 0;
+        size_t inputWidth = 0;
+        size_t inputChannels = 0;
+
+        size_t kernelSize = 0;
+        size_t stride = 1;
+        // Zeros added on every side of the input. Conv2D only.
+        size_t padding = 0;
+
+        size_t outputHeight = 0;
+        size_t outputWidth = 0;
+        // The number of filters for Conv2D, the same as inputChannels for MaxPool
+        size_t outputChannels = 0;
+
+        size_t inputSize() const { return inputHeight * inputWidth * inputChannels; }
+        size_t outputPixels() const { return outputHeight * outputWidth; }
+        size_t outputSize() const { return outputPixels() * outputChannels; }
+
+        // The number of inputs in one window, the length of every filter and every im2col row
+        size_t patchSize() const { return kernelSize * kernelSize * inputChannels; }
+    };
+
+    /**
+     * \brief Fill in rows [firstRow, lastRow) of the im2col matrix of a batch of images. Row b * outputPixels() + p
+     * holds the window of output pixel p of image b, patchSize() values in (row, column, channel) order, with zeros
+     * for the padding.
+     * \param rows The whole matrix. Only the given rows are written.
+     */
+    template <typename Scalar>
+    void im2col(const Geometry& geometry, const Scalar* images, size_t firstRow, size_t lastRow, Scalar* rows);
+
+    /**
+     * \brief The reverse of im2col for images [firstImage, lastImage): every image pixel becomes the sum of the values
+     * of every window it is in. Overwrites those images.
+     */
+    template <typename Scalar>
+    void col2im(const Geometry& geometry, const Scalar* rows, size_t firstImage, size_t lastImage, Scalar* images);
+
+    /**
+     * \return Whether the Conv2D layer with this geometry uses the direct kernels instead of im2col and GEMM.
+     * Only 3x3 filters on inputs with a few channels do, where the windows are too small for the GEMM to pay
+     * for copying each input into 9 rows.
+     */
+    bool isDirect(const Geometry& geometry);
+
+    /**
+     * \brief Direct 3x3 convolution, without im2col. Writes rows [firstRow, lastRow) of the outputs, outputChannels
+     * values per output pixel: the bias plus the window times the filter, for every filter.
+     * \param weights outputChannels x patchSize() values, one filter per row.
+     */
+    template <typename Scalar>
+    void convolve3x3(const Geometry& geometry, const Scalar* weights, const Scalar* biases, const Scalar* images,
+        size_t firstRow, size_t lastRow, Scalar* outputs);
+
+    /**
+     * \brief Weight update of the direct 3x3 convolution, without im2col:
+     * filter f += rate * the sum over every output pixel of its gradient for f times its window.
+     * Only changes the filters [firstFilter, lastFilter).
+     * \param gradients numRows x outputChannels values.
+     */
+    template <typename Scalar>
+    void updateFilters3x3(const Geometry& geometry, Scalar rate, const Scalar* gradients, const Scalar* images, size_t numRows,
+        Scalar* weights, size_t firstFilter, size_t lastFilter);
+
+    /**
+     * \brief The largest value of every window, per channel, for images [firstImage, lastImage).
+     * \param indices Receives where in its image every output came from, for maxPoolGradients.
+     */
+    template <typename Scalar>
+    void maxPool(const Geometry& geometry, const Scalar* images, size_t firstImage, size_t lastImage, Scalar* outputs, uint32_t* indices);
+
+    /**
+     * \brief Send the gradient of every output of maxPool back to the input it came from. Every other input gets 0.
+     * Overwrites the input gradients of images [firstImage, lastImage).
+     */
+    template <typename Scalar>
+    void maxPoolGradients(const Geometry& geometry, const Scalar* gradients, const uint32_t* indices, size_t firstImage, size_t lastImage,
+        Scalar* inputGradients);
+
+    /**
+     * \brief Choose whether 3x3 convolutions use the direct kernels where isDirect allows it, or always im2col and GEMM,
+     * e.g. for benchmarking. Applies to every network. Direct by default.
+     */
+    void useDirectConvolution(bool direct);
+
+    /**
+     * \return Whether 3x3 convolutions can use the direct kernels.
+     */
+    bool directConvolution();
+}
@@ -0,0 +1,106 @@
+﻿#include "DataParallelTrainer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+template <typename Scalar>
+DataParallelTrainer<Scalar>::DataParallelTrainer(BasicNeuralNetwork<Scalar>& network, size_t numThreads)
+    : network(network)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    this->numThreads = numThreads;
+
+    // The single-sample buffers fit in the first block, the batch buffers add blocks with the first batches
+    size_t bytes = 0;
+    for (const NetworkLayer<Scalar>& layer : network.layers())
+        bytes += LayerState<Scalar>::memoryBytes(layer.size());
+    memory.reset(numThreads * bytes);
+    scratch.reset(Arena::bytes<size_t>(numThreads + 1) + Arena::bytes<double>(numThreads));
+
+    threadStates.reserve(numThreads);
+    for (size_t t = 0; t < numThreads; t++)
+        threadStates.push_back(network.createLayerStates(&memory));
+}
+
+template <typename Scalar>
+template <typename Function>
+void DataParallelTrainer<Scalar>::runOnAllThreads(const Function& function)
+{
+    // One index per chunk, so each index can go to a different thread of the pool
+    ThreadPool::global().parallelFor(0, numThreads, 1, [&](size_t first, size_t last)
+    {
+        for (size_t t = first; t < last; t++)
+            function(t);
+    });
+}
+
+template <typename Scalar>
+double DataParallelTrainer<Scalar>::train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput, size_t batchSize)
+{
+    assert(batchSize > 0);
+    assert(trainingData.size() == targetOutput.size());
+
+    std::vector<NetworkLayer<Scalar>>& layers = network.networkLayers;
+    scratch.reset();
+    std::pmr::vector<size_t> shardStarts(numThreads + 1, &scratch);
+    std::pmr::vector<double> lossSums(numThreads, &scratch);
+    double loss = 0.0;
+
+    for (size_t first = 0; first < trainingData.size(); first += batchSize)
+    {
+        const size_t count = std::min(batchSize, trainingData.size() - first);
+
+        // Split the batch into contiguous shards, as even as possible
+        for (size_t t = 0; t <= numThreads; t++)
+            shardStarts[t] = first + t * count / numThreads;
+
+        // Forward and backward pass, every thread on its own shard. Only reads the weights.
+        runOnAllThreads([&](size_t t)
+        {
+            const size_t shardSize = shardStarts[t + 1] - shardStarts[t];
+            lossSums[t] = shardSize == 0 ? 0.0
+                : network.calculateBatchGradients(threadStates[t], trainingData, targetOutput, shardStarts[t], shardSize);
+        });
+
+        // Reduce the changes from every shard into the weights. Every thread owns a slice of the neurons
+        // (or filters) in each layer, and adds the shards into it in the same order every time.
+        // Optimizers other than SGD collect the changes first, and then step the slice.
+        for (size_t i = 1; i < layers.size(); i++)
+            layers[i].countStep();
+        runOnAllThreads([&](size_t t)
+        {
+            for (size_t i = layers.size() - 1; i > 0; i--)
+            {
+                NetworkLayer<Scalar>& layer = layers[i];
+                const size_t firstNeuron = t * layer.numWeightRows() / numThreads;
+                const size_t lastNeuron = (t + 1) * layer.numWeightRows() / numThreads;
+                if (firstNeuron == lastNeuron)
+                    continue;
+
+                const Scalar rate = layer.changeScale() / (Scalar)count;
+                for (size_t shard = 0; shard < numThreads; shard++)
+                {
+                    const size_t shardSize = shardStarts[shard + 1] - shardStarts[shard];
+                    if (shardSize == 0)
+                        continue;
+
+                    layer.updateWeightsBatchRange(threadStates[shard][i - 1], threadStates[shard][i], i == layers.size() - 1,
+                        shardSize, rate, firstNeuron, lastNeuron);
+                }
+                layer.stepRange(firstNeuron, lastNeuron);
+            }
+        });
+
+        double lossSum = 0.0;
+        for (double shardLossSum : lossSums)
+            lossSum += shardLossSum;
+        loss = lossSum / (double)count;
+    }
+
+    return loss;
+}
+
+template class DataParallelTrainer<float>;
+template class DataParallelTrainer<double>;
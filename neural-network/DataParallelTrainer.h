@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <vector>
+#include "Arena.h"
+#include "NeuralNetwork.h"
+
+/**
+ * \brief Trains a NeuralNetwork in mini-batches on several threads at once.
+ * Every mini-batch is split into one contiguous shard per thread. Each thread forward propagates its
+ * shard and calculates the error gradients with its own activation and gradient buffers (LayerStates).
+ * Then the threads split the neurons of every layer between them, and each thread adds the weight
+ * changes from all the shards into its neurons, shard by shard in a fixed order. That makes the results
+ * the same every run for a fixed thread count and network seed.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+class DataParallelTrainer
+{
+public:
+    /**
+     * \param network The network to train. Has to outlive the trainer.
+     * \param numThreads How many shards to split every batch into, each run as one task on the global
+     * ThreadPool. 0 uses one per hardware thread.
+     */
+    DataParallelTrainer(BasicNeuralNetwork<Scalar>& network, size_t numThreads = 0);
+
+    /**
+     * \brief Same as NeuralNetwork::trainBatch, but every batch is spread over all threads.
+     * \param trainingData A vector containing a list of input data. Each input is a vector of input values.
+     * \param targetOutput The expected output for each input in the trainingData vector.
+     * \param batchSize How many samples to accumulate before updating the weights.
+     * \return The loss (MSE or cross-entropy) averaged over every sample in the last batch.
+     */
+    double train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput, size_t batchSize);
+
+    size_t threadCount() const { return numThreads; }
+
+protected:
+    /**
+     * \brief Run function(threadIndex) once for every thread index on the global ThreadPool,
+     * and wait for all of them to finish.
+     */
+    template <typename Function>
+    void runOnAllThreads(const Function& function);
+
+    BasicNeuralNetwork<Scalar>& network;
+    size_t numThreads;
+
+    // Holds threadStates. Declared first, so it outlives them.
+    Arena memory;
+
+    // What a single train call needs, reset at the start of every call
+    Arena scratch;
+
+    // One set of activation and gradient buffers per thread
+    std::vector<std::vector<LayerState<Scalar>>> threadStates;
+};
@@ -0,0 +1,74 @@
+﻿#include "HogwildTrainer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+template <typename Scalar>
+HogwildTrainer<Scalar>::HogwildTrainer(BasicNeuralNetwork<Scalar>& network, size_t numThreads)
+    : network(network)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    this->numThreads = numThreads;
+
+    size_t bytes = 0;
+    for (const NetworkLayer<Scalar>& layer : network.layers())
+        bytes += LayerState<Scalar>::memoryBytes(layer.size());
+    memory.reset(numThreads * bytes);
+    scratch.reset(Arena::bytes<double>(numThreads));
+
+    threadStates.reserve(numThreads);
+    for (size_t t = 0; t < numThreads; t++)
+        threadStates.push_back(network.createLayerStates(&memory));
+}
+
+template <typename Scalar>
+double HogwildTrainer<Scalar>::train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput)
+{
+    assert(trainingData.size() == targetOutput.size());
+
+    // The threads already split the samples, splitting the layers too would only add synchronization.
+    // Every layer shares the same pool, so the last one tells which to give back afterwards.
+    ThreadPool* threadPool = network.layers().back().threadPool;
+    network.setThreadPool(nullptr);
+
+    // Samples are handed out one at a time, so a slow thread doesn't hold up the others
+    std::atomic<size_t> nextSample(0);
+    scratch.reset();
+    std::pmr::vector<double> lossSums(numThreads, &scratch);
+
+    ThreadPool::global().parallelFor(0, numThreads, 1, [&](size_t first, size_t last)
+    {
+        for (size_t t = first; t < last; t++)
+        {
+            std::vector<LayerState<Scalar>>& states = threadStates[t];
+            double lossSum = 0.0;
+
+            for (size_t i = nextSample.fetch_add(1, std::memory_order_relaxed); i < trainingData.size();
+                i = nextSample.fetch_add(1, std::memory_order_relaxed))
+            {
+                // Input size does not match the number of inputs for the network
+                assert(trainingData[i].size() == network.inputSize());
+                assert(targetOutput[i].size() == network.outputSize());
+
+                // Reads weights other threads are writing, and writes its changes without any locks
+                network.forwardPass(states, trainingData[i].data());
+                lossSum += network.backwardPass(states, targetOutput[i].data());
+            }
+
+            lossSums[t] = lossSum;
+        }
+    });
+
+    network.setThreadPool(threadPool);
+
+    double lossSum = 0.0;
+    for (double threadLossSum : lossSums)
+        lossSum += threadLossSum;
+    return trainingData.empty() ? 0.0 : lossSum / (double)trainingData.size();
+}
+
+template class HogwildTrainer<float>;
+template class HogwildTrainer<double>;
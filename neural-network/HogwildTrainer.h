@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <vector>
+#include "Arena.h"
+#include "NeuralNetwork.h"
+
+/**
+ * \brief Trains a NeuralNetwork with asynchronous, lock-free SGD on several threads at once (Hogwild).
+ * Every thread takes the next sample from a shared counter, forward and backward propagates it with its own
+ * activation and gradient buffers (LayerStates), and adds its changes straight into the shared weights,
+ * same as train does on one thread. There are no locks around the weights: two threads can read-modify-write
+ * the same weight at the same time, and then one of the two changes is lost. Each change is small and most
+ * of them go to different weights, so this costs little accuracy while every thread runs at full speed.
+ * Results differ from run to run with more than one thread.
+ * Meant for SGD. The other optimizers work too, but the threads race over their collected changes and state
+ * the same way as over the weights.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+class HogwildTrainer
+{
+public:
+    /**
+     * \param network The network to train. Has to outlive the trainer.
+     * \param numThreads How many threads train at once, each run as one task on the global ThreadPool.
+     * 0 uses one per hardware thread.
+     */
+    HogwildTrainer(BasicNeuralNetwork<Scalar>& network, size_t numThreads = 0);
+
+    /**
+     * \brief Same as NeuralNetwork::train, but the samples are spread over all threads, in roughly their order.
+     * Every layer runs on the thread that trains the sample, so the network's thread pool isn't used.
+     * \param trainingData A vector containing a list of input data. Each input is a vector of input values.
+     * \param targetOutput The expected output for each input in the trainingData vector.
+     * \return The loss (MSE or cross-entropy) averaged over every sample.
+     */
+    double train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput);
+
+    size_t threadCount() const { return numThreads; }
+
+protected:
+    BasicNeuralNetwork<Scalar>& network;
+    size_t numThreads;
+
+    // Holds threadStates. Declared first, so it outlives them.
+    Arena memory;
+
+    // What a single train call needs, reset at the start of every call
+    Arena scratch;
+
+    // One set of activation and gradient buffers per thread
+    std::vector<std::vector<LayerState<Scalar>>> threadStates;
+};
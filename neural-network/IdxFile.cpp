@@ -0,0 +1,70 @@
+﻿#include "IdxFile.h"
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    // IDX headers and dimensions are big-endian, whatever the machine
+    uint32_t readBigEndian(const uint8_t* bytes)
+    {
+        return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | (uint32_t)bytes[3];
+    }
+
+    constexpr uint8_t UNSIGNED_BYTE_TYPE = 0x08;
+}
+
+IdxFile::IdxFile(const std::string& path)
+    : file(path)
+{
+    if (!file.isOpen())
+    {
+        std::cerr << "IdxFile: Couldn't open " << path << ".\n";
+        return;
+    }
+
+    // Magic number: two zero bytes, the data type, and the number of dimensions
+    const uint8_t* bytes = file.data();
+    if (file.size() < 4 || bytes[0] != 0 || bytes[1] != 0 || bytes[2] != UNSIGNED_BYTE_TYPE || bytes[3] == 0)
+    {
+        std::cerr << "IdxFile: " << path << " isn't an unsigned byte IDX file.\n";
+        file.close();
+        return;
+    }
+
+    const size_t numDimensions = bytes[3];
+    const size_t headerSize = 4 + 4 * numDimensions;
+    if (file.size() < headerSize)
+    {
+        std::cerr << "IdxFile: " << path << " is cut short.\n";
+        file.close();
+        return;
+    }
+
+    bytesPerItem = 1;
+    for (size_t d = 0; d < numDimensions; d++)
+    {
+        dimensions.push_back(readBigEndian(bytes + 4 + 4 * d));
+        if (d == 0)
+            continue;
+
+        // A corrupt header could wrap the product around to something small enough to pass the size check
+        if (dimensions[d] != 0 && bytesPerItem > std::numeric_limits<size_t>::max() / dimensions[d])
+        {
+            std::cerr << "IdxFile: " << path << " has items too large to address.\n";
+            dimensions.clear();
+            file.close();
+            return;
+        }
+        bytesPerItem *= dimensions[d];
+    }
+
+    if (bytesPerItem == 0 || count() > (file.size() - headerSize) / bytesPerItem)
+    {
+        std::cerr << "IdxFile: " << path << " is too small for its " << count() << " items.\n";
+        dimensions.clear();
+        file.close();
+        return;
+    }
+
+    items = bytes + headerSize;
+}
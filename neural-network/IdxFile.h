@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+/**
+ * \brief A memory-mapped IDX file, the format the MNIST dataset comes in. Items are read straight from the
+ * mapping, so opening a file costs the same however big it is, and files larger than RAM work too.
+ * Only unsigned byte data (type 0x08) is supported, which is what MNIST uses.
+ */
+class IdxFile
+{
+public:
+    /**
+     * \brief A view of bytes owned by someone else, like std::span.
+     */
+    struct Span
+    {
+        const uint8_t* data;
+        size_t size;
+
+        const uint8_t* begin() const { return data; }
+        const uint8_t* end() const { return data + size; }
+        uint8_t operator[](size_t index) const { return data[index]; }
+    };
+
+    IdxFile() = default;
+
+    /**
+     * \brief Map the file at path and read its header. Check isOpen afterwards.
+     */
+    explicit IdxFile(const std::string& path);
+
+    /**
+     * \return false if the file couldn't be mapped, isn't an unsigned byte IDX file, or is cut short.
+     */
+    bool isOpen() const { return items != nullptr; }
+
+    /**
+     * \return The number of items, the first dimension. 60000 for the MNIST training images.
+     */
+    size_t count() const { return dimensions.empty() ? 0 : dimensions[0]; }
+
+    /**
+     * \return The number of bytes in every item, the product of the other dimensions. 28 x 28 for MNIST images, 1 for labels.
+     */
+    size_t itemSize() const { return bytesPerItem; }
+
+    /**
+     * \return The item at index. Points into the mapped file, and stays valid as long as the IdxFile does.
+     */
+    Span item(size_t index) const { return Span{ items + index * bytesPerItem, bytesPerItem }; }
+
+    std::vector<size_t> dimensions;
+
+protected:
+    MappedFile file;
+    const uint8_t* items = nullptr;
+    size_t bytesPerItem = 0;
+};
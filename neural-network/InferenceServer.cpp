@@ -0,0 +1,480 @@
+﻿#include "InferenceServer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <WinSock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    using Socket = SOCKET;
+
+    bool initializeSockets()
+    {
+        static const bool initialized = []
+        {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return initialized;
+    }
+
+    void closeSocket(std::intptr_t socket) { closesocket((Socket)socket); }
+    void shutdownSocket(std::intptr_t socket) { shutdown((Socket)socket, SD_BOTH); }
+    constexpr int SEND_FLAGS = 0;
+
+    int lastSocketError() { return WSAGetLastError(); }
+    std::string socketErrorText(int error) { return "WSA error " + std::to_string(error); }
+    bool isInterrupted(int error) { return error == WSAEINTR || error == WSAECONNRESET; }
+    bool isOutOfResources(int error) { return error == WSAEMFILE || error == WSAENOBUFS; }
+#else
+    using Socket = int;
+
+    bool initializeSockets() { return true; }
+    void closeSocket(std::intptr_t socket) { ::close((Socket)socket); }
+    void shutdownSocket(std::intptr_t socket) { shutdown((Socket)socket, SHUT_RDWR); }
+
+    int lastSocketError() { return errno; }
+    std::string socketErrorText(int error) { return std::strerror(error); }
+    // A signal, or a client that hung up before its connection was accepted
+    bool isInterrupted(int error) { return error == EINTR || error == ECONNABORTED; }
+    // Too many open files or connections, which goes away as clients hang up
+    bool isOutOfResources(int error) { return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM; }
+#ifdef MSG_NOSIGNAL
+    // A client that hung up shouldn't kill the server with SIGPIPE
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+#endif
+
+    /**
+     * Fill in the address of the socket file at path. false if the path doesn't fit.
+     */
+    bool socketAddress(const std::string& path, sockaddr_un& address)
+    {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            std::cerr << "InferenceServer: socket path " << path << " is too long.\n";
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    /**
+     * Read exactly size bytes. false once the other end hung up or the socket failed.
+     */
+    bool readAll(std::intptr_t socket, void* data, size_t size)
+    {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0)
+        {
+            const auto received = recv((Socket)socket, bytes, (int)std::min<size_t>(size, 1 << 30), 0);
+            if (received <= 0)
+                return false;
+            bytes += received;
+            size -= (size_t)received;
+        }
+        return true;
+    }
+
+    bool writeAll(std::intptr_t socket, const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            const auto sent = send((Socket)socket, bytes, (int)std::min<size_t>(size, 1 << 30), SEND_FLAGS);
+            if (sent <= 0)
+                return false;
+            bytes += sent;
+            size -= (size_t)sent;
+        }
+        return true;
+    }
+
+    // How long accept waits after running out of resources, or after an error it doesn't know, before it tries again
+    constexpr std::chrono::milliseconds ACCEPT_BACK_OFF(50);
+
+    // How many of the most recent requests the latency percentiles are over
+    constexpr size_t MAX_LATENCIES = 1 << 16;
+
+    double percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+            return 0.0;
+        const size_t index = std::min(values.size() - 1, (size_t)(fraction * (double)values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+}
+
+template <typename Scalar>
+InferenceServer<Scalar>::InferenceServer(BasicNeuralNetwork<Scalar>& network, size_t maxBatchSize, std::chrono::microseconds maxWait)
+    : network(network), maxBatchSize(std::max<size_t>(1, maxBatchSize)), maxWait(maxWait), listenSocket(-1),
+      queuedSamples(0), stopping(false), numRequests(0), numSamples(0), numBatches(0)
+{
+}
+
+template <typename Scalar>
+InferenceServer<Scalar>::~InferenceServer()
+{
+    stop();
+}
+
+template <typename Scalar>
+bool InferenceServer<Scalar>::start(const std::string& path)
+{
+    if (listenSocket != -1 || !initializeSockets())
+        return false;
+
+    sockaddr_un address;
+    if (!socketAddress(path, address))
+        return false;
+
+    // A socket file left over from an earlier run would make bind fail
+    std::remove(path.c_str());
+
+    const Socket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket == (Socket)-1)
+    {
+        std::cerr << "InferenceServer: couldn't create a socket.\n";
+        return false;
+    }
+    if (bind(socket, (const sockaddr*)&address, sizeof(address)) != 0 || listen(socket, 64) != 0)
+    {
+        std::cerr << "InferenceServer: couldn't listen on " << path << ".\n";
+        closeSocket((std::intptr_t)socket);
+        return false;
+    }
+
+    socketPath = path;
+    listenSocket = (std::intptr_t)socket;
+    stopping = false;
+    batchThread = std::thread(&InferenceServer::batchLoop, this);
+    acceptThread = std::thread(&InferenceServer::acceptLoop, this);
+    return true;
+}
+
+template <typename Scalar>
+void InferenceServer<Scalar>::stop()
+{
+    if (listenSocket == -1)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    requestQueued.notify_all();
+    requestDone.notify_all();
+
+    // Wakes up accept and every recv, so their threads see that the server is stopping
+    shutdownSocket(listenSocket);
+    closeSocket(listenSocket);
+    acceptThread.join();
+
+    // No new connections can come in anymore
+    for (Connection& connection : connections)
+    {
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            if (!connection.finished)
+                shutdownSocket(connection.socket);
+        }
+        connection.thread.join();
+    }
+    connections.clear();
+    batchThread.join();
+
+    queue.clear();
+    queuedSamples = 0;
+
+    std::remove(socketPath.c_str());
+    listenSocket = -1;
+}
+
+template <typename Scalar>
+void InferenceServer<Scalar>::acceptLoop()
+{
+    // Only reported once until accept succeeds again, so a lasting error doesn't flood std::cerr
+    int reportedError = 0;
+    while (true)
+    {
+        const Socket socket = accept((Socket)listenSocket, nullptr, nullptr);
+        if (socket == (Socket)-1)
+        {
+            const int error = lastSocketError();
+            {
+                // The listening socket was closed by stop
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (stopping)
+                    return;
+            }
+
+            if (isInterrupted(error))
+                continue;
+            if (!isOutOfResources(error) && error != reportedError)
+            {
+                std::cerr << "InferenceServer: couldn't accept a connection: " << socketErrorText(error) << ".\n";
+                reportedError = error;
+            }
+            std::this_thread::sleep_for(ACCEPT_BACK_OFF);
+            continue;
+        }
+        reportedError = 0;
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+
+        // Join the threads of clients that have hung up since the last accept
+        for (auto it = connections.begin(); it != connections.end();)
+        {
+            if (it->finished)
+            {
+                it->thread.join();
+                it = connections.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        connections.push_back(Connection{ (std::intptr_t)socket, std::thread(), false });
+        Connection& connection = connections.back();
+        connection.thread = std::thread([this, &connection]
+        {
+            connectionLoop(connection);
+
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            closeSocket(connection.socket);
+            connection.finished = true;
+        });
+    }
+}
+
+template <typename Scalar>
+void InferenceServer<Scalar>::connectionLoop(Connection& client)
+{
+    const std::intptr_t connection = client.socket;
+
+    const InferenceProtocol::Hello hello{ InferenceProtocol::HELLO_MAGIC, (uint32_t)network.inputSize(), (uint32_t)network.outputSize() };
+    if (!writeAll(connection, &hello, sizeof(hello)))
+        return;
+
+    // Reused for every request, so a connection stops allocating once it has seen its largest request
+    std::vector<float> inputs;
+    std::vector<float> outputs;
+
+    InferenceProtocol::RequestHeader header;
+    while (readAll(connection, &header, sizeof(header)))
+    {
+        if (header.magic != InferenceProtocol::REQUEST_MAGIC || header.numSamples == 0 || header.numSamples > InferenceProtocol::MAX_REQUEST_SAMPLES)
+        {
+            std::cerr << "InferenceServer: invalid request header, closing the connection.\n";
+            return;
+        }
+
+        inputs.resize(header.numSamples * network.inputSize());
+        outputs.resize(header.numSamples * network.outputSize());
+        if (!readAll(connection, inputs.data(), inputs.size() * sizeof(float)))
+            return;
+
+        PendingRequest request{ inputs.data(), outputs.data(), header.numSamples, std::chrono::steady_clock::now(), false };
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (stopping)
+                return;
+            queue.push_back(&request);
+            queuedSamples += request.numSamples;
+            requestQueued.notify_one();
+
+            // When stopping, a request still in the queue won't be run anymore, but one the batching thread
+            // already took has to be waited for, since the batch writes into its outputs
+            auto queued = [&] { return std::find(queue.begin(), queue.end(), &request) != queue.end(); };
+            requestDone.wait(lock, [&] { return request.done || (stopping && queued()); });
+            if (!request.done)
+            {
+                queue.erase(std::find(queue.begin(), queue.end(), &request));
+                return;
+            }
+        }
+
+        const InferenceProtocol::ResponseHeader response{ InferenceProtocol::RESPONSE_MAGIC, header.numSamples };
+        if (!writeAll(connection, &response, sizeof(response)) || !writeAll(connection, outputs.data(), outputs.size() * sizeof(float)))
+            return;
+    }
+}
+
+template <typename Scalar>
+void InferenceServer<Scalar>::batchLoop()
+{
+    std::vector<PendingRequest*> batch;
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    while (true)
+    {
+        requestQueued.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (stopping)
+            return;
+
+        // Give the batch until the oldest request has waited maxWait to fill up
+        const std::chrono::steady_clock::time_point deadline = queue.front()->arrival + maxWait;
+        requestQueued.wait_until(lock, deadline, [&] { return stopping || queuedSamples >= maxBatchSize; });
+        if (stopping)
+            return;
+
+        // Oldest first, up to maxBatchSize samples. A request bigger than that goes in a batch of its own.
+        batch.clear();
+        size_t batchSamples = 0;
+        while (!queue.empty() && (batch.empty() || batchSamples + queue.front()->numSamples <= maxBatchSize))
+        {
+            batch.push_back(queue.front());
+            batchSamples += queue.front()->numSamples;
+            queuedSamples -= queue.front()->numSamples;
+            queue.pop_front();
+        }
+
+        lock.unlock();
+        runBatch(batch, batchSamples);
+        const std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+        lock.lock();
+
+        for (PendingRequest* request : batch)
+        {
+            request->done = true;
+            const double latency = std::chrono::duration<double>(finished - request->arrival).count();
+            if (latencies.size() < MAX_LATENCIES)
+                latencies.push_back(latency);
+            else
+                latencies[numRequests % MAX_LATENCIES] = latency;
+            numRequests++;
+        }
+        numSamples += batchSamples;
+        numBatches++;
+        requestDone.notify_all();
+    }
+}
+
+template <typename Scalar>
+void InferenceServer<Scalar>::runBatch(const std::vector<PendingRequest*>& batch, size_t batchSamples)
+{
+    const size_t inputSize = network.inputSize();
+    const size_t outputSize = network.outputSize();
+    batchInputs.resize(batchSamples * inputSize);
+    batchOutputs.resize(batchSamples * outputSize);
+
+    size_t row = 0;
+    for (const PendingRequest* request : batch)
+    {
+        std::copy(request->inputs, request->inputs + request->numSamples * inputSize, batchInputs.begin() + row * inputSize);
+        row += request->numSamples;
+    }
+
+    network.predictBatch(batchInputs.data(), batchSamples, batchOutputs.data());
+
+    row = 0;
+    for (PendingRequest* request : batch)
+    {
+        const auto first = batchOutputs.begin() + row * outputSize;
+        std::transform(first, first + request->numSamples * outputSize, request->outputs, [](Scalar value) { return (float)value; });
+        row += request->numSamples;
+    }
+}
+
+template <typename Scalar>
+InferenceServerStats InferenceServer<Scalar>::stats() const
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    InferenceServerStats stats;
+    stats.requests = numRequests;
+    stats.samples = numSamples;
+    stats.batches = numBatches;
+    stats.p50Latency = percentile(latencies, 0.5);
+    stats.p99Latency = percentile(latencies, 0.99);
+    return stats;
+}
+
+template <typename Scalar>
+void InferenceServer<Scalar>::resetStats()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    numRequests = 0;
+    numSamples = 0;
+    numBatches = 0;
+    latencies.clear();
+}
+
+InferenceClient::~InferenceClient()
+{
+    close();
+}
+
+bool InferenceClient::connect(const std::string& path)
+{
+    close();
+
+    sockaddr_un address;
+    if (!initializeSockets() || !socketAddress(path, address))
+        return false;
+
+    const Socket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket == (Socket)-1)
+        return false;
+    connection = (std::intptr_t)socket;
+
+    InferenceProtocol::Hello hello;
+    if (::connect(socket, (const sockaddr*)&address, sizeof(address)) != 0 || !readAll(connection, &hello, sizeof(hello))
+        || hello.magic != InferenceProtocol::HELLO_MAGIC)
+    {
+        close();
+        return false;
+    }
+
+    numInputs = hello.inputSize;
+    numOutputs = hello.outputSize;
+    return true;
+}
+
+bool InferenceClient::predict(const float* inputs, size_t numSamples, float* outputs)
+{
+    if (connection == -1 || numSamples == 0 || numSamples > InferenceProtocol::MAX_REQUEST_SAMPLES)
+        return false;
+
+    const InferenceProtocol::RequestHeader header{ InferenceProtocol::REQUEST_MAGIC, (uint32_t)numSamples };
+    InferenceProtocol::ResponseHeader response;
+    if (!writeAll(connection, &header, sizeof(header)) || !writeAll(connection, inputs, numSamples * numInputs * sizeof(float))
+        || !readAll(connection, &response, sizeof(response)) || response.magic != InferenceProtocol::RESPONSE_MAGIC
+        || response.numSamples != numSamples || !readAll(connection, outputs, numSamples * numOutputs * sizeof(float)))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void InferenceClient::close()
+{
+    if (connection == -1)
+        return;
+    closeSocket(connection);
+    connection = -1;
+}
+
+template class InferenceServer<float>;
+template class InferenceServer<double>;
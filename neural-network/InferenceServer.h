@@ -0,0 +1,199 @@
+﻿#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NeuralNetwork.h"
+
+/**
+ * \brief The binary protocol of InferenceServer. Every field is in the host's byte order, since both
+ * ends run on the same host, and every value is a float32.
+ * - Right after connecting, the server sends a Hello with the network's input and output sizes.
+ * - The client sends a RequestHeader followed by numSamples x inputSize values, row-major.
+ * - The server answers with a ResponseHeader followed by numSamples x outputSize values.
+ * A connection has one request in flight at a time. Clients open more connections for more concurrency.
+ */
+namespace InferenceProtocol
+{
+    constexpr uint32_t HELLO_MAGIC = 0x4F4C4548; // "HELO"
+    constexpr uint32_t REQUEST_MAGIC = 0x51524E4E; // "NNRQ"
+    constexpr uint32_t RESPONSE_MAGIC = 0x53524E4E; // "NNRS"
+
+    // Requests with more samples than this are rejected, and the connection closed
+    constexpr uint32_t MAX_REQUEST_SAMPLES = 4096;
+
+    struct Hello
+    {
+        uint32_t magic;
+        uint32_t inputSize;
+        uint32_t outputSize;
+    };
+
+    struct RequestHeader
+    {
+        uint32_t magic;
+        uint32_t numSamples;
+    };
+
+    struct ResponseHeader
+    {
+        uint32_t magic;
+        uint32_t numSamples;
+    };
+}
+
+/**
+ * \brief Counters and server-side latencies since the server started or resetStats was last called.
+ * A request's latency runs from having read it off the socket to having its outputs ready, so it
+ * includes the time spent waiting for a batch.
+ */
+struct InferenceServerStats
+{
+    uint64_t requests = 0;
+    uint64_t samples = 0;
+    uint64_t batches = 0;
+    double p50Latency = 0.0; // Seconds
+    double p99Latency = 0.0; // Seconds
+
+    double meanBatchSize() const { return batches == 0 ? 0.0 : (double)samples / (double)batches; }
+};
+
+/**
+ * \brief Serves a network to other processes on the same host over a Unix domain socket, see InferenceProtocol.
+ * Requests that arrive at about the same time are batched into one predictBatch, so every weight is loaded
+ * once per batch instead of once per request. A thread per connection reads the requests and queues them.
+ * One batching thread waits until the queue holds maxBatchSize samples or its oldest request has waited
+ * maxWait, then runs everything it took as one batch and hands every connection its outputs.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+class InferenceServer
+{
+public:
+    /**
+     * \param network The network to serve. Only the batching thread uses it while the server runs,
+     * and it has to outlive the server.
+     * \param maxBatchSize The most samples in one batch. 1 turns batching off.
+     * \param maxWait How long the oldest request waits for more to fill up its batch.
+     */
+    InferenceServer(BasicNeuralNetwork<Scalar>& network, size_t maxBatchSize = 64,
+        std::chrono::microseconds maxWait = std::chrono::microseconds(500));
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    /**
+     * \brief Listen on a Unix domain socket at path, replacing any file that is already there.
+     * \return false if the socket couldn't be created, the reason is written to std::cerr.
+     */
+    bool start(const std::string& path);
+
+    /**
+     * \brief Close every connection, wait for all threads to finish and remove the socket file.
+     */
+    void stop();
+
+    InferenceServerStats stats() const;
+    void resetStats();
+
+protected:
+    struct PendingRequest
+    {
+        const float* inputs;
+        float* outputs;
+        size_t numSamples;
+        std::chrono::steady_clock::time_point arrival;
+        bool done;
+    };
+
+    struct Connection
+    {
+        std::intptr_t socket;
+        std::thread thread;
+        bool finished;
+    };
+
+    void acceptLoop();
+    void connectionLoop(Connection& connection);
+    void batchLoop();
+
+    /**
+     * \brief Run the requests as one batch through the network, and fill in their outputs.
+     */
+    void runBatch(const std::vector<PendingRequest*>& batch, size_t numSamples);
+
+    BasicNeuralNetwork<Scalar>& network;
+    size_t maxBatchSize;
+    std::chrono::microseconds maxWait;
+
+    std::string socketPath;
+    std::intptr_t listenSocket;
+    std::thread acceptThread;
+    std::thread batchThread;
+
+    // Guards connections. Finished connections are cleaned up by the next accept.
+    std::mutex connectionMutex;
+    std::list<Connection> connections;
+
+    // Guards everything below, down to the stats
+    mutable std::mutex queueMutex;
+    std::condition_variable requestQueued;
+    std::condition_variable requestDone;
+    std::deque<PendingRequest*> queue;
+    size_t queuedSamples;
+    bool stopping;
+
+    uint64_t numRequests;
+    uint64_t numSamples;
+    uint64_t numBatches;
+    // Of the most recent requests, so a long-running server doesn't keep growing
+    std::vector<double> latencies;
+
+    // Only used by the batching thread
+    std::vector<Scalar> batchInputs;
+    std::vector<Scalar> batchOutputs;
+};
+
+/**
+ * \brief Blocking client for InferenceServer, one request at a time over one connection.
+ */
+class InferenceClient
+{
+public:
+    InferenceClient() = default;
+    ~InferenceClient();
+
+    InferenceClient(const InferenceClient&) = delete;
+    InferenceClient& operator=(const InferenceClient&) = delete;
+
+    /**
+     * \brief Connect to the server listening at path and read its input and output sizes.
+     */
+    bool connect(const std::string& path);
+
+    /**
+     * \brief Send one request and wait for its response.
+     * \param inputs numSamples x inputSize() values, row-major.
+     * \param outputs Receives numSamples x outputSize() values.
+     * \return false if the connection failed, after which the client is closed.
+     */
+    bool predict(const float* inputs, size_t numSamples, float* outputs);
+
+    void close();
+
+    bool isOpen() const { return connection != -1; }
+    size_t inputSize() const { return numInputs; }
+    size_t outputSize() const { return numOutputs; }
+
+protected:
+    std::intptr_t connection = -1;
+    size_t numInputs = 0;
+    size_t numOutputs = 0;
+};
@@ -0,0 +1,285 @@
+﻿#include "Kernels.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define NN_CPUID_MSVC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define NN_CPUID_GNU
+#endif
+
+#include "KernelsImpl.h"
+
+namespace
+{
+    /**
+     * Portable fallback, one value at a time. Compiled with the project's default target options.
+     */
+    template <typename T>
+    struct ScalarOps
+    {
+        using Scalar = T;
+        using Vec = T;
+        static constexpr size_t WIDTH = 1;
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 4;
+
+        static Vec zero() { return T(0); }
+        static Vec load(const T* p) { return *p; }
+        static void store(T* p, Vec v) { *p = v; }
+        static Vec set1(T value) { return value; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return a * b + c; }
+        static Vec sub(Vec a, Vec b) { return a - b; }
+        static Vec mul(Vec a, Vec b) { return a * b; }
+        static Vec div(Vec a, Vec b) { return a / b; }
+        static Vec sqrt(Vec a) { return std::sqrt(a); }
+        static Vec min(Vec a, Vec b) { return a < b ? a : b; }
+        static Vec max(Vec a, Vec b) { return a > b ? a : b; }
+        // 2^n for a whole number n in the normal exponent range, built directly from the exponent bits
+        static Vec pow2(Vec n)
+        {
+            constexpr int mantissaBits = std::numeric_limits<T>::digits - 1;
+            constexpr int exponentBias = std::numeric_limits<T>::max_exponent - 1;
+            using Bits = typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type;
+
+            const Bits bits = (Bits)((int)n + exponentBias) << mantissaBits;
+            T result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+        static T sum(Vec v) { return v; }
+    };
+
+    template <typename Scalar>
+    constexpr Kernels::KernelTable<Scalar> scalarTable = NN_KERNEL_TABLE(ScalarOps<Scalar>);
+
+    struct ScalarInt8Ops
+    {
+        using Wide = int32_t;
+        using Vec = int32_t;
+        static constexpr size_t WIDTH = 1;
+
+        static Vec zero() { return 0; }
+        static Wide load(const int8_t* p) { return *p; }
+        static Vec madd(Wide a, Wide b, Vec c) { return c + a * b; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static int32_t sum(Vec v) { return v; }
+    };
+
+    constexpr Kernels::Int8KernelTable scalarInt8Table = NN_INT8_KERNEL_TABLE(ScalarInt8Ops);
+
+    struct CpuFeatures
+    {
+        bool sse2 = false;
+        bool avx2 = false;
+        bool avx512 = false;
+    };
+
+    CpuFeatures detectCpuFeatures()
+    {
+        CpuFeatures features;
+
+#if defined(NN_CPUID_MSVC) || defined(NN_CPUID_GNU)
+        unsigned int leaf1[4] = {};
+        unsigned int leaf7[4] = {};
+        unsigned long long xcr0 = 0;
+
+#if defined(NN_CPUID_MSVC)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuidex(info, 1, 0);
+        for (int i = 0; i < 4; i++) leaf1[i] = (unsigned int)info[i];
+        if (maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            for (int i = 0; i < 4; i++) leaf7[i] = (unsigned int)info[i];
+        }
+        const bool osxsave = (leaf1[2] >> 27) & 1;
+        if (osxsave)
+            xcr0 = _xgetbv(0);
+#else
+        const unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+        __cpuid_count(1, 0, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+        if (maxLeaf >= 7)
+            __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+        const bool osxsave = (leaf1[2] >> 27) & 1;
+        if (osxsave)
+        {
+            unsigned int eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            xcr0 = ((unsigned long long)edx << 32) | eax;
+        }
+#endif
+
+        // The OS has to save the wider registers on context switches, not just the CPU support them
+        const bool osSavesYmm = (xcr0 & 0x6) == 0x6;
+        const bool osSavesZmm = (xcr0 & 0xE6) == 0xE6;
+
+        const bool avx = (leaf1[2] >> 28) & 1;
+        const bool fma = (leaf1[2] >> 12) & 1;
+
+        features.sse2 = (leaf1[3] >> 26) & 1;
+        features.avx2 = avx && fma && osSavesYmm && ((leaf7[1] >> 5) & 1);
+        // F for the floating point kernels, BW for the int8 ones
+        features.avx512 = features.avx2 && osSavesZmm && ((leaf7[1] >> 16) & 1) && ((leaf7[1] >> 30) & 1);
+#endif
+
+        return features;
+    }
+
+    const CpuFeatures& cpuFeatures()
+    {
+        static const CpuFeatures features = detectCpuFeatures();
+        return features;
+    }
+
+    template <typename Scalar>
+    std::atomic<const Kernels::KernelTable<Scalar>*> activeTable{ nullptr };
+    std::atomic<const Kernels::Int8KernelTable*> activeInt8Table{ nullptr };
+    std::atomic<Kernels::Isa> currentIsa{ Kernels::Isa::Scalar };
+}
+
+namespace Kernels
+{
+    // Defined in the per-instruction set translation units, for float and double
+    template <typename Scalar> const KernelTable<Scalar>* sseKernelTable();
+    template <typename Scalar> const KernelTable<Scalar>* avx2KernelTable();
+    template <typename Scalar> const KernelTable<Scalar>* avx512KernelTable();
+    template <> const KernelTable<float>* sseKernelTable<float>();
+    template <> const KernelTable<double>* sseKernelTable<double>();
+    template <> const KernelTable<float>* avx2KernelTable<float>();
+    template <> const KernelTable<double>* avx2KernelTable<double>();
+    template <> const KernelTable<float>* avx512KernelTable<float>();
+    template <> const KernelTable<double>* avx512KernelTable<double>();
+    const Int8KernelTable* sseInt8KernelTable();
+    const Int8KernelTable* avx2Int8KernelTable();
+    const Int8KernelTable* avx512Int8KernelTable();
+
+    bool isSupported(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::Scalar:
+            return true;
+        case Isa::SSE:
+            return cpuFeatures().sse2 && sseKernelTable<double>() != nullptr;
+        case Isa::AVX2:
+            return cpuFeatures().avx2 && avx2KernelTable<double>() != nullptr;
+        case Isa::AVX512:
+            return cpuFeatures().avx512 && avx512KernelTable<double>() != nullptr;
+        default:
+            return false;
+        }
+    }
+
+    template <typename Scalar>
+    const KernelTable<Scalar>* table(Isa isa)
+    {
+        if (!isSupported(isa))
+            return nullptr;
+
+        switch (isa)
+        {
+        case Isa::SSE:
+            return sseKernelTable<Scalar>();
+        case Isa::AVX2:
+            return avx2KernelTable<Scalar>();
+        case Isa::AVX512:
+            return avx512KernelTable<Scalar>();
+        default:
+            return &scalarTable<Scalar>;
+        }
+    }
+
+    template const KernelTable<float>* table<float>(Isa isa);
+    template const KernelTable<double>* table<double>(Isa isa);
+
+    const Int8KernelTable* int8Table(Isa isa)
+    {
+        if (!isSupported(isa))
+            return nullptr;
+
+        switch (isa)
+        {
+        case Isa::SSE:
+            return sseInt8KernelTable();
+        case Isa::AVX2:
+            return avx2Int8KernelTable();
+        case Isa::AVX512:
+            return avx512Int8KernelTable();
+        default:
+            return &scalarInt8Table;
+        }
+    }
+
+    bool setIsa(Isa isa)
+    {
+        if (!isSupported(isa))
+            return false;
+
+        // activeInt8 relies on the int8 table being stored before the double one
+        currentIsa.store(isa);
+        activeInt8Table.store(int8Table(isa));
+        activeTable<float>.store(table<float>(isa));
+        activeTable<double>.store(table<double>(isa));
+        return true;
+    }
+
+    Isa activeIsa()
+    {
+        active<double>();
+        return currentIsa.load();
+    }
+
+    const char* isaName(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::Scalar:
+            return "Scalar";
+        case Isa::SSE:
+            return "SSE2";
+        case Isa::AVX2:
+            return "AVX2";
+        case Isa::AVX512:
+            return "AVX-512";
+        default:
+            return "Unknown";
+        }
+    }
+
+    template <typename Scalar>
+    const KernelTable<Scalar>& active()
+    {
+        const KernelTable<Scalar>* kernels = activeTable<Scalar>.load(std::memory_order_acquire);
+        if (kernels == nullptr)
+        {
+            // First call, pick the widest instruction set the CPU supports
+            for (Isa isa : { Isa::AVX512, Isa::AVX2, Isa::SSE, Isa::Scalar })
+            {
+                if (setIsa(isa))
+                    break;
+            }
+            kernels = activeTable<Scalar>.load(std::memory_order_acquire);
+        }
+        return *kernels;
+    }
+
+    template const KernelTable<float>& active<float>();
+    template const KernelTable<double>& active<double>();
+
+    const Int8KernelTable& activeInt8()
+    {
+        if (activeInt8Table.load(std::memory_order_acquire) == nullptr)
+            active<double>();
+        return *activeInt8Table.load(std::memory_order_acquire);
+    }
+}
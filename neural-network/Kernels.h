@@ -0,0 +1,206 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Small library of dense linear algebra kernels used by the network's hot paths.
+ * Every kernel has a portable scalar version plus SSE2, AVX2 and AVX-512 versions, for float, double
+ * and (for quantized inference) int8. The fastest version the CPU supports is picked at runtime (CPUID)
+ * the first time a kernel is called. All matrices are row-major and tightly packed.
+ */
+namespace Kernels
+{
+    enum class Isa
+    {
+        Scalar,
+        SSE,
+        AVX2,
+        AVX512
+    };
+
+    /**
+     * \brief One implementation of every kernel, for a single instruction set and scalar type.
+     */
+    template <typename Scalar>
+    struct KernelTable
+    {
+        // Returns sum(a[i] * b[i])
+        Scalar (*dot)(const Scalar* a, const Scalar* b, size_t n);
+
+        // y += alpha * x
+        void (*axpy)(Scalar alpha, const Scalar* x, Scalar* y, size_t n);
+
+        // y = A * x, where A is rows x cols
+        void (*gemv)(const Scalar* A, const Scalar* x, Scalar* y, size_t rows, size_t cols);
+
+        // y += A^T * x, where A is rows x cols with rows lda apart. y has cols elements.
+        // lda lets A be a column slice of a wider matrix.
+        void (*gemvTransposed)(const Scalar* A, size_t lda, const Scalar* x, Scalar* y, size_t rows, size_t cols);
+
+        // A += alpha * x * y^T (outer product update), where A is rows x cols
+        void (*ger)(Scalar alpha, const Scalar* x, const Scalar* y, Scalar* A, size_t rows, size_t cols);
+
+        // C += A * B^T, where A is M x K, B is N x K and C is M x N
+        void (*gemmNT)(const Scalar* A, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K);
+
+        // C += A * B, where A is M x K, B is K x N and C is M x N
+        void (*gemmNN)(const Scalar* A, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K);
+
+        // C += alpha * A^T * B, where A is K x M with rows lda apart, B is K x N and C is M x N.
+        // lda lets A be a column slice of a wider matrix.
+        void (*gemmTN)(Scalar alpha, const Scalar* A, size_t lda, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K);
+
+        // y = A * x, where A is rows x cols and x is sparse: nnz non-zero values at the given column indices
+        void (*sparseGemv)(const Scalar* A, const uint32_t* indices, const Scalar* values, size_t nnz, Scalar* y, size_t rows, size_t cols);
+
+        // A += alpha * x * y^T, where A is rows x cols and y is sparse: nnz non-zero values at the given column indices
+        void (*sparseGer)(Scalar alpha, const Scalar* x, const uint32_t* indices, const Scalar* values, size_t nnz, Scalar* A, size_t rows, size_t cols);
+
+        // y = A * x, where A is a sparse matrix with the given number of rows in CSR form: row r holds
+        // values[rowStarts[r] .. rowStarts[r + 1]), at the matching columns
+        void (*csrGemv)(const Scalar* values, const uint32_t* columns, const uint32_t* rowStarts, const Scalar* x, Scalar* y, size_t rows);
+
+        // C += B * A^T, where A is a CSR matrix like for csrGemv, B is M x K and C is M x rows
+        void (*csrGemmNT)(const Scalar* values, const uint32_t* columns, const uint32_t* rowStarts, size_t rows,
+            const Scalar* B, size_t K, Scalar* C, size_t M);
+
+        // Polynomial approximations, y[i] = f(x[i]). x and y can be the same array. Maximum error over the whole input
+        // range, measured against libm by BenchmarkActivations:
+        //   exp:     relative 9.7e-8 (float), 3.9e-16 (double). Inputs too small for a normal result give the smallest normal number.
+        //   sigmoid: absolute 8.9e-8 (float), 1.7e-16 (double)
+        //   tanh:    absolute 1.8e-7 (float), 3.4e-16 (double)
+        // NaN inputs are not handled.
+        void (*expApprox)(const Scalar* x, Scalar* y, size_t n);
+        void (*sigmoidApprox)(const Scalar* x, Scalar* y, size_t n);
+        void (*tanhApprox)(const Scalar* x, Scalar* y, size_t n);
+
+        // Optimizer steps over n parameters, one pass over every array. changes holds the changes collected since
+        // the last step (the negative gradient) and is cleared to 0. rate is the learning rate.
+        //   momentumStep: velocity = momentum * velocity + changes, parameters += rate * velocity
+        //   nesterovStep: the same, but parameters += rate * (changes + momentum * velocity)
+        //   adamStep:     first = beta1 * first + (1 - beta1) * changes, second = beta2 * second + (1 - beta2) * changes^2,
+        //                 parameters += rate * first / (sqrt(second) + epsilon) - decay * parameters
+        void (*momentumStep)(Scalar rate, Scalar momentum, Scalar* parameters, Scalar* changes, Scalar* velocity, size_t n);
+        void (*nesterovStep)(Scalar rate, Scalar momentum, Scalar* parameters, Scalar* changes, Scalar* velocity, size_t n);
+        void (*adamStep)(Scalar rate, Scalar beta1, Scalar beta2, Scalar epsilon, Scalar decay, Scalar* parameters, Scalar* changes,
+            Scalar* first, Scalar* second, size_t n);
+    };
+
+    /**
+     * \brief Integer kernels for quantized inference. int8 inputs, exact int32 accumulation.
+     */
+    struct Int8KernelTable
+    {
+        // Returns sum(a[i] * b[i])
+        int32_t (*dot)(const int8_t* a, const int8_t* b, size_t n);
+
+        // y = A * x, where A is rows x cols
+        void (*gemv)(const int8_t* A, const int8_t* x, int32_t* y, size_t rows, size_t cols);
+    };
+
+    /**
+     * \return Whether this CPU (and OS) can run the given instruction set.
+     */
+    bool isSupported(Isa isa);
+
+    /**
+     * \return The instruction set the kernels currently dispatch to.
+     */
+    Isa activeIsa();
+
+    /**
+     * \brief Force the kernels to use a specific instruction set, e.g. for benchmarking.
+     * Applies to the float and the double kernels.
+     * \return False if the instruction set isn't supported, in which case nothing changes.
+     */
+    bool setIsa(Isa isa);
+
+    const char* isaName(Isa isa);
+
+    /**
+     * \return The kernels for the given instruction set, or nullptr if it isn't supported.
+     * Defined for float and double.
+     */
+    template <typename Scalar>
+    const KernelTable<Scalar>* table(Isa isa);
+
+    /**
+     * \return The kernels for the active instruction set. Defined for float and double.
+     */
+    template <typename Scalar>
+    const KernelTable<Scalar>& active();
+
+    /**
+     * \return The int8 kernels for the given instruction set, or nullptr if it isn't supported.
+     */
+    const Int8KernelTable* int8Table(Isa isa);
+
+    /**
+     * \return The int8 kernels for the active instruction set.
+     */
+    const Int8KernelTable& activeInt8();
+
+    inline int32_t dotInt8(const int8_t* a, const int8_t* b, size_t n) { return activeInt8().dot(a, b, n); }
+    inline void gemvInt8(const int8_t* A, const int8_t* x, int32_t* y, size_t rows, size_t cols) { activeInt8().gemv(A, x, y, rows, cols); }
+
+    template <typename Scalar>
+    inline Scalar dot(const Scalar* a, const Scalar* b, size_t n) { return active<Scalar>().dot(a, b, n); }
+    template <typename Scalar>
+    inline void axpy(Scalar alpha, const Scalar* x, Scalar* y, size_t n) { active<Scalar>().axpy(alpha, x, y, n); }
+    template <typename Scalar>
+    inline void gemv(const Scalar* A, const Scalar* x, Scalar* y, size_t rows, size_t cols) { active<Scalar>().gemv(A, x, y, rows, cols); }
+    template <typename Scalar>
+    inline void gemvTransposed(const Scalar* A, size_t lda, const Scalar* x, Scalar* y, size_t rows, size_t cols) { active<Scalar>().gemvTransposed(A, lda, x, y, rows, cols); }
+    template <typename Scalar>
+    inline void ger(Scalar alpha, const Scalar* x, const Scalar* y, Scalar* A, size_t rows, size_t cols) { active<Scalar>().ger(alpha, x, y, A, rows, cols); }
+    template <typename Scalar>
+    inline void gemmNT(const Scalar* A, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K) { active<Scalar>().gemmNT(A, B, C, M, N, K); }
+    template <typename Scalar>
+    inline void gemmNN(const Scalar* A, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K) { active<Scalar>().gemmNN(A, B, C, M, N, K); }
+    template <typename Scalar>
+    inline void gemmTN(Scalar alpha, const Scalar* A, size_t lda, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K) { active<Scalar>().gemmTN(alpha, A, lda, B, C, M, N, K); }
+    template <typename Scalar>
+    inline void sparseGemv(const Scalar* A, const uint32_t* indices, const Scalar* values, size_t nnz, Scalar* y, size_t rows, size_t cols)
+    {
+        active<Scalar>().sparseGemv(A, indices, values, nnz, y, rows, cols);
+    }
+    template <typename Scalar>
+    inline void sparseGer(Scalar alpha, const Scalar* x, const uint32_t* indices, const Scalar* values, size_t nnz, Scalar* A, size_t rows, size_t cols)
+    {
+        active<Scalar>().sparseGer(alpha, x, indices, values, nnz, A, rows, cols);
+    }
+    template <typename Scalar>
+    inline void csrGemv(const Scalar* values, const uint32_t* columns, const uint32_t* rowStarts, const Scalar* x, Scalar* y, size_t rows)
+    {
+        active<Scalar>().csrGemv(values, columns, rowStarts, x, y, rows);
+    }
+    template <typename Scalar>
+    inline void csrGemmNT(const Scalar* values, const uint32_t* columns, const uint32_t* rowStarts, size_t rows,
+        const Scalar* B, size_t K, Scalar* C, size_t M)
+    {
+        active<Scalar>().csrGemmNT(values, columns, rowStarts, rows, B, K, C, M);
+    }
+    template <typename Scalar>
+    inline void expApprox(const Scalar* x, Scalar* y, size_t n) { active<Scalar>().expApprox(x, y, n); }
+    template <typename Scalar>
+    inline void sigmoidApprox(const Scalar* x, Scalar* y, size_t n) { active<Scalar>().sigmoidApprox(x, y, n); }
+    template <typename Scalar>
+    inline void tanhApprox(const Scalar* x, Scalar* y, size_t n) { active<Scalar>().tanhApprox(x, y, n); }
+    template <typename Scalar>
+    inline void momentumStep(Scalar rate, Scalar momentum, Scalar* parameters, Scalar* changes, Scalar* velocity, size_t n)
+    {
+        active<Scalar>().momentumStep(rate, momentum, parameters, changes, velocity, n);
+    }
+    template <typename Scalar>
+    inline void nesterovStep(Scalar rate, Scalar momentum, Scalar* parameters, Scalar* changes, Scalar* velocity, size_t n)
+    {
+        active<Scalar>().nesterovStep(rate, momentum, parameters, changes, velocity, n);
+    }
+    template <typename Scalar>
+    inline void adamStep(Scalar rate, Scalar beta1, Scalar beta2, Scalar epsilon, Scalar decay, Scalar* parameters, Scalar* changes,
+        Scalar* first, Scalar* second, size_t n)
+    {
+        active<Scalar>().adamStep(rate, beta1, beta2, epsilon, decay, parameters, changes, first, second, n);
+    }
+}
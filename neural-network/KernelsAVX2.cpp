@@ -0,0 +1,143 @@
+﻿#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NN_KERNELS_X86
+
+#include <immintrin.h>
+
+// Compile only the kernels below for AVX2 + FMA. Dispatch makes sure they are never called on a CPU without it.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "KernelsImpl.h"
+
+namespace
+{
+    struct AVX2DoubleOps
+    {
+        using Scalar = double;
+        using Vec = __m256d;
+        static constexpr size_t WIDTH = 4;
+
+        // Register tile for gemmNT, sized for 16 ymm registers: 8 accumulators + 4 A loads + 1 B load
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 2;
+
+        static Vec zero() { return _mm256_setzero_pd(); }
+        static Vec load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+        static Vec set1(double value) { return _mm256_set1_pd(value); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+        static Vec div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+        static Vec sqrt(Vec a) { return _mm256_sqrt_pd(a); }
+        static Vec min(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+        static Vec pow2(Vec n) { return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n, set1(4503599627370496.0 + 1023.0))), 52)); }
+        static double sum(Vec v)
+        {
+            const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        }
+    };
+
+    struct AVX2FloatOps
+    {
+        using Scalar = float;
+        using Vec = __m256;
+        static constexpr size_t WIDTH = 8;
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 2;
+
+        static Vec zero() { return _mm256_setzero_ps(); }
+        static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+        static Vec set1(float value) { return _mm256_set1_ps(value); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        static Vec div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+        static Vec sqrt(Vec a) { return _mm256_sqrt_ps(a); }
+        static Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+        static Vec pow2(Vec n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_castps_si256(_mm256_add_ps(n, set1(8388608.0f + 127.0f))), 23)); }
+        static float sum(Vec v)
+        {
+            const __m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            const __m128 pairs = _mm_add_ps(half, _mm_movehl_ps(half, half));
+            return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+        }
+    };
+
+    struct AVX2Int8Ops
+    {
+        using Wide = __m256i;
+        using Vec = __m256i;
+        static constexpr size_t WIDTH = 16;
+
+        static Vec zero() { return _mm256_setzero_si256(); }
+        static Wide load(const int8_t* p) { return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)p)); }
+        static Vec madd(Wide a, Wide b, Vec c) { return _mm256_add_epi32(c, _mm256_madd_epi16(a, b)); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+        static int32_t sum(Vec v)
+        {
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+            return _mm_cvtsi128_si32(half);
+        }
+    };
+
+    constexpr Kernels::KernelTable<double> avx2DoubleTable = NN_KERNEL_TABLE(AVX2DoubleOps);
+    constexpr Kernels::KernelTable<float> avx2FloatTable = NN_KERNEL_TABLE(AVX2FloatOps);
+    constexpr Kernels::Int8KernelTable avx2Int8Table = NN_INT8_KERNEL_TABLE(AVX2Int8Ops);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
+
+namespace Kernels
+{
+    template <typename Scalar> const KernelTable<Scalar>* avx2KernelTable();
+
+    template <>
+    const KernelTable<double>* avx2KernelTable<double>()
+    {
+#ifdef NN_KERNELS_X86
+        return &avx2DoubleTable;
+#else
+        return nullptr;
+#endif
+    }
+
+    template <>
+    const KernelTable<float>* avx2KernelTable<float>()
+    {
+#ifdef NN_KERNELS_X86
+        return &avx2FloatTable;
+#else
+        return nullptr;
+#endif
+    }
+
+    const Int8KernelTable* avx2Int8KernelTable()
+    {
+#ifdef NN_KERNELS_X86
+        return &avx2Int8Table;
+#else
+        return nullptr;
+#endif
+    }
+}
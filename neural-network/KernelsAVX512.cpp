@@ -0,0 +1,153 @@
+﻿#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NN_KERNELS_X86
+
+#include <immintrin.h>
+
+// Compile only the kernels below for AVX-512F + BW (BW for the 16-bit integer ops of the int8 kernels).
+// Dispatch makes sure they are never called on a CPU without them.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+#endif
+
+#include "KernelsImpl.h"
+
+namespace
+{
+    struct AVX512DoubleOps
+    {
+        using Scalar = double;
+        using Vec = __m512d;
+        static constexpr size_t WIDTH = 8;
+
+        // Register tile for gemmNT, sized for 32 zmm registers: 16 accumulators + 4 A loads + 1 B load
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 4;
+
+        static Vec zero() { return _mm512_setzero_pd(); }
+        static Vec load(const double* p) { return _mm512_loadu_pd(p); }
+        static void store(double* p, Vec v) { _mm512_storeu_pd(p, v); }
+        static Vec set1(double value) { return _mm512_set1_pd(value); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+        static Vec div(Vec a, Vec b) { return _mm512_div_pd(a, b); }
+        // min, max, sqrt and pow2 use the zero-masked forms with every lane enabled. The plain ones start from an
+        // undefined vector, which GCC 12 warns about as maybe-uninitialized once they are inlined.
+        static Vec min(Vec a, Vec b) { return _mm512_maskz_min_pd(0xFF, a, b); }
+        static Vec max(Vec a, Vec b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+        static Vec sqrt(Vec a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+        static Vec pow2(Vec n) { return _mm512_castsi512_pd(_mm512_maskz_slli_epi64(0xFF, _mm512_castpd_si512(_mm512_add_pd(n, set1(4503599627370496.0 + 1023.0))), 52)); }
+        static double sum(Vec v)
+        {
+            // Through memory rather than _mm512_reduce_add_pd, which trips -Wuninitialized in some GCC versions
+            double lanes[WIDTH];
+            _mm512_storeu_pd(lanes, v);
+            return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+        }
+    };
+
+    struct AVX512FloatOps
+    {
+        using Scalar = float;
+        using Vec = __m512;
+        static constexpr size_t WIDTH = 16;
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 4;
+
+        static Vec zero() { return _mm512_setzero_ps(); }
+        static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+        static void store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+        static Vec set1(float value) { return _mm512_set1_ps(value); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        static Vec div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+        static Vec min(Vec a, Vec b) { return _mm512_maskz_min_ps(0xFFFF, a, b); }
+        static Vec max(Vec a, Vec b) { return _mm512_maskz_max_ps(0xFFFF, a, b); }
+        static Vec sqrt(Vec a) { return _mm512_maskz_sqrt_ps(0xFFFF, a); }
+        static Vec pow2(Vec n) { return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xFFFF, _mm512_castps_si512(_mm512_add_ps(n, set1(8388608.0f + 127.0f))), 23)); }
+        static float sum(Vec v)
+        {
+            float lanes[WIDTH];
+            _mm512_storeu_ps(lanes, v);
+            float total = 0.0f;
+            for (size_t i = 0; i < WIDTH; i++)
+                total += lanes[i];
+            return total;
+        }
+    };
+
+    struct AVX512Int8Ops
+    {
+        using Wide = __m512i;
+        using Vec = __m512i;
+        static constexpr size_t WIDTH = 32;
+
+        static Vec zero() { return _mm512_setzero_si512(); }
+        static Wide load(const int8_t* p) { return _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)p)); }
+        static Vec madd(Wide a, Wide b, Vec c) { return _mm512_add_epi32(c, _mm512_madd_epi16(a, b)); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_epi32(a, b); }
+        static int32_t sum(Vec v)
+        {
+            int32_t lanes[16];
+            _mm512_storeu_si512(lanes, v);
+            int32_t total = 0;
+            for (size_t i = 0; i < 16; i++)
+                total += lanes[i];
+            return total;
+        }
+    };
+
+    constexpr Kernels::KernelTable<double> avx512DoubleTable = NN_KERNEL_TABLE(AVX512DoubleOps);
+    constexpr Kernels::KernelTable<float> avx512FloatTable = NN_KERNEL_TABLE(AVX512FloatOps);
+    constexpr Kernels::Int8KernelTable avx512Int8Table = NN_INT8_KERNEL_TABLE(AVX512Int8Ops);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
+
+namespace Kernels
+{
+    template <typename Scalar> const KernelTable<Scalar>* avx512KernelTable();
+
+    template <>
+    const KernelTable<double>* avx512KernelTable<double>()
+    {
+#ifdef NN_KERNELS_X86
+        return &avx512DoubleTable;
+#else
+        return nullptr;
+#endif
+    }
+
+    template <>
+    const KernelTable<float>* avx512KernelTable<float>()
+    {
+#ifdef NN_KERNELS_X86
+        return &avx512FloatTable;
+#else
+        return nullptr;
+#endif
+    }
+
+    const Int8KernelTable* avx512Int8KernelTable()
+    {
+#ifdef NN_KERNELS_X86
+        return &avx512Int8Table;
+#else
+        return nullptr;
+#endif
+    }
+}
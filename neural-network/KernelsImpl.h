@@ -0,0 +1,830 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Kernels.h"
+
+/*
+ * Kernel implementations shared by every instruction set and scalar type. Each Kernels*.cpp translation
+ * unit defines an Ops struct per scalar type (scalar and vector type, width and the handful of operations
+ * the kernels need, see ScalarOps in Kernels.cpp) and builds its tables with NN_KERNEL_TABLE. The int8
+ * kernels use a separate Int8Ops struct and NN_INT8_KERNEL_TABLE.
+ *
+ * Only include this from the Kernels*.cpp files. Everything is in an anonymous namespace on purpose:
+ * the translation units are compiled with different target options, and their copies of the
+ * kernels must never be merged by the linker. For the same reason the kernels don't call into
+ * the standard library.
+ */
+namespace
+{
+    inline size_t minSize(size_t a, size_t b) { return a < b ? a : b; }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    Scalar dotKernel(const Scalar* a, const Scalar* b, size_t n)
+    {
+        constexpr size_t W = Ops::WIDTH;
+        typename Ops::Vec s0 = Ops::zero(), s1 = Ops::zero(), s2 = Ops::zero(), s3 = Ops::zero();
+
+        // Four independent accumulators to hide the add latency
+        size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W)
+        {
+            s0 = Ops::fmadd(Ops::load(a + i), Ops::load(b + i), s0);
+            s1 = Ops::fmadd(Ops::load(a + i + W), Ops::load(b + i + W), s1);
+            s2 = Ops::fmadd(Ops::load(a + i + 2 * W), Ops::load(b + i + 2 * W), s2);
+            s3 = Ops::fmadd(Ops::load(a + i + 3 * W), Ops::load(b + i + 3 * W), s3);
+        }
+        for (; i + W <= n; i += W)
+            s0 = Ops::fmadd(Ops::load(a + i), Ops::load(b + i), s0);
+
+        Scalar sum = Ops::sum(Ops::add(Ops::add(s0, s1), Ops::add(s2, s3)));
+        for (; i < n; i++)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void axpyKernel(Scalar alpha, const Scalar* x, Scalar* y, size_t n)
+    {
+        constexpr size_t W = Ops::WIDTH;
+        const typename Ops::Vec a = Ops::set1(alpha);
+
+        size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            Ops::store(y + i, Ops::fmadd(a, Ops::load(x + i), Ops::load(y + i)));
+            Ops::store(y + i + W, Ops::fmadd(a, Ops::load(x + i + W), Ops::load(y + i + W)));
+        }
+        for (; i + W <= n; i += W)
+            Ops::store(y + i, Ops::fmadd(a, Ops::load(x + i), Ops::load(y + i)));
+        for (; i < n; i++)
+            y[i] += alpha * x[i];
+    }
+
+    /**
+     * y += c[0] * rows[0] + c[1] * rows[1] + c[2] * rows[2] + c[3] * rows[3], where rows[k] starts
+     * at rows + k * rowStride. Loading and storing y once for four rows is what makes the
+     * transposed and NN/TN products cheaper than four separate axpys.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void accumulateFourRows(const Scalar* c, const Scalar* rows, size_t rowStride, Scalar* y, size_t n)
+    {
+        constexpr size_t W = Ops::WIDTH;
+        const typename Ops::Vec c0 = Ops::set1(c[0]), c1 = Ops::set1(c[1]), c2 = Ops::set1(c[2]), c3 = Ops::set1(c[3]);
+        const Scalar* r0 = rows;
+        const Scalar* r1 = rows + rowStride;
+        const Scalar* r2 = rows + 2 * rowStride;
+        const Scalar* r3 = rows + 3 * rowStride;
+
+        size_t i = 0;
+        for (; i + W <= n; i += W)
+        {
+            typename Ops::Vec v = Ops::load(y + i);
+            v = Ops::fmadd(c0, Ops::load(r0 + i), v);
+            v = Ops::fmadd(c1, Ops::load(r1 + i), v);
+            v = Ops::fmadd(c2, Ops::load(r2 + i), v);
+            v = Ops::fmadd(c3, Ops::load(r3 + i), v);
+            Ops::store(y + i, v);
+        }
+        for (; i < n; i++)
+            y[i] += c[0] * r0[i] + c[1] * r1[i] + c[2] * r2[i] + c[3] * r3[i];
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemvKernel(const Scalar* A, const Scalar* x, Scalar* y, size_t rows, size_t cols)
+    {
+        constexpr size_t W = Ops::WIDTH;
+
+        // Four rows at a time so every load of x is used four times
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            const Scalar* a0 = A + r * cols;
+            const Scalar* a1 = a0 + cols;
+            const Scalar* a2 = a1 + cols;
+            const Scalar* a3 = a2 + cols;
+            typename Ops::Vec s0 = Ops::zero(), s1 = Ops::zero(), s2 = Ops::zero(), s3 = Ops::zero();
+
+            size_t i = 0;
+            for (; i + W <= cols; i += W)
+            {
+                const typename Ops::Vec xv = Ops::load(x + i);
+                s0 = Ops::fmadd(Ops::load(a0 + i), xv, s0);
+                s1 = Ops::fmadd(Ops::load(a1 + i), xv, s1);
+                s2 = Ops::fmadd(Ops::load(a2 + i), xv, s2);
+                s3 = Ops::fmadd(Ops::load(a3 + i), xv, s3);
+            }
+
+            Scalar t0 = Ops::sum(s0), t1 = Ops::sum(s1), t2 = Ops::sum(s2), t3 = Ops::sum(s3);
+            for (; i < cols; i++)
+            {
+                t0 += a0[i] * x[i];
+                t1 += a1[i] * x[i];
+                t2 += a2[i] * x[i];
+                t3 += a3[i] * x[i];
+            }
+            y[r] = t0;
+            y[r + 1] = t1;
+            y[r + 2] = t2;
+            y[r + 3] = t3;
+        }
+        for (; r < rows; r++)
+            y[r] = dotKernel<Ops>(A + r * cols, x, cols);
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemvTransposedKernel(const Scalar* A, size_t lda, const Scalar* x, Scalar* y, size_t rows, size_t cols)
+    {
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+            accumulateFourRows<Ops>(x + r, A + r * lda, lda, y, cols);
+        for (; r < rows; r++)
+            axpyKernel<Ops>(x[r], A + r * lda, y, cols);
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gerKernel(Scalar alpha, const Scalar* x, const Scalar* y, Scalar* A, size_t rows, size_t cols)
+    {
+        for (size_t r = 0; r < rows; r++)
+            axpyKernel<Ops>(alpha * x[r], y, A + r * cols, cols);
+    }
+
+    /**
+     * Register tile for gemmNT: C[4 x NR] += A[4 x k] * B[NR x k]^T, with 4 * NR vector accumulators.
+     * NR is 2 or 4. The accumulators are spelled out as separate variables because compilers don't
+     * reliably keep a small array of vectors in registers.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemmNTMicroKernel(const Scalar* A, size_t lda, const Scalar* B, size_t ldb, Scalar* C, size_t ldc, size_t k)
+    {
+        using Vec = typename Ops::Vec;
+        constexpr size_t W = Ops::WIDTH;
+        constexpr size_t NR = Ops::GEMM_NR;
+        static_assert(Ops::GEMM_MR == 4 && (NR == 2 || NR == 4), "Unsupported gemmNT register tile");
+
+        const Scalar* a0 = A;
+        const Scalar* a1 = A + lda;
+        const Scalar* a2 = A + 2 * lda;
+        const Scalar* a3 = A + 3 * lda;
+        const Scalar* b0 = B;
+        const Scalar* b1 = B + ldb;
+        const Scalar* b2 = B + 2 * ldb;
+        const Scalar* b3 = B + 3 * ldb;
+
+        Vec c00 = Ops::zero(), c01 = Ops::zero(), c02 = Ops::zero(), c03 = Ops::zero();
+        Vec c10 = Ops::zero(), c11 = Ops::zero(), c12 = Ops::zero(), c13 = Ops::zero();
+        Vec c20 = Ops::zero(), c21 = Ops::zero(), c22 = Ops::zero(), c23 = Ops::zero();
+        Vec c30 = Ops::zero(), c31 = Ops::zero(), c32 = Ops::zero(), c33 = Ops::zero();
+
+        size_t p = 0;
+        for (; p + W <= k; p += W)
+        {
+            const Vec va0 = Ops::load(a0 + p);
+            const Vec va1 = Ops::load(a1 + p);
+            const Vec va2 = Ops::load(a2 + p);
+            const Vec va3 = Ops::load(a3 + p);
+
+            Vec vb = Ops::load(b0 + p);
+            c00 = Ops::fmadd(va0, vb, c00);
+            c10 = Ops::fmadd(va1, vb, c10);
+            c20 = Ops::fmadd(va2, vb, c20);
+            c30 = Ops::fmadd(va3, vb, c30);
+
+            vb = Ops::load(b1 + p);
+            c01 = Ops::fmadd(va0, vb, c01);
+            c11 = Ops::fmadd(va1, vb, c11);
+            c21 = Ops::fmadd(va2, vb, c21);
+            c31 = Ops::fmadd(va3, vb, c31);
+
+            if constexpr (NR == 4)
+            {
+                vb = Ops::load(b2 + p);
+                c02 = Ops::fmadd(va0, vb, c02);
+                c12 = Ops::fmadd(va1, vb, c12);
+                c22 = Ops::fmadd(va2, vb, c22);
+                c32 = Ops::fmadd(va3, vb, c32);
+
+                vb = Ops::load(b3 + p);
+                c03 = Ops::fmadd(va0, vb, c03);
+                c13 = Ops::fmadd(va1, vb, c13);
+                c23 = Ops::fmadd(va2, vb, c23);
+                c33 = Ops::fmadd(va3, vb, c33);
+            }
+        }
+
+        const Vec sums[4][4] = {
+            { c00, c01, c02, c03 },
+            { c10, c11, c12, c13 },
+            { c20, c21, c22, c23 },
+            { c30, c31, c32, c33 } };
+        const Scalar* aRows[4] = { a0, a1, a2, a3 };
+        const Scalar* bRows[4] = { b0, b1, b2, b3 };
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            for (size_t j = 0; j < NR; j++)
+            {
+                Scalar sum = Ops::sum(sums[i][j]);
+                for (size_t q = p; q < k; q++)
+                    sum += aRows[i][q] * bRows[j][q];
+                C[i * ldc + j] += sum;
+            }
+        }
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemmNTKernel(const Scalar* A, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K)
+    {
+        constexpr size_t MR = Ops::GEMM_MR;
+        constexpr size_t NR = Ops::GEMM_NR;
+
+        // Cache blocking: a KC-long slice of NC rows of B (256 KiB) stays in L2 while every
+        // row of A passes over it, and the MR rows of A being used stay in L1.
+        constexpr size_t KC = 512;
+        constexpr size_t NC = 64;
+
+        for (size_t kc = 0; kc < K; kc += KC)
+        {
+            const size_t k = minSize(KC, K - kc);
+
+            for (size_t nc = 0; nc < N; nc += NC)
+            {
+                const size_t ncEnd = minSize(nc + NC, N);
+
+                for (size_t m = 0; m < M; m += MR)
+                {
+                    const size_t mr = minSize(MR, M - m);
+
+                    for (size_t n = nc; n < ncEnd; n += NR)
+                    {
+                        const size_t nr = minSize(NR, ncEnd - n);
+
+                        if (mr == MR && nr == NR)
+                        {
+                            gemmNTMicroKernel<Ops>(A + m * K + kc, K, B + n * K + kc, K, C + m * N + n, N, k);
+                        }
+                        else
+                        {
+                            for (size_t i = 0; i < mr; i++)
+                                for (size_t j = 0; j < nr; j++)
+                                    C[(m + i) * N + n + j] += dotKernel<Ops>(A + (m + i) * K + kc, B + (n + j) * K + kc, k);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Register tile for gemmNN and gemmTN: C[4 x 2W] += alpha * A[4 x k] * B[k x 2W], where element (i, p)
+     * of A is at A[i * aRowStride + p * aColStride]. Every step broadcasts one value of A per row and
+     * reuses two vector loads of B for all four rows, with the tile of C held in 8 registers.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemmBroadcastMicroKernel(Scalar alpha, const Scalar* A, size_t aRowStride, size_t aColStride,
+        const Scalar* B, size_t ldb, Scalar* C, size_t ldc, size_t k)
+    {
+        using Vec = typename Ops::Vec;
+        constexpr size_t W = Ops::WIDTH;
+
+        Scalar* r0 = C;
+        Scalar* r1 = C + ldc;
+        Scalar* r2 = C + 2 * ldc;
+        Scalar* r3 = C + 3 * ldc;
+
+        Vec c00 = Ops::load(r0), c01 = Ops::load(r0 + W);
+        Vec c10 = Ops::load(r1), c11 = Ops::load(r1 + W);
+        Vec c20 = Ops::load(r2), c21 = Ops::load(r2 + W);
+        Vec c30 = Ops::load(r3), c31 = Ops::load(r3 + W);
+
+        for (size_t p = 0; p < k; p++)
+        {
+            const Scalar* a = A + p * aColStride;
+            const Vec b0 = Ops::load(B + p * ldb);
+            const Vec b1 = Ops::load(B + p * ldb + W);
+
+            Vec va = Ops::set1(alpha * a[0]);
+            c00 = Ops::fmadd(va, b0, c00);
+            c01 = Ops::fmadd(va, b1, c01);
+
+            va = Ops::set1(alpha * a[aRowStride]);
+            c10 = Ops::fmadd(va, b0, c10);
+            c11 = Ops::fmadd(va, b1, c11);
+
+            va = Ops::set1(alpha * a[2 * aRowStride]);
+            c20 = Ops::fmadd(va, b0, c20);
+            c21 = Ops::fmadd(va, b1, c21);
+
+            va = Ops::set1(alpha * a[3 * aRowStride]);
+            c30 = Ops::fmadd(va, b0, c30);
+            c31 = Ops::fmadd(va, b1, c31);
+        }
+
+        Ops::store(r0, c00); Ops::store(r0 + W, c01);
+        Ops::store(r1, c10); Ops::store(r1 + W, c11);
+        Ops::store(r2, c20); Ops::store(r2 + W, c21);
+        Ops::store(r3, c30); Ops::store(r3 + W, c31);
+    }
+
+    /**
+     * Shared driver for gemmNN and gemmTN: C[M x N] += alpha * A * B[K x N], with A addressed through
+     * strides like in gemmBroadcastMicroKernel. A KC x NC panel of B (256 KiB) stays in L2 while every
+     * row of C is updated from it.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemmBroadcastKernel(Scalar alpha, const Scalar* A, size_t aRowStride, size_t aColStride,
+        const Scalar* B, Scalar* C, size_t M, size_t N, size_t K)
+    {
+        constexpr size_t W = Ops::WIDTH;
+        constexpr size_t NC = 512;
+        constexpr size_t KC = 64;
+
+        for (size_t nc = 0; nc < N; nc += NC)
+        {
+            const size_t ncEnd = minSize(nc + NC, N);
+
+            for (size_t kc = 0; kc < K; kc += KC)
+            {
+                const size_t k = minSize(KC, K - kc);
+                const Scalar* panel = B + kc * N;
+
+                size_t m = 0;
+                for (; m + 4 <= M; m += 4)
+                {
+                    const Scalar* a = A + m * aRowStride + kc * aColStride;
+
+                    size_t n = nc;
+                    for (; n + 2 * W <= ncEnd; n += 2 * W)
+                        gemmBroadcastMicroKernel<Ops>(alpha, a, aRowStride, aColStride, panel + n, N, C + m * N + n, N, k);
+
+                    // Columns left over at the right edge of the panel
+                    for (size_t i = 0; i < 4; i++)
+                        for (size_t p = 0; p < k; p++)
+                        {
+                            const Scalar coefficient = alpha * a[i * aRowStride + p * aColStride];
+                            for (size_t q = n; q < ncEnd; q++)
+                                C[(m + i) * N + q] += coefficient * panel[p * N + q];
+                        }
+                }
+
+                // Rows left over at the bottom
+                for (; m < M; m++)
+                {
+                    const Scalar* a = A + m * aRowStride + kc * aColStride;
+                    for (size_t p = 0; p < k; p++)
+                        axpyKernel<Ops>(alpha * a[p * aColStride], panel + p * N + nc, C + m * N + nc, ncEnd - nc);
+                }
+            }
+        }
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemmNNKernel(const Scalar* A, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K)
+    {
+        // A is M x K, so element (m, k) is at A[m * K + k]
+        gemmBroadcastKernel<Ops>(Scalar(1), A, K, 1, B, C, M, N, K);
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void gemmTNKernel(Scalar alpha, const Scalar* A, size_t lda, const Scalar* B, Scalar* C, size_t M, size_t N, size_t K)
+    {
+        // A is K x M and used transposed, so element (m, k) is at A[k * lda + m]
+        gemmBroadcastKernel<Ops>(alpha, A, 1, lda, B, C, M, N, K);
+    }
+
+    /**
+     * Sparse x times dense A. Only reads the columns of A where x is non-zero. Four rows at a time, so every
+     * index and value is loaded once per four rows. Written as plain scalar code: the accesses are gathers,
+     * which the compiler vectorizes better for the target than explicit Ops code would.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void sparseGemvKernel(const Scalar* A, const uint32_t* indices, const Scalar* values, size_t nnz, Scalar* y, size_t rows, size_t cols)
+    {
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            const Scalar* a0 = A + r * cols;
+            const Scalar* a1 = a0 + cols;
+            const Scalar* a2 = a1 + cols;
+            const Scalar* a3 = a2 + cols;
+
+            Scalar s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            for (size_t j = 0; j < nnz; j++)
+            {
+                const uint32_t k = indices[j];
+                const Scalar x = values[j];
+                s0 += a0[k] * x;
+                s1 += a1[k] * x;
+                s2 += a2[k] * x;
+                s3 += a3[k] * x;
+            }
+            y[r] = s0;
+            y[r + 1] = s1;
+            y[r + 2] = s2;
+            y[r + 3] = s3;
+        }
+        for (; r < rows; r++)
+        {
+            const Scalar* a = A + r * cols;
+            Scalar s = 0;
+            for (size_t j = 0; j < nnz; j++)
+                s += a[indices[j]] * values[j];
+            y[r] = s;
+        }
+    }
+
+    /**
+     * Outer product update with a sparse y. Only touches the columns of A where y is non-zero.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void sparseGerKernel(Scalar alpha, const Scalar* x, const uint32_t* indices, const Scalar* values, size_t nnz, Scalar* A, size_t rows, size_t cols)
+    {
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            Scalar* a0 = A + r * cols;
+            Scalar* a1 = a0 + cols;
+            Scalar* a2 = a1 + cols;
+            Scalar* a3 = a2 + cols;
+            const Scalar x0 = alpha * x[r], x1 = alpha * x[r + 1], x2 = alpha * x[r + 2], x3 = alpha * x[r + 3];
+
+            for (size_t j = 0; j < nnz; j++)
+            {
+                const uint32_t k = indices[j];
+                const Scalar y = values[j];
+                a0[k] += x0 * y;
+                a1[k] += x1 * y;
+                a2[k] += x2 * y;
+                a3[k] += x3 * y;
+            }
+        }
+        for (; r < rows; r++)
+        {
+            Scalar* a = A + r * cols;
+            const Scalar xr = alpha * x[r];
+            for (size_t j = 0; j < nnz; j++)
+                a[indices[j]] += xr * values[j];
+        }
+    }
+
+    /**
+     * CSR matrix times dense vector. Plain scalar code for the same reason as sparseGemvKernel.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void csrGemvKernel(const Scalar* values, const uint32_t* columns, const uint32_t* rowStarts, const Scalar* x, Scalar* y, size_t rows)
+    {
+        for (size_t r = 0; r < rows; r++)
+        {
+            // Two accumulators to hide the add latency
+            Scalar s0 = 0, s1 = 0;
+            uint32_t j = rowStarts[r];
+            const uint32_t end = rowStarts[r + 1];
+            for (; j + 2 <= end; j += 2)
+            {
+                s0 += values[j] * x[columns[j]];
+                s1 += values[j + 1] * x[columns[j + 1]];
+            }
+            if (j < end)
+                s0 += values[j] * x[columns[j]];
+            y[r] = s0 + s1;
+        }
+    }
+
+    /**
+     * C += B * A^T for a CSR matrix A. Four rows of B (samples) at a time, so every non-zero of A is loaded
+     * once per four samples instead of once per sample.
+     */
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void csrGemmNTKernel(const Scalar* values, const uint32_t* columns, const uint32_t* rowStarts, size_t rows,
+        const Scalar* B, size_t K, Scalar* C, size_t M)
+    {
+        size_t m = 0;
+        for (; m + 4 <= M; m += 4)
+        {
+            const Scalar* b0 = B + m * K;
+            const Scalar* b1 = b0 + K;
+            const Scalar* b2 = b1 + K;
+            const Scalar* b3 = b2 + K;
+            Scalar* c0 = C + m * rows;
+
+            for (size_t r = 0; r < rows; r++)
+            {
+                Scalar s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                for (uint32_t j = rowStarts[r]; j < rowStarts[r + 1]; j++)
+                {
+                    const Scalar v = values[j];
+                    const uint32_t k = columns[j];
+                    s0 += v * b0[k];
+                    s1 += v * b1[k];
+                    s2 += v * b2[k];
+                    s3 += v * b3[k];
+                }
+                c0[r] += s0;
+                c0[rows + r] += s1;
+                c0[2 * rows + r] += s2;
+                c0[3 * rows + r] += s3;
+            }
+        }
+        for (; m < M; m++)
+        {
+            const Scalar* b = B + m * K;
+            Scalar* c = C + m * rows;
+            for (size_t r = 0; r < rows; r++)
+            {
+                Scalar s = 0;
+                for (uint32_t j = rowStarts[r]; j < rowStarts[r + 1]; j++)
+                    s += values[j] * b[columns[j]];
+                c[r] += s;
+            }
+        }
+    }
+
+    /**
+     * Constants for the exp approximation. e^x = 2^n * e^r, with n = round(x / ln 2) and |r| <= ln 2 / 2.
+     * ln 2 is split in a short high part and a low part (Cody-Waite), so n * LN2_HI is exact and r keeps
+     * its precision. e^r is a polynomial, highest power first. Inputs are clamped to the range where 2^n
+     * is a normal number.
+     */
+    template <typename Scalar>
+    struct ExpConstants;
+
+    template <>
+    struct ExpConstants<float>
+    {
+        static constexpr float MIN_INPUT = -87.33654f;
+        static constexpr float MAX_INPUT = 88.37f;
+        static constexpr float LOG2E = 1.44269504088896341f;
+        static constexpr float LN2_HI = 0.693359375f;
+        static constexpr float LN2_LO = -2.12194440e-4f;
+        // Adding and subtracting 1.5 * 2^23 rounds to the nearest whole number
+        static constexpr float ROUND = 12582912.0f;
+
+        // Minimax fit from Cephes expf
+        static constexpr size_t DEGREE = 7;
+        static constexpr float POLYNOMIAL[DEGREE + 1] = { 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+            4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f, 1.0f, 1.0f };
+    };
+
+    template <>
+    struct ExpConstants<double>
+    {
+        static constexpr double MIN_INPUT = -708.39641853226408;
+        static constexpr double MAX_INPUT = 709.43;
+        static constexpr double LOG2E = 1.4426950408889634074;
+        static constexpr double LN2_HI = 6.93145751953125e-1;
+        static constexpr double LN2_LO = 1.42860682030941723212e-6;
+        static constexpr double ROUND = 6755399441055744.0;
+
+        // Taylor series to r^12, the first left out term is below 2e-16 for |r| <= ln 2 / 2
+        static constexpr size_t DEGREE = 12;
+        static constexpr double POLYNOMIAL[DEGREE + 1] = { 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+            1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0 };
+    };
+
+    template <typename Ops>
+    typename Ops::Vec expVector(typename Ops::Vec x)
+    {
+        using Constants = ExpConstants<typename Ops::Scalar>;
+
+        x = Ops::min(Ops::max(x, Ops::set1(Constants::MIN_INPUT)), Ops::set1(Constants::MAX_INPUT));
+        const typename Ops::Vec n = Ops::sub(Ops::fmadd(x, Ops::set1(Constants::LOG2E), Ops::set1(Constants::ROUND)), Ops::set1(Constants::ROUND));
+        typename Ops::Vec r = Ops::fmadd(n, Ops::set1(-Constants::LN2_HI), x);
+        r = Ops::fmadd(n, Ops::set1(-Constants::LN2_LO), r);
+
+        typename Ops::Vec p = Ops::set1(Constants::POLYNOMIAL[0]);
+        for (size_t k = 1; k <= Constants::DEGREE; k++)
+            p = Ops::fmadd(p, r, Ops::set1(Constants::POLYNOMIAL[k]));
+
+        return Ops::mul(p, Ops::pow2(n));
+    }
+
+    // 1 / (1 + e^-x)
+    template <typename Ops>
+    typename Ops::Vec sigmoidVector(typename Ops::Vec x)
+    {
+        const typename Ops::Vec one = Ops::set1(1);
+        return Ops::div(one, Ops::add(one, expVector<Ops>(Ops::sub(Ops::zero(), x))));
+    }
+
+    // 2 / (1 + e^-2x) - 1, i.e. 2 * sigmoid(2x) - 1
+    template <typename Ops>
+    typename Ops::Vec tanhVector(typename Ops::Vec x)
+    {
+        const typename Ops::Vec one = Ops::set1(1);
+        const typename Ops::Vec two = Ops::set1(2);
+        return Ops::sub(Ops::div(two, Ops::add(one, expVector<Ops>(Ops::mul(x, Ops::set1(-2))))), one);
+    }
+
+    /**
+     * y[i] = Function(x[i]) over whole vectors. The last few values go through a padded vector, so they
+     * get exactly the same result as they would anywhere else in the array. x and y can be the same array.
+     */
+    template <typename Ops, typename Ops::Vec (*Function)(typename Ops::Vec), typename Scalar = typename Ops::Scalar>
+    void mapKernel(const Scalar* x, Scalar* y, size_t n)
+    {
+        constexpr size_t W = Ops::WIDTH;
+
+        size_t i = 0;
+        for (; i + W <= n; i += W)
+            Ops::store(y + i, Function(Ops::load(x + i)));
+
+        if (i < n)
+        {
+            Scalar padded[W] = {};
+            for (size_t j = i; j < n; j++)
+                padded[j - i] = x[j];
+            Ops::store(padded, Function(Ops::load(padded)));
+            for (size_t j = i; j < n; j++)
+                y[j] = padded[j - i];
+        }
+    }
+
+    /**
+     * One optimizer step over n parameters: Update(parameter, change, first, second) for every vector, after
+     * which the changes are cleared. Every array is read and written once, whatever the optimizer.
+     * second is only touched with SecondMoments. The last few values go through padded vectors like in mapKernel.
+     */
+    template <typename Ops, bool SecondMoments, typename Update, typename Scalar = typename Ops::Scalar>
+    void optimizerStepKernel(const Update& update, Scalar* parameters, Scalar* changes, Scalar* first, Scalar* second, size_t n)
+    {
+        constexpr size_t W = Ops::WIDTH;
+        using Vec = typename Ops::Vec;
+
+        size_t i = 0;
+        for (; i + W <= n; i += W)
+        {
+            Vec parameter = Ops::load(parameters + i);
+            Vec firstMoment = Ops::load(first + i);
+            Vec secondMoment = SecondMoments ? Ops::load(second + i) : Ops::zero();
+            update(parameter, Ops::load(changes + i), firstMoment, secondMoment);
+
+            Ops::store(parameters + i, parameter);
+            Ops::store(changes + i, Ops::zero());
+            Ops::store(first + i, firstMoment);
+            if (SecondMoments)
+                Ops::store(second + i, secondMoment);
+        }
+
+        if (i < n)
+        {
+            Scalar padded[4][W] = {};
+            for (size_t j = i; j < n; j++)
+            {
+                padded[0][j - i] = parameters[j];
+                padded[1][j - i] = changes[j];
+                padded[2][j - i] = first[j];
+                if (SecondMoments)
+                    padded[3][j - i] = second[j];
+            }
+
+            Vec parameter = Ops::load(padded[0]);
+            Vec firstMoment = Ops::load(padded[2]);
+            Vec secondMoment = Ops::load(padded[3]);
+            update(parameter, Ops::load(padded[1]), firstMoment, secondMoment);
+            Ops::store(padded[0], parameter);
+            Ops::store(padded[2], firstMoment);
+            Ops::store(padded[3], secondMoment);
+
+            for (size_t j = i; j < n; j++)
+            {
+                parameters[j] = padded[0][j - i];
+                changes[j] = 0;
+                first[j] = padded[2][j - i];
+                if (SecondMoments)
+                    second[j] = padded[3][j - i];
+            }
+        }
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void momentumStepKernel(Scalar rate, Scalar momentum, Scalar* parameters, Scalar* changes, Scalar* velocity, size_t n)
+    {
+        using Vec = typename Ops::Vec;
+        const Vec r = Ops::set1(rate);
+        const Vec mu = Ops::set1(momentum);
+        optimizerStepKernel<Ops, false>([&](Vec& parameter, Vec change, Vec& v, Vec&)
+        {
+            v = Ops::fmadd(mu, v, change);
+            parameter = Ops::fmadd(r, v, parameter);
+        }, parameters, changes, velocity, (Scalar*)nullptr, n);
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void nesterovStepKernel(Scalar rate, Scalar momentum, Scalar* parameters, Scalar* changes, Scalar* velocity, size_t n)
+    {
+        using Vec = typename Ops::Vec;
+        const Vec r = Ops::set1(rate);
+        const Vec mu = Ops::set1(momentum);
+        optimizerStepKernel<Ops, false>([&](Vec& parameter, Vec change, Vec& v, Vec&)
+        {
+            v = Ops::fmadd(mu, v, change);
+            parameter = Ops::fmadd(r, Ops::fmadd(mu, v, change), parameter);
+        }, parameters, changes, velocity, (Scalar*)nullptr, n);
+    }
+
+    template <typename Ops, typename Scalar = typename Ops::Scalar>
+    void adamStepKernel(Scalar rate, Scalar beta1, Scalar beta2, Scalar epsilon, Scalar decay, Scalar* parameters, Scalar* changes,
+        Scalar* first, Scalar* second, size_t n)
+    {
+        using Vec = typename Ops::Vec;
+        const Vec r = Ops::set1(rate);
+        const Vec b1 = Ops::set1(beta1);
+        const Vec b2 = Ops::set1(beta2);
+        const Vec oneMinusB1 = Ops::set1(1 - beta1);
+        const Vec oneMinusB2 = Ops::set1(1 - beta2);
+        const Vec eps = Ops::set1(epsilon);
+        const Vec negativeDecay = Ops::set1(-decay);
+        optimizerStepKernel<Ops, true>([&](Vec& parameter, Vec change, Vec& m, Vec& v)
+        {
+            m = Ops::fmadd(b1, m, Ops::mul(oneMinusB1, change));
+            v = Ops::fmadd(b2, v, Ops::mul(oneMinusB2, Ops::mul(change, change)));
+            parameter = Ops::fmadd(negativeDecay, parameter, parameter);
+            parameter = Ops::fmadd(r, Ops::div(m, Ops::add(Ops::sqrt(v), eps)), parameter);
+        }, parameters, changes, first, second, n);
+    }
+
+    /**
+     * Int8 dot product with int32 accumulation. Int8Ops::load sign-extends WIDTH int8 values to 16 bits,
+     * and Int8Ops::madd multiplies pairs of them and adds neighbouring products into 32-bit lanes.
+     * A product of two int8 values is at most 2^14, so the sums only overflow for vectors far longer
+     * than any layer.
+     */
+    template <typename Int8Ops>
+    int32_t dotInt8Kernel(const int8_t* a, const int8_t* b, size_t n)
+    {
+        constexpr size_t W = Int8Ops::WIDTH;
+        typename Int8Ops::Vec s0 = Int8Ops::zero(), s1 = Int8Ops::zero();
+
+        size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            s0 = Int8Ops::madd(Int8Ops::load(a + i), Int8Ops::load(b + i), s0);
+            s1 = Int8Ops::madd(Int8Ops::load(a + i + W), Int8Ops::load(b + i + W), s1);
+        }
+        for (; i + W <= n; i += W)
+            s0 = Int8Ops::madd(Int8Ops::load(a + i), Int8Ops::load(b + i), s0);
+
+        int32_t sum = Int8Ops::sum(Int8Ops::add(s0, s1));
+        for (; i < n; i++)
+            sum += (int32_t)a[i] * (int32_t)b[i];
+        return sum;
+    }
+
+    template <typename Int8Ops>
+    void gemvInt8Kernel(const int8_t* A, const int8_t* x, int32_t* y, size_t rows, size_t cols)
+    {
+        constexpr size_t W = Int8Ops::WIDTH;
+
+        // Four rows at a time so every widened load of x is used four times
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            const int8_t* a0 = A + r * cols;
+            const int8_t* a1 = a0 + cols;
+            const int8_t* a2 = a1 + cols;
+            const int8_t* a3 = a2 + cols;
+            typename Int8Ops::Vec s0 = Int8Ops::zero(), s1 = Int8Ops::zero(), s2 = Int8Ops::zero(), s3 = Int8Ops::zero();
+
+            size_t i = 0;
+            for (; i + W <= cols; i += W)
+            {
+                const typename Int8Ops::Wide xv = Int8Ops::load(x + i);
+                s0 = Int8Ops::madd(Int8Ops::load(a0 + i), xv, s0);
+                s1 = Int8Ops::madd(Int8Ops::load(a1 + i), xv, s1);
+                s2 = Int8Ops::madd(Int8Ops::load(a2 + i), xv, s2);
+                s3 = Int8Ops::madd(Int8Ops::load(a3 + i), xv, s3);
+            }
+
+            int32_t t0 = Int8Ops::sum(s0), t1 = Int8Ops::sum(s1), t2 = Int8Ops::sum(s2), t3 = Int8Ops::sum(s3);
+            for (; i < cols; i++)
+            {
+                t0 += (int32_t)a0[i] * (int32_t)x[i];
+                t1 += (int32_t)a1[i] * (int32_t)x[i];
+                t2 += (int32_t)a2[i] * (int32_t)x[i];
+                t3 += (int32_t)a3[i] * (int32_t)x[i];
+            }
+            y[r] = t0;
+            y[r + 1] = t1;
+            y[r + 2] = t2;
+            y[r + 3] = t3;
+        }
+        for (; r < rows; r++)
+            y[r] = dotInt8Kernel<Int8Ops>(A + r * cols, x, cols);
+    }
+}
+
+/**
+ * Builds the KernelTable for one Ops struct. This is a constant expression on purpose, so the table is
+ * filled in at compile time and no code compiled for the instruction set runs before dispatch picks it.
+ */
+#define NN_KERNEL_TABLE(Ops) Kernels::KernelTable<typename Ops::Scalar> { \
+    &dotKernel<Ops>, &axpyKernel<Ops>, &gemvKernel<Ops>, &gemvTransposedKernel<Ops>, \
+    &gerKernel<Ops>, &gemmNTKernel<Ops>, &gemmNNKernel<Ops>, &gemmTNKernel<Ops>, \
+    &sparseGemvKernel<Ops>, &sparseGerKernel<Ops>, &csrGemvKernel<Ops>, &csrGemmNTKernel<Ops>, \
+    &mapKernel<Ops, &expVector<Ops>>, &mapKernel<Ops, &sigmoidVector<Ops>>, &mapKernel<Ops, &tanhVector<Ops>>, \
+    &momentumStepKernel<Ops>, &nesterovStepKernel<Ops>, &adamStepKernel<Ops> }
+
+/**
+ * Builds the Int8KernelTable for one Int8Ops struct, at compile time like NN_KERNEL_TABLE.
+ */
+#define NN_INT8_KERNEL_TABLE(Int8Ops) Kernels::Int8KernelTable { &dotInt8Kernel<Int8Ops>, &gemvInt8Kernel<Int8Ops> }
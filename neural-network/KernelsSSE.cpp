@@ -0,0 +1,146 @@
+﻿#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NN_KERNELS_X86
+
+#include <immintrin.h>
+
+// Compile only the kernels below for SSE2. Dispatch makes sure they are never called on a CPU without it.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#include "KernelsImpl.h"
+
+namespace
+{
+    struct SSEDoubleOps
+    {
+        using Scalar = double;
+        using Vec = __m128d;
+        static constexpr size_t WIDTH = 2;
+
+        // Register tile for gemmNT, sized for 16 xmm registers: 8 accumulators + 4 A loads + 1 B load
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 2;
+
+        static Vec zero() { return _mm_setzero_pd(); }
+        static Vec load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, Vec v) { _mm_storeu_pd(p, v); }
+        static Vec set1(double value) { return _mm_set1_pd(value); }
+        static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        // No FMA in SSE2
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+        static Vec div(Vec a, Vec b) { return _mm_div_pd(a, b); }
+        static Vec sqrt(Vec a) { return _mm_sqrt_pd(a); }
+        static Vec min(Vec a, Vec b) { return _mm_min_pd(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm_max_pd(a, b); }
+        // 2^n for whole numbers n in the normal exponent range. Adding 2^52 + 1023 leaves n + 1023 in the
+        // low bits of the mantissa, the shift moves it into the exponent.
+        static Vec pow2(Vec n) { return _mm_castsi128_pd(_mm_slli_epi64(_mm_castpd_si128(_mm_add_pd(n, set1(4503599627370496.0 + 1023.0))), 52)); }
+        static double sum(Vec v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+    };
+
+    struct SSEFloatOps
+    {
+        using Scalar = float;
+        using Vec = __m128;
+        static constexpr size_t WIDTH = 4;
+        static constexpr size_t GEMM_MR = 4;
+        static constexpr size_t GEMM_NR = 2;
+
+        static Vec zero() { return _mm_setzero_ps(); }
+        static Vec load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+        static Vec set1(float value) { return _mm_set1_ps(value); }
+        static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        static Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+        static Vec sqrt(Vec a) { return _mm_sqrt_ps(a); }
+        static Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+        // Same as for double, with 2^23 + 127
+        static Vec pow2(Vec n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_castps_si128(_mm_add_ps(n, set1(8388608.0f + 127.0f))), 23)); }
+        static float sum(Vec v)
+        {
+            const __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+            return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+        }
+    };
+
+    struct SSEInt8Ops
+    {
+        using Wide = __m128i;
+        using Vec = __m128i;
+        static constexpr size_t WIDTH = 8;
+
+        static Vec zero() { return _mm_setzero_si128(); }
+        static Wide load(const int8_t* p)
+        {
+            // No sign extension instruction before SSE4.1: put each byte in the high half of a 16-bit lane, shift it back down
+            const __m128i bytes = _mm_loadl_epi64((const __m128i*)p);
+            return _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+        }
+        static Vec madd(Wide a, Wide b, Vec c) { return _mm_add_epi32(c, _mm_madd_epi16(a, b)); }
+        static Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+        static int32_t sum(Vec v)
+        {
+            v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+            v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+            return _mm_cvtsi128_si32(v);
+        }
+    };
+
+    constexpr Kernels::KernelTable<double> sseDoubleTable = NN_KERNEL_TABLE(SSEDoubleOps);
+    constexpr Kernels::KernelTable<float> sseFloatTable = NN_KERNEL_TABLE(SSEFloatOps);
+    constexpr Kernels::Int8KernelTable sseInt8Table = NN_INT8_KERNEL_TABLE(SSEInt8Ops);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
+
+namespace Kernels
+{
+    template <typename Scalar> const KernelTable<Scalar>* sseKernelTable();
+
+    template <>
+    const KernelTable<double>* sseKernelTable<double>()
+    {
+#ifdef NN_KERNELS_X86
+        return &sseDoubleTable;
+#else
+        return nullptr;
+#endif
+    }
+
+    template <>
+    const KernelTable<float>* sseKernelTable<float>()
+    {
+#ifdef NN_KERNELS_X86
+        return &sseFloatTable;
+#else
+        return nullptr;
+#endif
+    }
+
+    const Int8KernelTable* sseInt8KernelTable()
+    {
+#ifdef NN_KERNELS_X86
+        return &sseInt8Table;
+#else
+        return nullptr;
+#endif
+    }
+}
@@ -0,0 +1,120 @@
+﻿#include "MagnitudePruner.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+template <typename Scalar>
+MagnitudePruner<Scalar>::MagnitudePruner(BasicNeuralNetwork<Scalar>& network)
+    : network(network)
+{
+    for (const NetworkLayer<Scalar>& layer : network.networkLayers)
+        masks.emplace_back(layer.weights.size(), uint8_t(1));
+}
+
+template <typename Scalar>
+void MagnitudePruner<Scalar>::pruneToSparsity(double sparsity)
+{
+    assert(sparsity >= 0.0 && sparsity <= 1.0);
+
+    std::vector<Scalar> magnitudes;
+    for (size_t i = 1; i < network.networkLayers.size(); i++)
+    {
+        const std::pmr::vector<Scalar>& weights = network.networkLayers[i].weights;
+        const size_t numPruned = std::min(weights.size(), (size_t)std::ceil(sparsity * (double)weights.size()));
+        if (numPruned == 0)
+            continue;
+
+        // The magnitude of the numPruned-th smallest weight. Pruned weights are 0, so they count towards it.
+        magnitudes.resize(weights.size());
+        for (size_t k = 0; k < weights.size(); k++)
+            magnitudes[k] = masks[i][k] ? std::abs(weights[k]) : Scalar(0);
+
+        if (numPruned == weights.size())
+        {
+            std::fill(masks[i].begin(), masks[i].end(), uint8_t(0));
+            continue;
+        }
+
+        std::nth_element(magnitudes.begin(), magnitudes.begin() + numPruned, magnitudes.end());
+        const Scalar threshold = magnitudes[numPruned];
+
+        // Everything strictly below the threshold, and weights equal to it until the target is reached
+        size_t pruned = 0;
+        for (size_t k = 0; k < weights.size(); k++)
+            if (!masks[i][k] || std::abs(weights[k]) < threshold)
+            {
+                masks[i][k] = 0;
+                pruned++;
+            }
+        for (size_t k = 0; k < weights.size() && pruned < numPruned; k++)
+            if (masks[i][k] && std::abs(weights[k]) == threshold)
+            {
+                masks[i][k] = 0;
+                pruned++;
+            }
+    }
+
+    applyMasks();
+}
+
+template <typename Scalar>
+void MagnitudePruner<Scalar>::pruneBelow(double threshold)
+{
+    for (size_t i = 1; i < network.networkLayers.size(); i++)
+    {
+        const std::pmr::vector<Scalar>& weights = network.networkLayers[i].weights;
+        for (size_t k = 0; k < weights.size(); k++)
+            if ((double)std::abs(weights[k]) < threshold)
+                masks[i][k] = 0;
+    }
+
+    applyMasks();
+}
+
+template <typename Scalar>
+double MagnitudePruner<Scalar>::fineTune(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput, size_t batchSize)
+{
+    assert(batchSize > 0);
+    assert(trainingData.size() == targetOutput.size());
+
+    double loss = 0.0;
+    network.reserveBatch(std::min(batchSize, trainingData.size()));
+    for (size_t first = 0; first < trainingData.size(); first += batchSize)
+    {
+        const size_t count = std::min(batchSize, trainingData.size() - first);
+
+        loss = network.calculateBatchGradients(network.layerStates, trainingData, targetOutput, first, count) / (double)count;
+
+        network.updateWeightsBatch(count);
+        applyMasks();
+    }
+    return loss;
+}
+
+template <typename Scalar>
+double MagnitudePruner<Scalar>::sparsity() const
+{
+    size_t pruned = 0;
+    size_t total = 0;
+    for (const std::vector<uint8_t>& mask : masks)
+    {
+        pruned += std::count(mask.begin(), mask.end(), uint8_t(0));
+        total += mask.size();
+    }
+    return total > 0 ? (double)pruned / (double)total : 0.0;
+}
+
+template <typename Scalar>
+void MagnitudePruner<Scalar>::applyMasks()
+{
+    for (size_t i = 1; i < network.networkLayers.size(); i++)
+    {
+        std::pmr::vector<Scalar>& weights = network.networkLayers[i].weights;
+        for (size_t k = 0; k < weights.size(); k++)
+            if (!masks[i][k])
+                weights[k] = 0;
+    }
+}
+
+template class MagnitudePruner<float>;
+template class MagnitudePruner<double>;
@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "NeuralNetwork.h"
+
+/**
+ * \brief Prunes a trained network by zeroing its smallest weights, and keeps them at zero while fine-tuning.
+ * Layers that are mostly zeros can then run as sparse matrices, see SparseNetwork.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+class MagnitudePruner
+{
+public:
+    /**
+     * \param network The network to prune. Referenced, not copied, so it has to outlive the pruner.
+     */
+    explicit MagnitudePruner(BasicNeuralNetwork<Scalar>& network);
+
+    /**
+     * \brief Zero the weights with the smallest magnitude in every layer, until the given fraction of every
+     * layer's weights is zero. Weights that were pruned before stay pruned.
+     * \param sparsity Between 0 and 1, e.g. 0.9 leaves one weight in ten.
+     */
+    void pruneToSparsity(double sparsity);
+
+    /**
+     * \brief Zero every weight whose magnitude is below threshold.
+     */
+    void pruneBelow(double threshold);
+
+    /**
+     * \brief Train the pruned network some more, like trainBatch, so the remaining weights make up for the
+     * pruned ones. The pruned weights are zeroed again after every batch, so they stay pruned.
+     * \return The loss (MSE or cross-entropy) averaged over every sample in the last batch.
+     */
+    double fineTune(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput, size_t batchSize);
+
+    /**
+     * \return The fraction of all weights in the network that are pruned.
+     */
+    double sparsity() const;
+
+protected:
+    void applyMasks();
+
+    BasicNeuralNetwork<Scalar>& network;
+
+    // One entry per weight of every layer, 0 if the weight is pruned. Empty for the input layer.
+    std::vector<std::vector<uint8_t>> masks;
+};
@@ -0,0 +1,112 @@
+﻿#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = static_cast<const uint8_t*>(view);
+    length = (size_t)fileSize.QuadPart;
+#else
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        ::close(file);
+        return;
+    }
+
+    void* view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    // The mapping keeps its own reference to the file
+    ::close(file);
+    if (view == MAP_FAILED)
+        return;
+
+    bytes = static_cast<const uint8_t*>(view);
+    length = (size_t)status.st_size;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::close()
+{
+    if (bytes == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+
+    bytes = nullptr;
+    length = 0;
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * \brief A whole file mapped read-only into memory. The operating system pages the file in
+ * as it is read, and shares the pages between processes that map the same file,
+ * so opening even a huge file is nearly free.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    /**
+     * \brief Map the file at path. Check isOpen afterwards, a missing or empty file leaves it closed.
+     */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool isOpen() const { return bytes != nullptr; }
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    void close();
+
+protected:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,91 @@
+﻿#include "MappedNetwork.h"
+#include "Checkpoint.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+template <typename Scalar>
+MappedNetwork<Scalar>::MappedNetwork(const std::string& path)
+    : threadPool(&ThreadPool::global()), file(path)
+{
+    if (!file.isOpen())
+    {
+        std::cerr << "MappedNetwork: Couldn't map " << path << ".\n";
+        return;
+    }
+
+    std::vector<Checkpoint::LayerView> views;
+    size_t scalarSize;
+    if (!Checkpoint::read(file, views, scalarSize))
+    {
+        file.close();
+        return;
+    }
+
+    if (scalarSize != sizeof(Scalar))
+    {
+        std::cerr << "MappedNetwork: " << path << " was saved in the other precision, use Checkpoint::load to convert it.\n";
+        file.close();
+        return;
+    }
+
+    size_t widest = 0;
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        topology.push_back(views[i].info);
+        widest = std::max(widest, views[i].info.numNeurons);
+
+        if (i == 0)
+            continue;
+
+        mappedLayers.push_back({ views[i].info.numNeurons, views[i].numInputs, views[i].info.activationFunction,
+            static_cast<const Scalar*>(views[i].weights), static_cast<const Scalar*>(views[i].biases) });
+    }
+
+    activations.resize(widest);
+    nextActivations.resize(widest);
+}
+
+template <typename Scalar>
+std::vector<Scalar> MappedNetwork<Scalar>::predict(const std::vector<Scalar>& input)
+{
+    // Input size does not match the number of inputs for the network
+    assert(input.size() == inputSize());
+
+    std::vector<Scalar> output(outputSize());
+    predict(input.data(), output.data());
+    return output;
+}
+
+template <typename Scalar>
+void MappedNetwork<Scalar>::predict(const Scalar* input, Scalar* output)
+{
+    assert(isOpen());
+    std::copy(input, input + inputSize(), activations.begin());
+
+    for (const MappedLayer& layer : mappedLayers)
+    {
+        auto feedForward = [&](size_t first, size_t last)
+        {
+            Kernels::gemv(layer.weights + first * layer.numInputs, activations.data(), nextActivations.data() + first, last - first, layer.numInputs);
+            for (size_t n = first; n < last; n++)
+                nextActivations[n] += layer.biases[n];
+            if (isElementWise(layer.activationFunction))
+                activate(layer.activationFunction, nextActivations.data() + first, nextActivations.data() + first, last - first);
+        };
+
+        ParallelWork::forEachChunk(threadPool, layer.numNeurons, layer.numInputs, feedForward);
+
+        if (!isElementWise(layer.activationFunction))
+            activate(layer.activationFunction, nextActivations.data(), nextActivations.data(), layer.numNeurons);
+
+        activations.swap(nextActivations);
+    }
+
+    std::copy(activations.begin(), activations.begin() + outputSize(), output);
+}
+
+template class MappedNetwork<float>;
+template class MappedNetwork<double>;
@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include "ActivationFunction.h"
+#include "MappedFile.h"
+#include "NNConstructionInfo.h"
+
+class ThreadPool;
+
+/**
+ * \brief Inference straight from a memory-mapped checkpoint, without copying the weights.
+ * Opening it only reads the header, the operating system pages the weights in the first time they are used,
+ * and several processes serving the same checkpoint share one copy of them in memory.
+ * \tparam Scalar Has to be the floating point type the checkpoint was saved with, float or double.
+ */
+template <typename Scalar>
+class MappedNetwork
+{
+public:
+    /**
+     * \brief Map a checkpoint written by Checkpoint::save. Check isOpen afterwards.
+     */
+    explicit MappedNetwork(const std::string& path);
+
+    /**
+     * \return false if the file couldn't be mapped, isn't a valid checkpoint, or was saved in the other precision.
+     */
+    bool isOpen() const { return file.isOpen(); }
+
+    /**
+     * \brief Predict the output for a given input, like NeuralNetwork::predict.
+     */
+    std::vector<Scalar> predict(const std::vector<Scalar>& input);
+
+    /**
+     * \brief Predict into a buffer owned by the caller. Doesn't allocate any memory.
+     * \param input inputSize() values to process.
+     * \param output Receives outputSize() values.
+     */
+    void predict(const Scalar* input, Scalar* output);
+
+    size_t inputSize() const { return topology.front().numNeurons; }
+    size_t outputSize() const { return topology.back().numNeurons; }
+
+    /**
+     * \brief Every layer in the checkpoint, the input layer first.
+     */
+    std::vector<LayerInfo> topology;
+
+    // Where wide layers split their neurons. ThreadPool::global() by default, nullptr runs on the calling thread.
+    ThreadPool* threadPool;
+
+protected:
+    struct MappedLayer
+    {
+        size_t numNeurons;
+        size_t numInputs;
+        ActiviationFunction activationFunction;
+
+        // Both point into the mapped file
+        const Scalar* weights;
+        const Scalar* biases;
+    };
+
+    MappedFile file;
+    std::vector<MappedLayer> mappedLayers;
+
+    // Buffers for predict, so it doesn't allocate them on every call. One layer reads one and writes the other.
+    std::vector<Scalar> activations;
+    std::vector<Scalar> nextActivations;
+};
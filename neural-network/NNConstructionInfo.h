@@ -3,21 +3,181 @@
 #include <vector>
 #include "ActivationFunction.h"
 
+/**
+ * \brief How a layer's initial weights and biases are drawn.
+ */
+enum WeightInitializer
+{
+    // Weights and biases uniform between -1 and 1
+    UniformInit,
+    // Glorot/Xavier: weights uniform in +-sqrt(6 / (inputs + neurons)), biases 0. Keeps the variance of the
+    // activations and the gradients about the same through Sigmoid and Tanh layers.
+    XavierInit,
+    // He: weights uniform in +-sqrt(6 / inputs), biases 0. The same for ReLU layers, which zero half their inputs.
+    HeInit
+};
+
+/**
+ * \brief What a layer computes from the outputs of the previous layer.
+ */
+enum LayerType
+{
+    // Fully connected, every neuron has a weight for every input
+    Dense,
+    // 2D convolution over an image stored height x width x channels. Every filter has kernelSize x kernelSize x channels
+    // weights and a bias, shared by every position in the image, and gives one output channel.
+    Conv2D,
+    // The largest value of every kernelSize x kernelSize window, per channel, with windows kernelSize apart.
+    // No weights, and no activation function.
+    MaxPool
+};
+
+/**
+ * \brief How the weights and biases follow their changes during training.
+ */
+enum OptimizerType
+{
+    // Plain stochastic gradient descent: every change is added right away, scaled by the learning rate
+    SGD,
+    // SGD on a velocity that keeps a fraction (momentum) of the previous changes
+    Momentum,
+    // Momentum that looks one step ahead: the change itself plus the new velocity scaled by momentum
+    Nesterov,
+    // Adam: every weight gets its own step size from running averages of its changes and their squares
+    Adam,
+    // Adam with decoupled weight decay, which shrinks every weight by learningRate * weightDecay per step
+    AdamW
+};
+
+/**
+ * \brief The optimizer of a network and its settings. The learning rate stays per layer, in LayerInfo.
+ * Adam works best with much smaller learning rates than SGD, around 0.001.
+ */
+struct OptimizerInfo
+{
+    OptimizerType type = SGD;
+
+    // Momentum and Nesterov: how much of the velocity is kept every step
+    double momentum = 0.9;
+
+    // Adam and AdamW: how much of the running averages of the changes and of their squares is kept every step,
+    // and what is added to the square root of the second one to keep the step finite
+    double beta1 = 0.9;
+    double beta2 = 0.999;
+    double epsilon = 1e-8;
+
+    // AdamW only
+    double weightDecay = 0.01;
+
+    static OptimizerInfo sgd() { return OptimizerInfo(); }
+
+    static OptimizerInfo withMomentum(double momentum = 0.9, bool nesterov = false)
+    {
+        OptimizerInfo optimizer;
+        optimizer.type = nesterov ? Nesterov : Momentum;
+        optimizer.momentum = momentum;
+        return optimizer;
+    }
+
+    /**
+     * \param weightDecay 0 for Adam, anything else for AdamW.
+     */
+    static OptimizerInfo adam(double weightDecay = 0.0, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8)
+    {
+        OptimizerInfo optimizer;
+        optimizer.type = weightDecay != 0.0 ? AdamW : Adam;
+        optimizer.beta1 = beta1;
+        optimizer.beta2 = beta2;
+        optimizer.epsilon = epsilon;
+        optimizer.weightDecay = weightDecay;
+        return optimizer;
+    }
+
+    /**
+     * \return How many values the optimizer keeps per weight or bias: the change collected since the last step,
+     * and the velocity or the two running averages. None for SGD.
+     */
+    size_t stateSize() const { return type == SGD ? 0 : type == Momentum || type == Nesterov ? 2 : 3; }
+};
+
 struct LayerInfo
 {
     size_t numNeurons;
     double learningRate;
     ActiviationFunction activationFunction;
+    WeightInitializer weightInitializer;
+
+    LayerType type = Dense;
+
+    // Conv2D and MaxPool: the width and height of the filters or windows, how far apart they are, and how many
+    // zeros are added on every side of the input (Conv2D only)
+    size_t kernelSize = 0;
+    size_t stride = 1;
+    size_t padding = 0;
+
+    // The layer's outputs as an image, height x width x channels, channels last. Set by image() for the input layer
+    // and conv2D() for the number of filters, the rest is filled in by the network. Layers that aren't images are
+    // 1 x 1 x numNeurons.
+    size_t height = 1;
+    size_t width = 1;
+    size_t channels = 0;
 
     /**
      * \param numNeurons The number of neurons in the layer. For the input layer, this is
      * the number of inputs. For the output layer, number of outputs.
      * \param learningRate The rate of change for the weights and biases during training.
      * \param activationFunction Which activation function to use for the neurons in the layer.
+     * \param weightInitializer How to draw the layer's initial weights and biases.
+     */
+    LayerInfo(size_t numNeurons = 0, double learningRate = 0.05, ActiviationFunction activationFunction = ActiviationFunction::Sigmoid,
+        WeightInitializer weightInitializer = UniformInit)
+        : numNeurons(numNeurons), learningRate(learningRate), activationFunction(activationFunction), weightInitializer(weightInitializer)
+    {
+    }
+
+    /**
+     * \brief An input layer that takes images, for networks that start with Conv2D or MaxPool layers.
+     * Every input is height x width x channels values, channels last. One channel is the same as a row-major image.
+     */
+    static LayerInfo image(size_t height, size_t width, size_t channels = 1)
+    {
+        LayerInfo layerInfo(height * width * channels);
+        layerInfo.height = height;
+        layerInfo.width = width;
+        layerInfo.channels = channels;
+        return layerInfo;
+    }
+
+    /**
+     * \brief A convolution layer. The number of neurons is filled in by the network, one per filter and output pixel.
+     * \param filters The number of filters, which is the number of output channels.
+     * \param kernelSize The width and height of the filters.
+     * \param activationFunction Sigmoid, ReLU or Tanh.
+     * \param stride How far apart the filters are applied.
+     * \param padding Zeros added on every side of the input. (kernelSize - 1) / 2 keeps the image size with stride 1.
      */
-    LayerInfo(size_t numNeurons = 0, double learningRate = 0.05, ActiviationFunction activationFunction = ActiviationFunction::Sigmoid)
-        : numNeurons(numNeurons), learningRate(learningRate), activationFunction(activationFunction)
+    static LayerInfo conv2D(size_t filters, size_t kernelSize, double learningRate = 0.05, ActiviationFunction activationFunction = ReLU,
+        WeightInitializer weightInitializer = HeInit, size_t stride = 1, size_t padding = 0)
     {
+        LayerInfo layerInfo(0, learningRate, activationFunction, weightInitializer);
+        layerInfo.type = Conv2D;
+        layerInfo.kernelSize = kernelSize;
+        layerInfo.stride = stride;
+        layerInfo.padding = padding;
+        layerInfo.channels = filters;
+        return layerInfo;
+    }
+
+    /**
+     * \brief A max pooling layer with size x size windows that don't overlap. Leftover rows and columns are dropped.
+     */
+    static LayerInfo maxPool(size_t size)
+    {
+        LayerInfo layerInfo;
+        layerInfo.type = MaxPool;
+        layerInfo.kernelSize = size;
+        layerInfo.stride = size;
+        return layerInfo;
     }
 };
 
@@ -28,6 +188,23 @@ struct NNConstructionInfo
 {
     std::vector<LayerInfo> topology;
 
+    // Seed for the initial weights and biases. Networks built with the same non-zero seed start out
+    // identical, whatever the number of threads. 0 picks a random seed.
+    unsigned int seed = 0;
+
+    // Shared by every layer
+    OptimizerInfo optimizer;
+
+    // Lay out the weights, biases, optimizer state and activations of the whole network in one arena sized up front,
+    // instead of one heap allocation per buffer. The batch buffers get an arena of their own.
+    bool useArena = true;
+
+    // Back the arenas with huge pages where the operating system allows it
+    bool hugePages = false;
+
+    // The batch buffers are sized for this many samples up front. A larger batch sizes them again, once.
+    size_t maxBatchSize = 0;
+
     /**
      * \param inputLayerNumNeurons How many inputs the network should have.
      * We only pass in a number here because the input layer doesn't have any weights or biases.
@@ -39,6 +216,16 @@ struct NNConstructionInfo
         topology.push_back(outputLayer);
     }
 
+    /**
+     * \param inputLayer The input layer, e.g. LayerInfo::image for networks with Conv2D layers.
+     * \param outputLayer The output layer, which has to be Dense.
+     */
+    NNConstructionInfo(const LayerInfo& inputLayer, const LayerInfo& outputLayer)
+    {
+        topology.push_back(inputLayer);
+        topology.push_back(outputLayer);
+    }
+
     /**
      * \brief Insert a new hidden layer into the topology
      * \param layerInfo Info for the layer to be constructed
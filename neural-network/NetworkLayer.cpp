@@ -0,0 +1,659 @@
+﻿#include "NetworkLayer.h"
+#include "Arena.h"
+#include "Kernels.h"
+#include "Random.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    /**
+     * Fill in deltas = target - output for one sample, and return its loss from the same loop.
+     * Softmax is paired with the cross-entropy, everything else with the mean squared error.
+     */
+    template <typename Scalar>
+    double outputDeltas(ActiviationFunction activationFunction, const Scalar* target, const Scalar* output, Scalar* deltas, size_t count)
+    {
+        double loss = 0.0;
+        if (activationFunction == Softmax)
+        {
+            for (size_t n = 0; n < count; n++)
+            {
+                // Read before writing the delta, target can be the deltas array
+                const Scalar expected = target[n];
+                deltas[n] = expected - output[n];
+                // Outputs that underflowed to 0 would give an infinite loss
+                if (expected != 0)
+                    loss -= expected * std::log(std::max(output[n], std::numeric_limits<Scalar>::min()));
+            }
+            return loss;
+        }
+
+        for (size_t n = 0; n < count; n++)
+        {
+            deltas[n] = target[n] - output[n];
+            loss += deltas[n] * deltas[n];
+        }
+        return loss / (double)count;
+    }
+
+    // Make a scratch buffer at least size long. Only allocates when it grows.
+    template <typename Buffer>
+    void reserve(Buffer& buffer, size_t size)
+    {
+        if (buffer.size() < size)
+            buffer.resize(size);
+    }
+
+    // Empty the buffer and give its memory back to its memory resource
+    template <typename Buffer>
+    void release(Buffer& buffer)
+    {
+        Buffer(buffer.get_allocator()).swap(buffer);
+    }
+
+    // One row of weights and a bias per neuron, or per filter. MaxPool layers have none.
+    void weightShape(const LayerInfo& layerInfo, const LayerInfo* inputLayer, size_t& numRows, size_t& rowSize)
+    {
+        const LayerType type = inputLayer != nullptr ? layerInfo.type : Dense;
+        numRows = type == Dense ? layerInfo.numNeurons : type == Conv2D ? layerInfo.channels : 0;
+        rowSize = inputLayer == nullptr ? 0 : type == Conv2D ? layerInfo.kernelSize * layerInfo.kernelSize * inputLayer->channels : inputLayer->numNeurons;
+    }
+}
+
+template <typename Scalar>
+LayerState<Scalar>::LayerState(size_t numNeurons, std::pmr::memory_resource* memory, std::pmr::memory_resource* batchMemory)
+    : originalOutputs(numNeurons, Scalar(0), memory),
+      outputs(numNeurons, Scalar(0), memory),
+      errorGradients(numNeurons, Scalar(0), memory),
+      errorDeltas(numNeurons, Scalar(0), memory),
+      batchOutputs(batchMemory != nullptr ? batchMemory : memory),
+      batchErrorGradients(batchMemory != nullptr ? batchMemory : memory),
+      batchErrorDeltas(batchMemory != nullptr ? batchMemory : memory),
+      sparseIndices(numNeurons, 0, memory),
+      sparseValues(numNeurons, Scalar(0), memory),
+      columns(batchMemory != nullptr ? batchMemory : memory),
+      columnGradients(batchMemory != nullptr ? batchMemory : memory),
+      poolIndices(batchMemory != nullptr ? batchMemory : memory)
+{
+}
+
+template <typename Scalar>
+LayerState<Scalar>::LayerState(const LayerState& other, std::pmr::memory_resource* memory, std::pmr::memory_resource* batchMemory)
+    : originalOutputs(other.originalOutputs, memory),
+      outputs(other.outputs, memory),
+      errorGradients(other.errorGradients, memory),
+      errorDeltas(other.errorDeltas, memory),
+      batchOutputs(other.batchOutputs, batchMemory != nullptr ? batchMemory : memory),
+      batchErrorGradients(other.batchErrorGradients, batchMemory != nullptr ? batchMemory : memory),
+      batchErrorDeltas(other.batchErrorDeltas, batchMemory != nullptr ? batchMemory : memory),
+      sparse(other.sparse),
+      numNonZero(other.numNonZero),
+      sparseIndices(other.sparseIndices, memory),
+      sparseValues(other.sparseValues, memory),
+      columns(other.columns, batchMemory != nullptr ? batchMemory : memory),
+      columnGradients(other.columnGradients, batchMemory != nullptr ? batchMemory : memory),
+      poolIndices(other.poolIndices, batchMemory != nullptr ? batchMemory : memory)
+{
+}
+
+template <typename Scalar>
+size_t LayerState<Scalar>::memoryBytes(size_t numNeurons)
+{
+    // originalOutputs, outputs, errorGradients, errorDeltas and sparseValues, and sparseIndices
+    return 5 * Arena::bytes<Scalar>(numNeurons) + Arena::bytes<uint32_t>(numNeurons);
+}
+
+template <typename Scalar>
+void LayerState<Scalar>::reserveBatch(size_t batchSize)
+{
+    if (batchOutputs.size() < batchSize * size())
+    {
+        batchOutputs.resize(batchSize * size());
+        batchErrorGradients.resize(batchSize * size());
+        batchErrorDeltas.resize(batchSize * size());
+    }
+}
+
+template <typename Scalar>
+void LayerState<Scalar>::releaseBatch()
+{
+    release(batchOutputs);
+    release(batchErrorGradients);
+    release(batchErrorDeltas);
+    release(columns);
+    release(columnGradients);
+    release(poolIndices);
+}
+
+template <typename Scalar>
+void LayerState<Scalar>::updateSparsity(double maxDensity)
+{
+    numNonZero = 0;
+    for (size_t i = 0; i < size(); i++)
+    {
+        if (outputs[i] != 0)
+        {
+            sparseIndices[numNonZero] = (uint32_t)i;
+            sparseValues[numNonZero] = outputs[i];
+            numNonZero++;
+        }
+    }
+
+    sparse = (double)numNonZero <= maxDensity * (double)size();
+}
+
+template <typename Scalar>
+NetworkLayer<Scalar>::NetworkLayer(const LayerInfo& layerInfo, const LayerInfo* inputLayer, unsigned int seed, ThreadPool* threadPool,
+    const OptimizerInfo& optimizer, std::pmr::memory_resource* memory)
+    : type(inputLayer != nullptr ? layerInfo.type : Dense),
+      numNeurons(layerInfo.numNeurons),
+      numInputs(inputLayer != nullptr ? inputLayer->numNeurons : 0),
+      learningRate(layerInfo.learningRate),
+      activationFunction(layerInfo.activationFunction),
+      weights(memory),
+      biases(memory),
+      optimizer(optimizer),
+      optimizerState(memory),
+      threadPool(threadPool)
+{
+    if (type != Dense)
+    {
+        geometry.inputHeight = inputLayer->height;
+        geometry.inputWidth = inputLayer->width;
+        geometry.inputChannels = inputLayer->channels;
+        geometry.kernelSize = layerInfo.kernelSize;
+        geometry.stride = layerInfo.stride;
+        geometry.padding = layerInfo.padding;
+        geometry.outputHeight = layerInfo.height;
+        geometry.outputWidth = layerInfo.width;
+        geometry.outputChannels = layerInfo.channels;
+    }
+
+    size_t numRows, rowSize;
+    weightShape(layerInfo, inputLayer, numRows, rowSize);
+    weights.resize(numRows * rowSize);
+    biases.resize(numRows);
+    optimizerState.resize(optimizer.stateSize() * (weights.size() + biases.size()));
+
+    // A filter is connected to patchSize inputs and, going backwards, to kernelSize x kernelSize x filters outputs
+    const size_t fanIn = rowSize;
+    const size_t fanOut = type == Conv2D ? geometry.kernelSize * geometry.kernelSize * geometry.outputChannels : numNeurons;
+
+    double weightRange = 1.0;
+    if (layerInfo.weightInitializer == XavierInit)
+        weightRange = std::sqrt(6.0 / (double)std::max<size_t>(1, fanIn + fanOut));
+    else if (layerInfo.weightInitializer == HeInit)
+        weightRange = std::sqrt(6.0 / (double)std::max<size_t>(1, fanIn));
+    const bool randomBiases = layerInfo.weightInitializer == UniformInit;
+
+    // Weight i of neuron n is number n * numInputs + i of the layer's stream, and the biases come after the
+    // weights. That makes every value independent of the others, so the chunks can be filled on any thread.
+    const uint64_t key = Random::mix(seed);
+    ParallelWork::forEachChunk(threadPool, numRows, rowSize, [&](size_t first, size_t last)
+    {
+        for (size_t n = first; n < last; n++)
+        {
+            Scalar* row = weightRow(n);
+            const uint64_t rowStart = (uint64_t)n * rowSize;
+            for (size_t i = 0; i < rowSize; i++)
+                row[i] = (Scalar)(weightRange * Random::uniform(key, rowStart + i));
+
+            biases[n] = randomBiases ? (Scalar)Random::uniform(key, weights.size() + n) : Scalar(0);
+        }
+    });
+}
+
+template <typename Scalar>
+NetworkLayer<Scalar>::NetworkLayer(const NetworkLayer& other, std::pmr::memory_resource* memory)
+    : type(other.type),
+      numNeurons(other.numNeurons),
+      numInputs(other.numInputs),
+      geometry(other.geometry),
+      learningRate(other.learningRate),
+      activationFunction(other.activationFunction),
+      weights(other.weights, memory),
+      biases(other.biases, memory),
+      optimizer(other.optimizer),
+      optimizerState(other.optimizerState, memory),
+      optimizerSteps(other.optimizerSteps),
+      threadPool(other.threadPool)
+{
+}
+
+template <typename Scalar>
+size_t NetworkLayer<Scalar>::memoryBytes(const LayerInfo& layerInfo, const LayerInfo* inputLayer, const OptimizerInfo& optimizer)
+{
+    size_t numRows, rowSize;
+    weightShape(layerInfo, inputLayer, numRows, rowSize);
+    return Arena::bytes<Scalar>(numRows * rowSize) + Arena::bytes<Scalar>(numRows)
+        + Arena::bytes<Scalar>(optimizer.stateSize() * (numRows * rowSize + numRows));
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::reserveBatch(LayerState<Scalar>& state, size_t batchSize) const
+{
+    state.reserveBatch(batchSize);
+
+    const size_t images = std::max<size_t>(1, batchSize);
+    if (type == MaxPool)
+    {
+        reserve(state.poolIndices, images * numNeurons);
+    }
+    else if (type == Conv2D)
+    {
+        const size_t windows = images * geometry.outputPixels() * geometry.patchSize();
+        if (!Convolution::isDirect(geometry))
+            reserve(state.columns, windows);
+        reserve(state.columnGradients, windows);
+    }
+}
+
+template <typename Scalar>
+size_t NetworkLayer<Scalar>::batchMemoryBytes(size_t batchSize) const
+{
+    // batchOutputs, batchErrorGradients and batchErrorDeltas
+    size_t bytes = 3 * Arena::bytes<Scalar>(batchSize * numNeurons);
+
+    const size_t images = std::max<size_t>(1, batchSize);
+    if (type == MaxPool)
+    {
+        bytes += Arena::bytes<uint32_t>(images * numNeurons);
+    }
+    else if (type == Conv2D)
+    {
+        const size_t windows = images * geometry.outputPixels() * geometry.patchSize();
+        bytes += (Convolution::isDirect(geometry) ? 1 : 2) * Arena::bytes<Scalar>(windows);
+    }
+    return bytes;
+}
+
+template <typename Scalar>
+double NetworkLayer<Scalar>::multiplyAdds() const
+{
+    if (type == Conv2D)
+        return (double)geometry.outputSize() * (double)geometry.patchSize();
+    if (type == MaxPool)
+        return (double)numNeurons * (double)(geometry.kernelSize * geometry.kernelSize);
+    return (double)numNeurons * (double)numInputs;
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::feedForward(const LayerState<Scalar>& previous, LayerState<Scalar>& state) const
+{
+    if (type != Dense)
+    {
+        feedForwardImages(previous.outputs.data(), state.outputs.data(), state, 1);
+        return;
+    }
+
+    ParallelWork::forEachChunk(threadPool, numNeurons, numInputs, [&](size_t first, size_t last)
+    {
+        // Multiply each input by the corresponding weight and sum them up, for every neuron in the chunk at once.
+        // Zero inputs don't add anything, so sparse inputs skip them.
+        if (previous.sparse)
+            Kernels::sparseGemv(weightRow(first), previous.sparseIndices.data(), previous.sparseValues.data(), previous.numNonZero,
+                state.originalOutputs.data() + first, last - first, numInputs);
+        else
+            Kernels::gemv(weightRow(first), previous.outputs.data(), state.originalOutputs.data() + first, last - first, numInputs);
+
+        for (size_t n = first; n < last; n++)
+            state.originalOutputs[n] += biases[n];
+        if (isElementWise(activationFunction))
+            activate(activationFunction, state.originalOutputs.data() + first, state.outputs.data() + first, last - first);
+    });
+
+    if (!isElementWise(activationFunction))
+        activate(activationFunction, state.originalOutputs.data(), state.outputs.data(), numNeurons);
+}
+
+template <typename Scalar>
+double NetworkLayer<Scalar>::calculateOutputGradients(LayerState<Scalar>& state, const Scalar* targetOutput) const
+{
+    // Expected output - predicted output
+    const double loss = outputDeltas(activationFunction, targetOutput, state.outputs.data(), state.errorDeltas.data(), numNeurons);
+
+    std::copy(state.errorDeltas.begin(), state.errorDeltas.end(), state.errorGradients.begin());
+    multiplyByDerivative(activationFunction, state.outputs.data(), state.errorGradients.data(), numNeurons);
+    return loss;
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::calculateHiddenGradients(const NetworkLayer& layerToTheRight, LayerState<Scalar>& stateToTheRight, LayerState<Scalar>& state) const
+{
+    // MaxPool layers pass the gradients straight through, they have no activation function
+    const bool applyDerivative = type != MaxPool;
+
+    if (layerToTheRight.type != Dense)
+    {
+        layerToTheRight.calculateInputGradients(stateToTheRight, stateToTheRight.errorGradients.data(), state.errorGradients.data(), 1);
+        if (applyDerivative)
+            multiplyByDerivative(activationFunction, state.outputs.data(), state.errorGradients.data(), numNeurons);
+        return;
+    }
+
+    // Sum up the error for each neuron in the next layer. This is the next layer's weight matrix
+    // transposed times its gradients, which the kernel computes by walking the weight matrix
+    // row by row instead of reading one column (weight[k][n] for every k) per neuron in this layer.
+    // Chunks take a slice of the columns, so every chunk writes its own gradients.
+    ParallelWork::forEachChunk(threadPool, numNeurons, layerToTheRight.numNeurons, [&](size_t first, size_t last)
+    {
+        std::fill(state.errorGradients.begin() + first, state.errorGradients.begin() + last, Scalar(0));
+        Kernels::gemvTransposed(layerToTheRight.weights.data() + first, numNeurons, stateToTheRight.errorGradients.data(),
+            state.errorGradients.data() + first, layerToTheRight.numNeurons, last - first);
+
+        if (applyDerivative)
+            multiplyByDerivative(activationFunction, state.outputs.data() + first, state.errorGradients.data() + first, last - first);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::updateWeights(const LayerState<Scalar>& previous, const LayerState<Scalar>& state, bool isOutputLayer)
+{
+    if (type != Dense)
+    {
+        // Only ever a hidden layer, and the biases change along with the filters
+        if (type == Conv2D)
+            ParallelWork::forEachChunk(threadPool, geometry.outputChannels, geometry.outputPixels() * geometry.patchSize(), [&](size_t first, size_t last)
+            {
+                updateFilters(previous.outputs.data(), state, state.errorGradients.data(), 1, changeScale(), first, last);
+            });
+        return;
+    }
+
+    const std::pmr::vector<Scalar>& errors = isOutputLayer ? state.errorDeltas : state.errorGradients;
+
+    // Weights += learningRate * errors * inputs^T. Instead of storing the inputs in this layer,
+    // we just use the output from the previous layer.
+    const Scalar scale = changeScale();
+    Scalar* changes = weightChanges();
+    ParallelWork::forEachChunk(threadPool, numNeurons, numInputs, [&](size_t first, size_t last)
+    {
+        // The weights of zero inputs don't change
+        if (previous.sparse)
+            Kernels::sparseGer(scale, errors.data() + first, previous.sparseIndices.data(), previous.sparseValues.data(),
+                previous.numNonZero, changes + first * numInputs, last - first, numInputs);
+        else
+            Kernels::ger(scale, errors.data() + first, previous.outputs.data(), changes + first * numInputs, last - first, numInputs);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::updateBiases(const LayerState<Scalar>& state)
+{
+    // Conv2D biases are updated by updateWeights, and MaxPool has none
+    if (type != Dense)
+        return;
+
+    const Scalar scale = changeScale();
+    Scalar* changes = biasChanges();
+    for (size_t n = 0; n < numNeurons; n++)
+        changes[n] += scale * state.errorGradients[n];
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::feedForwardBatch(const LayerState<Scalar>& previous, LayerState<Scalar>& state, size_t batchSize) const
+{
+    state.reserveBatch(batchSize);
+    if (type != Dense)
+    {
+        feedForwardImages(previous.batchOutputs.data(), state.batchOutputs.data(), state, batchSize);
+        return;
+    }
+
+    // Outputs = Inputs * Weights^T + biases, as one blocked matrix-matrix product per chunk of samples.
+    // Splitting the samples instead of the neurons keeps every chunk's output rows contiguous.
+    ParallelWork::forEachChunk(threadPool, batchSize, numNeurons * numInputs, [&](size_t first, size_t last)
+    {
+        for (size_t b = first; b < last; b++)
+            std::copy(biases.begin(), biases.end(), state.batchOutputs.begin() + b * numNeurons);
+
+        Kernels::gemmNT(previous.batchOutputs.data() + first * numInputs, weights.data(),
+            state.batchOutputs.data() + first * numNeurons, last - first, numNeurons, numInputs);
+
+        Scalar* outputs = state.batchOutputs.data() + first * numNeurons;
+        activateRows(activationFunction, outputs, outputs, last - first, numNeurons);
+    });
+}
+
+template <typename Scalar>
+double NetworkLayer<Scalar>::calculateOutputGradientsBatch(LayerState<Scalar>& state, const Scalar* targetOutputs, size_t batchSize) const
+{
+    double lossSum = 0.0;
+    for (size_t b = 0; b < batchSize; b++)
+    {
+        const Scalar* output = state.batchOutputs.data() + b * numNeurons;
+        Scalar* deltas = state.batchErrorDeltas.data() + b * numNeurons;
+        lossSum += outputDeltas(activationFunction, targetOutputs + b * numNeurons, output, deltas, numNeurons);
+    }
+
+    std::copy(state.batchErrorDeltas.begin(), state.batchErrorDeltas.begin() + batchSize * numNeurons, state.batchErrorGradients.begin());
+    multiplyByDerivative(activationFunction, state.batchOutputs.data(), state.batchErrorGradients.data(), batchSize * numNeurons);
+    return lossSum;
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::calculateHiddenGradientsBatch(const NetworkLayer& layerToTheRight, LayerState<Scalar>& stateToTheRight,
+    LayerState<Scalar>& state, size_t batchSize) const
+{
+    const bool applyDerivative = type != MaxPool;
+
+    if (layerToTheRight.type != Dense)
+    {
+        layerToTheRight.calculateInputGradients(stateToTheRight, stateToTheRight.batchErrorGradients.data(), state.batchErrorGradients.data(), batchSize);
+        if (applyDerivative)
+            multiplyByDerivative(activationFunction, state.batchOutputs.data(), state.batchErrorGradients.data(), batchSize * numNeurons);
+        return;
+    }
+
+    // Gradients = GradientsToTheRight * WeightsToTheRight, then scaled by the activation derivative
+    ParallelWork::forEachChunk(threadPool, batchSize, numNeurons * layerToTheRight.numNeurons, [&](size_t first, size_t last)
+    {
+        std::fill(state.batchErrorGradients.begin() + first * numNeurons, state.batchErrorGradients.begin() + last * numNeurons, Scalar(0));
+        Kernels::gemmNN(stateToTheRight.batchErrorGradients.data() + first * layerToTheRight.numNeurons, layerToTheRight.weights.data(),
+            state.batchErrorGradients.data() + first * numNeurons, last - first, numNeurons, layerToTheRight.numNeurons);
+
+        if (applyDerivative)
+            multiplyByDerivative(activationFunction, state.batchOutputs.data() + first * numNeurons,
+            state.batchErrorGradients.data() + first * numNeurons, (last - first) * numNeurons);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::updateWeightsBatch(const LayerState<Scalar>& previous, const LayerState<Scalar>& state, bool isOutputLayer, size_t batchSize)
+{
+    const Scalar rate = changeScale() / (Scalar)batchSize;
+    const size_t workPerRow = type == Conv2D ? geometry.outputPixels() * geometry.patchSize() * batchSize : numInputs * batchSize;
+
+    // Step every chunk right after collecting its changes, while they are still in cache
+    countStep();
+    ParallelWork::forEachChunk(threadPool, numWeightRows(), workPerRow, [&](size_t first, size_t last)
+    {
+        updateWeightsBatchRange(previous, state, isOutputLayer, batchSize, rate, first, last);
+        stepRange(first, last);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::updateWeightsBatchRange(const LayerState<Scalar>& previous, const LayerState<Scalar>& state, bool isOutputLayer,
+    size_t batchSize, Scalar rate, size_t firstNeuron, size_t lastNeuron)
+{
+    if (type != Dense)
+    {
+        if (type == Conv2D)
+            updateFilters(previous.batchOutputs.data(), state, state.batchErrorGradients.data(), batchSize, rate, firstNeuron, lastNeuron);
+        return;
+    }
+
+    const std::pmr::vector<Scalar>& errors = isOutputLayer ? state.batchErrorDeltas : state.batchErrorGradients;
+
+    // Weights += rate * Errors^T * Inputs. The kernel accumulates the changes from every sample
+    // into a weight row while it is in cache, so each weight is read and written once per batch.
+    Kernels::gemmTN(rate, errors.data() + firstNeuron, numNeurons, previous.batchOutputs.data(),
+        weightChanges() + firstNeuron * numInputs, lastNeuron - firstNeuron, numInputs, batchSize);
+
+    Scalar* changes = biasChanges();
+    for (size_t n = firstNeuron; n < lastNeuron; n++)
+    {
+        Scalar biasChange = 0;
+        for (size_t b = 0; b < batchSize; b++)
+            biasChange += state.batchErrorGradients[b * numNeurons + n];
+
+        changes[n] += rate * biasChange;
+    }
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::step()
+{
+    if (optimizer.type == SGD || numWeightRows() == 0)
+        return;
+
+    countStep();
+    ParallelWork::forEachChunk(threadPool, numWeightRows(), weightRowSize(), [&](size_t first, size_t last)
+    {
+        stepRange(first, last);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::stepRange(size_t firstRow, size_t lastRow)
+{
+    if (optimizer.type == SGD)
+        return;
+
+    const Scalar rate = learningRate;
+    const Scalar momentum = (Scalar)optimizer.momentum;
+    const size_t numParameters = weights.size() + biases.size();
+    Scalar* changes = optimizerState.data();
+    Scalar* first = changes + numParameters;
+    Scalar* second = first + numParameters;
+
+    // Adam's running averages start at 0, which biases them towards 0 for the first steps. Dividing them by
+    // 1 - beta^t corrects that. Folded into the rate and epsilon, so the kernel doesn't need to know the step.
+    const double t = (double)std::max<uint64_t>(1, optimizerSteps);
+    const double firstCorrection = 1.0 - std::pow(optimizer.beta1, t);
+    const double secondCorrection = std::sqrt(1.0 - std::pow(optimizer.beta2, t));
+    const Scalar adamRate = (Scalar)(learningRate * secondCorrection / firstCorrection);
+    const Scalar adamEpsilon = (Scalar)(optimizer.epsilon * secondCorrection);
+    const Scalar decay = optimizer.type == AdamW ? (Scalar)(learningRate * optimizer.weightDecay) : Scalar(0);
+
+    // One fused pass over the rows' weights, and one over their biases
+    auto stepParameters = [&](Scalar* parameters, size_t offset, size_t count)
+    {
+        if (optimizer.type == Momentum)
+            Kernels::momentumStep(rate, momentum, parameters, changes + offset, first + offset, count);
+        else if (optimizer.type == Nesterov)
+            Kernels::nesterovStep(rate, momentum, parameters, changes + offset, first + offset, count);
+        else
+            Kernels::adamStep(adamRate, (Scalar)optimizer.beta1, (Scalar)optimizer.beta2, adamEpsilon, decay, parameters,
+                changes + offset, first + offset, second + offset, count);
+    };
+
+    const size_t rowSize = weightRowSize();
+    stepParameters(weightRow(firstRow), firstRow * rowSize, (lastRow - firstRow) * rowSize);
+    stepParameters(biases.data() + firstRow, weights.size() + firstRow, lastRow - firstRow);
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::feedForwardImages(const Scalar* inputs, Scalar* outputs, LayerState<Scalar>& state, size_t batchSize) const
+{
+    if (type == MaxPool)
+    {
+        reserve(state.poolIndices, batchSize * numNeurons);
+        ParallelWork::forEachChunk(threadPool, batchSize, numNeurons * geometry.kernelSize * geometry.kernelSize, [&](size_t first, size_t last)
+        {
+            Convolution::maxPool(geometry, inputs, first, last, outputs, state.poolIndices.data());
+        });
+        return;
+    }
+
+    // Every output pixel of every image is one row: its window times every filter, plus the biases.
+    // That is Outputs = Windows * Weights^T, the same product as a dense batch with windows for samples.
+    const size_t numRows = batchSize * geometry.outputPixels();
+    const size_t filters = geometry.outputChannels;
+    const size_t patchSize = geometry.patchSize();
+    const bool direct = Convolution::isDirect(geometry);
+    if (!direct)
+        reserve(state.columns, numRows * patchSize);
+
+    ParallelWork::forEachChunk(threadPool, numRows, patchSize * filters, [&](size_t first, size_t last)
+    {
+        Scalar* chunkOutputs = outputs + first * filters;
+        if (direct)
+        {
+            Convolution::convolve3x3(geometry, weights.data(), biases.data(), inputs, first, last, outputs);
+        }
+        else
+        {
+            Convolution::im2col(geometry, inputs, first, last, state.columns.data());
+            for (size_t r = first; r < last; r++)
+                std::copy(biases.begin(), biases.end(), outputs + r * filters);
+            Kernels::gemmNT(state.columns.data() + first * patchSize, weights.data(), chunkOutputs, last - first, filters, patchSize);
+        }
+
+        activate(activationFunction, chunkOutputs, chunkOutputs, (last - first) * filters);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::calculateInputGradients(LayerState<Scalar>& state, const Scalar* errorGradients, Scalar* inputGradients, size_t batchSize) const
+{
+    if (type == MaxPool)
+    {
+        ParallelWork::forEachChunk(threadPool, batchSize, numNeurons, [&](size_t first, size_t last)
+        {
+            Convolution::maxPoolGradients(geometry, errorGradients, state.poolIndices.data(), first, last, inputGradients);
+        });
+        return;
+    }
+
+    // The gradients of the windows are ErrorGradients * Weights, like a dense hidden layer with windows for neurons,
+    // and every input's gradient is the sum over the windows it is in (col2im). Chunks take whole images,
+    // so the sums of every chunk stay in its own images.
+    const size_t pixels = geometry.outputPixels();
+    const size_t filters = geometry.outputChannels;
+    const size_t patchSize = geometry.patchSize();
+    reserve(state.columnGradients, batchSize * pixels * patchSize);
+
+    ParallelWork::forEachChunk(threadPool, batchSize, pixels * patchSize * filters, [&](size_t first, size_t last)
+    {
+        Scalar* columnGradients = state.columnGradients.data() + first * pixels * patchSize;
+        std::fill(columnGradients, columnGradients + (last - first) * pixels * patchSize, Scalar(0));
+        Kernels::gemmNN(errorGradients + first * pixels * filters, weights.data(), columnGradients, (last - first) * pixels, patchSize, filters);
+        Convolution::col2im(geometry, state.columnGradients.data(), first, last, inputGradients);
+    });
+}
+
+template <typename Scalar>
+void NetworkLayer<Scalar>::updateFilters(const Scalar* inputs, const LayerState<Scalar>& state, const Scalar* errorGradients, size_t batchSize,
+    Scalar rate, size_t firstFilter, size_t lastFilter)
+{
+    const size_t numRows = batchSize * geometry.outputPixels();
+    const size_t filters = geometry.outputChannels;
+
+    // Filters += rate * ErrorGradients^T * Windows, summed over every output pixel the filters were applied to
+    Scalar* changes = weightChanges();
+    if (Convolution::isDirect(geometry))
+        Convolution::updateFilters3x3(geometry, rate, errorGradients, inputs, numRows, changes, firstFilter, lastFilter);
+    else
+        Kernels::gemmTN(rate, errorGradients + firstFilter, filters, state.columns.data(), changes + firstFilter * geometry.patchSize(),
+            lastFilter - firstFilter, geometry.patchSize(), numRows);
+
+    Scalar* filterBiasChanges = biasChanges();
+    for (size_t f = firstFilter; f < lastFilter; f++)
+    {
+        Scalar biasChange = 0;
+        for (size_t r = 0; r < numRows; r++)
+            biasChange += errorGradients[r * filters + f];
+
+        filterBiasChanges[f] += rate * biasChange;
+    }
+}
+
+template struct LayerState<float>;
+template struct LayerState<double>;
+template struct NetworkLayer<float>;
+template struct NetworkLayer<double>;
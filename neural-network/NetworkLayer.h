@@ -1,22 +1,315 @@
 ﻿#pragma once
 
+#include <cstdint>
+#include <memory_resource>
 #include <vector>
-#include "Neuron.h"
+#include "ActivationFunction.h"
+#include "Convolution.h"
 #include "NNConstructionInfo.h"
 
+class ThreadPool;
+
+/**
+ * \brief Everything a forward and backward pass writes for one layer: the activations and the
+ * error gradients, both for single samples and for mini-batches. Kept apart from the layer's weights,
+ * so several passes (e.g. one per thread) can run over the same weights at the same time.
+ * The buffers come from a memory resource, the heap unless the network has an Arena.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+struct LayerState
+{
+    /**
+     * \param numNeurons The number of neurons in the layer this state belongs to.
+     * \param memory Where the single-sample buffers come from, allocated right away.
+     * \param batchMemory Where the batch buffers (and the Conv2D and MaxPool scratch buffers) come from once
+     * reserveBatch sizes them. nullptr uses memory.
+     */
+    LayerState(size_t numNeurons = 0, std::pmr::memory_resource* memory = std::pmr::get_default_resource(),
+        std::pmr::memory_resource* batchMemory = nullptr);
+
+    /**
+     * \brief Copy other's buffers into new ones from memory and batchMemory.
+     */
+    LayerState(const LayerState& other, std::pmr::memory_resource* memory, std::pmr::memory_resource* batchMemory = nullptr);
+
+    /**
+     * \return How many bytes the constructor takes from an Arena for a layer of numNeurons.
+     */
+    static size_t memoryBytes(size_t numNeurons);
+
+    /**
+     * \brief Make sure the batch buffers can hold batchSize samples.
+     */
+    void reserveBatch(size_t batchSize);
+
+    /**
+     * \brief Give the batch buffers back, before their memory is reset.
+     */
+    void releaseBatch();
+
+    size_t size() const { return outputs.size(); }
+
+    /**
+     * \brief Collect the non-zero outputs into sparseIndices and sparseValues, and set sparse if at most
+     * maxDensity of the outputs are non-zero. The layer to the right then uses the sparse kernels.
+     * Doesn't allocate, the constructor sizes sparseIndices and sparseValues.
+     */
+    void updateSparsity(double maxDensity);
+
+    // The raw output values of the neurons before applying the activation function
+    std::pmr::vector<Scalar> originalOutputs;
+
+    // The activated, predicted output values
+    std::pmr::vector<Scalar> outputs;
+
+    // Error gradient values for backpropagation
+    std::pmr::vector<Scalar> errorGradients;
+
+    /**
+     * \brief aka. Error difference.
+     * The diff between the expected output and the predicted output.
+     * Only used for the output layer.
+     */
+    std::pmr::vector<Scalar> errorDeltas;
+
+    // Mini-batch versions of outputs, errorGradients and errorDeltas. batchSize x numNeurons, row-major.
+    std::pmr::vector<Scalar> batchOutputs;
+    std::pmr::vector<Scalar> batchErrorGradients;
+    std::pmr::vector<Scalar> batchErrorDeltas;
+
+    // The non-zero outputs as index/value pairs, see updateSparsity. Only valid while sparse is set.
+    bool sparse = false;
+    size_t numNonZero = 0;
+    std::pmr::vector<uint32_t> sparseIndices;
+    std::pmr::vector<Scalar> sparseValues;
+
+    // Conv2D layers: the im2col matrix of the last forward pass, one window per output pixel and sample, kept for
+    // the weight update. Its gradients in the backward pass.
+    std::pmr::vector<Scalar> columns;
+    std::pmr::vector<Scalar> columnGradients;
+
+    // MaxPool layers: where in its image every output of the last forward pass came from, one per output and sample
+    std::pmr::vector<uint32_t> poolIndices;
+};
+
 /**
  * \brief A layer in the neural network, containing a number of neurons.
+ * The neurons are stored as a structure of arrays: all weights of the layer live in one
+ * contiguous row-major matrix (one row per neuron, one column per input), and the biases in
+ * a dense array. Activations and gradients live in a separate LayerState.
+ * Wide layers split their neurons (or the samples of a batch) into chunks and run them on threadPool.
+ * Layers with too little work per pass stay on the calling thread.
+ * Conv2D layers have one row of weights per filter instead, and one neuron per filter and output pixel.
+ * MaxPool layers have no weights.
+ * \tparam Scalar The floating point type of the weights and activations, float or double.
  */
+template <typename Scalar>
 struct NetworkLayer
 {
-    NetworkLayer(const LayerInfo& layerInfo, size_t numNeuronInputs)
-    {
-        neurons.reserve(layerInfo.numNeurons);
-        for (size_t i = 0; i < layerInfo.numNeurons; i++)
-        {
-            neurons.emplace_back(numNeuronInputs, layerInfo.learningRate, layerInfo.activationFunction);
-        }
-    }
-    
-    std::vector<Neuron> neurons;
+    /**
+     * \param layerInfo Info for the layer to be constructed, with its image size filled in for Conv2D and MaxPool.
+     * \param inputLayer Info for the previous layer, whose outputs are this layer's inputs. nullptr for the input layer.
+     * \param seed Seed for the random initial weights and biases, which are filled in on threadPool.
+     * \param threadPool The pool to split wide layers over. nullptr runs everything on the calling thread.
+     * \param optimizer How the weights follow their changes, see optimizerState.
+     * \param memory Where the weights, biases and optimizer state come from.
+     */
+    NetworkLayer(const LayerInfo& layerInfo, const LayerInfo* inputLayer, unsigned int seed, ThreadPool* threadPool,
+        const OptimizerInfo& optimizer = OptimizerInfo(), std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    /**
+     * \brief Copy other's weights, biases and optimizer state into new buffers from memory.
+     */
+    NetworkLayer(const NetworkLayer& other, std::pmr::memory_resource* memory);
+
+    /**
+     * \return How many bytes the constructor takes from an Arena, for the same arguments.
+     */
+    static size_t memoryBytes(const LayerInfo& layerInfo, const LayerInfo* inputLayer, const OptimizerInfo& optimizer);
+
+    /**
+     * \brief Size every buffer a batch of batchSize samples needs in this layer's state: the batch buffers, and the
+     * im2col matrix and its gradients or the pool indices. The images buffers are sized for at least one sample,
+     * the single-sample passes use them too.
+     */
+    void reserveBatch(LayerState<Scalar>& state, size_t batchSize) const;
+
+    /**
+     * \return How many bytes reserveBatch takes from an Arena for batchSize samples.
+     */
+    size_t batchMemoryBytes(size_t batchSize) const;
+
+    /**
+     * \brief Processes the output from the previous layer and calculates the output
+     * for every neuron in this layer. Uses the sparse kernels if the previous state is marked sparse.
+     * \param previous The state of the previous layer in the network (i-1)
+     * \param state The state of this layer, receives the outputs.
+     */
+    void feedForward(const LayerState<Scalar>& previous, LayerState<Scalar>& state) const;
+
+    /**
+     * \brief Calculate the error deltas and gradients for this layer if it's the output layer, and the loss in the same pass.
+     * \param state The state of this layer, holding the outputs from the last feedForward.
+     * \param targetOutput The target output for each neuron in the layer.
+     * \return The loss: the cross-entropy for a Softmax layer, the mean squared error (MSE) otherwise.
+     */
+    double calculateOutputGradients(LayerState<Scalar>& state, const Scalar* targetOutput) const;
+
+    /**
+     * \brief Calculate the error gradients for this layer if it's a hidden layer.
+     * Uses the error gradients of the neurons in the next layer.
+     * \param layerToTheRight The next layer in the network (i+1)
+     * \param stateToTheRight The state of the next layer, holding its error gradients. Conv2D layers use its scratch buffers.
+     * \param state The state of this layer, receives the error gradients.
+     */
+    void calculateHiddenGradients(const NetworkLayer& layerToTheRight, LayerState<Scalar>& stateToTheRight, LayerState<Scalar>& state) const;
+
+    /**
+     * \brief Adjust the weights of every neuron in this layer. With an optimizer other than SGD, the changes are only
+     * collected, and step applies them.
+     * \param previous The state of the previous layer in the network (i-1)
+     * \param state The state of this layer, holding the error gradients.
+     * \param isOutputLayer The output layer scales the weight change by the error delta
+     * instead of the error gradient.
+     */
+    void updateWeights(const LayerState<Scalar>& previous, const LayerState<Scalar>& state, bool isOutputLayer);
+    void updateBiases(const LayerState<Scalar>& state);
+
+    /**
+     * \brief Mini-batch version of feedForward. Pushes every sample in the batch through the layer
+     * as one matrix-matrix product, writing one row per sample into batchOutputs.
+     * \param previous The state of the previous layer (i-1), with its batchOutputs filled in.
+     * \param state The state of this layer, receives the batch outputs.
+     * \param batchSize The number of samples in the batch.
+     */
+    void feedForwardBatch(const LayerState<Scalar>& previous, LayerState<Scalar>& state, size_t batchSize) const;
+
+    /**
+     * \brief Mini-batch version of calculateOutputGradients.
+     * \param state The state of this layer, holding the batch outputs.
+     * \param targetOutputs batchSize x numNeurons targets, one row per sample. Can be state.batchErrorDeltas itself,
+     * the deltas then overwrite the targets.
+     * \param batchSize The number of samples in the batch.
+     * \return The loss of every sample in the batch, summed.
+     */
+    double calculateOutputGradientsBatch(LayerState<Scalar>& state, const Scalar* targetOutputs, size_t batchSize) const;
+
+    /**
+     * \brief Mini-batch version of calculateHiddenGradients.
+     */
+    void calculateHiddenGradientsBatch(const NetworkLayer& layerToTheRight, LayerState<Scalar>& stateToTheRight,
+        LayerState<Scalar>& state, size_t batchSize) const;
+
+    /**
+     * \brief Apply the weight and bias changes accumulated over the whole batch as one update.
+     * The change is averaged over the batch, so the learning rate means the same as for single samples.
+     */
+    void updateWeightsBatch(const LayerState<Scalar>& previous, const LayerState<Scalar>& state, bool isOutputLayer, size_t batchSize);
+
+    /**
+     * \brief Accumulate the weight and bias changes from a batch into the neurons [firstNeuron, lastNeuron),
+     * or the filters of a Conv2D layer. Several threads can update disjoint ranges of the same layer at the same time.
+     * Only collects the changes with an optimizer other than SGD, see stepRange.
+     * \param rate What to scale the summed changes by, usually changeScale() / total batch size.
+     */
+    void updateWeightsBatchRange(const LayerState<Scalar>& previous, const LayerState<Scalar>& state, bool isOutputLayer,
+        size_t batchSize, Scalar rate, size_t firstNeuron, size_t lastNeuron);
+
+    /**
+     * \brief Apply the changes collected by updateWeights and updateBiases with the layer's optimizer, and clear them.
+     * Does nothing for SGD, which changes the weights right away.
+     */
+    void step();
+
+    /**
+     * \brief step for the rows [firstRow, lastRow) of the weights and their biases only. Several threads can step
+     * disjoint ranges of the same layer at the same time, after one countStep for the whole layer.
+     */
+    void stepRange(size_t firstRow, size_t lastRow);
+    void countStep() { optimizerSteps++; }
+
+    /**
+     * \return What the changes are scaled by before they are collected: the learning rate for SGD, which adds them
+     * straight to the weights, and 1 for the other optimizers, which apply the learning rate in the step.
+     */
+    Scalar changeScale() const { return optimizer.type == SGD ? learningRate : Scalar(1); }
+
+    size_t size() const { return numNeurons; }
+
+    /**
+     * \return The number of rows in weights and of biases: the neurons of a dense layer, the filters of a Conv2D layer.
+     */
+    size_t numWeightRows() const { return biases.size(); }
+    size_t weightRowSize() const { return type == Conv2D ? geometry.patchSize() : numInputs; }
+
+    Scalar* weightRow(size_t row) { return weights.data() + row * weightRowSize(); }
+    const Scalar* weightRow(size_t row) const { return weights.data() + row * weightRowSize(); }
+
+    /**
+     * \return How many multiply-adds the forward pass costs per sample, or comparisons for MaxPool.
+     * The backward pass costs twice that, once for the gradients and once for the weights.
+     */
+    double multiplyAdds() const;
+
+    LayerType type;
+
+    size_t numNeurons;
+    size_t numInputs;
+
+    // Conv2D and MaxPool: the input and output images and the filters or windows
+    Convolution::Geometry geometry;
+
+    // Learning rate for every neuron in the layer
+    Scalar learningRate;
+    ActiviationFunction activationFunction;
+
+    // numNeurons x numInputs, row-major. Row n holds the input weights of neuron n.
+    // For Conv2D, filters x patchSize: row f holds filter f, in the order of the im2col windows.
+    std::pmr::vector<Scalar> weights;
+    std::pmr::vector<Scalar> biases;
+
+    OptimizerInfo optimizer;
+
+    // Everything the optimizer keeps per weight and bias, in one block of optimizer.stateSize() sections. Each section
+    // holds one value per weight, in the same order as weights, and then one per bias:
+    //   the changes collected since the last step, the velocity (Momentum, Nesterov) or the running average of
+    //   the changes (Adam, AdamW), and the running average of their squares (Adam, AdamW).
+    // Empty for SGD.
+    std::pmr::vector<Scalar> optimizerState;
+
+    // How many steps the optimizer has taken, for Adam's bias correction
+    uint64_t optimizerSteps = 0;
+
+    // Where the chunks of wide layers run. nullptr runs everything on the calling thread.
+    ThreadPool* threadPool;
+
+protected:
+    // Where the changes go: straight into the weights and biases for SGD, into the first section of optimizerState otherwise
+    Scalar* weightChanges() { return optimizer.type == SGD ? weights.data() : optimizerState.data(); }
+    Scalar* biasChanges() { return optimizer.type == SGD ? biases.data() : optimizerState.data() + weights.size(); }
+
+    /**
+     * \brief feedForward and feedForwardBatch for Conv2D and MaxPool layers.
+     * \param inputs batchSize input images.
+     * \param outputs Receives batchSize output images.
+     */
+    void feedForwardImages(const Scalar* inputs, Scalar* outputs, LayerState<Scalar>& state, size_t batchSize) const;
+
+    /**
+     * \brief The gradients of the inputs of a Conv2D or MaxPool layer, from the gradients of its outputs.
+     * \param state The state of this layer, from the last forward pass. Conv2D uses its columnGradients.
+     * \param errorGradients batchSize x numNeurons output gradients.
+     * \param inputGradients Receives batchSize x numInputs input gradients.
+     */
+    void calculateInputGradients(LayerState<Scalar>& state, const Scalar* errorGradients, Scalar* inputGradients, size_t batchSize) const;
+
+    /**
+     * \brief Conv2D weight update of the filters [firstFilter, lastFilter), and their biases.
+     * \param inputs The input images of the last forward pass.
+     * \param state The state of this layer, holding the im2col matrix of the last forward pass.
+     * \param errorGradients batchSize x numNeurons output gradients.
+     */
+    void updateFilters(const Scalar* inputs, const LayerState<Scalar>& state, const Scalar* errorGradients, size_t batchSize,
+        Scalar rate, size_t firstFilter, size_t lastFilter);
 };
@@ -1,144 +1,504 @@
 ﻿#include "NeuralNetwork.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <random>
 
-NeuralNetwork::NeuralNetwork(const NNConstructionInfo& constructionInfo)
+namespace
 {
-    networkLayers.reserve(constructionInfo.topology.size());
-    for (size_t i = 0; i < constructionInfo.topology.size(); i++)
+    // Default for setSparseInputThreshold. Above roughly a third non-zero, the gathers of the sparse kernels
+    // cost more than streaming over the zeros. MNIST digits are about a fifth non-zero.
+    constexpr double SPARSE_INPUT_THRESHOLD = 0.3;
+
+    // Nominal cost of one pass over a layer's weights for batchSize samples, for the profiler
+    template <typename Scalar>
+    double layerFlops(const NetworkLayer<Scalar>& layer, size_t batchSize)
+    {
+        return 2.0 * layer.multiplyAdds() * (double)batchSize;
+    }
+
+    template <typename Scalar>
+    double layerBytes(const NetworkLayer<Scalar>& layer, size_t batchSize, bool writesWeights)
     {
-        // Input layer shouldn't have any weights, so set numInputs to 0
+        return (double)sizeof(Scalar) * ((writesWeights ? 2.0 : 1.0) * (double)layer.weights.size()
+            + (double)(layer.numNeurons + layer.numInputs) * (double)batchSize);
+    }
+
+    /**
+     * Fill in the image size and the number of neurons of every Conv2D and MaxPool layer, from the layer before it.
+     * Other layers are 1 x 1 x numNeurons images, unless the input layer is an image.
+     */
+    std::vector<LayerInfo> resolveImageSizes(const std::vector<LayerInfo>& topology)
+    {
+        std::vector<LayerInfo> resolved = topology;
+        for (size_t i = 0; i < resolved.size(); i++)
+        {
+            LayerInfo& layer = resolved[i];
+            if (i == 0 || layer.type == Dense)
+            {
+                if (i > 0 || layer.channels == 0)
+                {
+                    layer.height = layer.width = 1;
+                    layer.channels = layer.numNeurons;
+                }
+                continue;
+            }
+
+            const LayerInfo& input = resolved[i - 1];
+            const size_t paddedHeight = input.height + 2 * layer.padding;
+            const size_t paddedWidth = input.width + 2 * layer.padding;
+            if (layer.kernelSize == 0 || layer.stride == 0 || layer.kernelSize > paddedHeight || layer.kernelSize > paddedWidth)
+            {
+                std::cerr << "BasicNeuralNetwork: The windows of layer " << i << " don't fit in its " << input.height << " x " << input.width
+                    << " input, the layer has no outputs.\n";
+                layer.height = layer.width = 0;
+            }
+            else
+            {
+                layer.height = (paddedHeight - layer.kernelSize) / layer.stride + 1;
+                layer.width = (paddedWidth - layer.kernelSize) / layer.stride + 1;
+            }
+
+            if (layer.type == MaxPool)
+                layer.channels = input.channels;
+            layer.numNeurons = layer.height * layer.width * layer.channels;
+        }
+        return resolved;
+    }
+}
+
+template <typename Scalar>
+BasicNeuralNetwork<Scalar>::BasicNeuralNetwork(const NNConstructionInfo& constructionInfo)
+    : sparseInputThreshold(SPARSE_INPUT_THRESHOLD)
+{
+    const unsigned int seed = constructionInfo.seed != 0 ? constructionInfo.seed : std::random_device()();
+
+    const std::vector<LayerInfo> topology = resolveImageSizes(constructionInfo.topology);
+
+    if (constructionInfo.useArena)
+    {
+        // Everything the layers and their states keep for the network's lifetime fits in the first block
+        size_t bytes = 0;
+        for (size_t i = 0; i < topology.size(); i++)
+        {
+            bytes += NetworkLayer<Scalar>::memoryBytes(topology[i], i == 0 ? nullptr : &topology[i - 1], constructionInfo.optimizer);
+            bytes += LayerState<Scalar>::memoryBytes(topology[i].numNeurons);
+        }
+        memory = std::make_unique<Arena>(bytes, constructionInfo.hugePages);
+
+        // Sized by reserveBatch
+        batchMemory = std::make_unique<Arena>(0, constructionInfo.hugePages);
+    }
+
+    networkLayers.reserve(topology.size());
+    for (size_t i = 0; i < topology.size(); i++)
+    {
+        // Softmax is trained together with the cross-entropy loss, which only the output layer has
+        if (topology[i].activationFunction == Softmax && i + 1 < topology.size())
+            std::cerr << "BasicNeuralNetwork: Softmax is only supported in the output layer, layer " << i << " won't train correctly.\n";
+
+        // The loss is calculated on dense outputs only
+        if (topology[i].type != Dense && i + 1 == topology.size())
+            std::cerr << "BasicNeuralNetwork: The output layer has to be Dense, the network won't train correctly.\n";
+
+        // Give every layer its own seed derived from the network's, so layers don't repeat each other
+        std::seed_seq layerSeed{ seed, (unsigned int)i };
+        unsigned int layerSeedValue;
+        layerSeed.generate(&layerSeedValue, &layerSeedValue + 1);
+
+        // Input layer shouldn't have any weights, so it has no inputs
         networkLayers.emplace_back(
-            constructionInfo.topology[i],
-            i == 0 ? 0 : constructionInfo.topology[i - 1].numNeurons);
+            topology[i],
+            i == 0 ? nullptr : &topology[i - 1],
+            layerSeedValue,
+            &ThreadPool::global(),
+            constructionInfo.optimizer,
+            memoryResource());
     }
+
+    layerStates.reserve(networkLayers.size());
+    for (const NetworkLayer<Scalar>& layer : networkLayers)
+        layerStates.emplace_back(layer.size(), memoryResource(), batchMemoryResource());
+
+    // The single-sample passes of Conv2D and MaxPool layers use the batch buffers too
+    reserveBatch(std::max<size_t>(1, constructionInfo.maxBatchSize));
+}
+
+template <typename Scalar>
+BasicNeuralNetwork<Scalar>::BasicNeuralNetwork(const BasicNeuralNetwork& other)
+    : sparseInputThreshold(other.sparseInputThreshold),
+      reservedBatchSize(other.reservedBatchSize)
+{
+    if (other.memory != nullptr)
+    {
+        // The copies are packed tighter than other's buffers, give or take the alignment of every block
+        memory = std::make_unique<Arena>(other.memory->bytesUsed() + other.memory->blockCount() * Arena::ALIGNMENT,
+            other.memory->hugePagesRequested());
+        batchMemory = std::make_unique<Arena>(other.batchMemory->bytesUsed() + other.batchMemory->blockCount() * Arena::ALIGNMENT,
+            other.batchMemory->hugePagesRequested());
+    }
+
+    networkLayers.reserve(other.networkLayers.size());
+    for (const NetworkLayer<Scalar>& layer : other.networkLayers)
+        networkLayers.emplace_back(layer, memoryResource());
+
+    layerStates.reserve(other.layerStates.size());
+    for (const LayerState<Scalar>& state : other.layerStates)
+        layerStates.emplace_back(state, memoryResource(), batchMemoryResource());
 }
 
-std::vector<double> NeuralNetwork::forwardPropagate(const std::vector<double>& input)
+template <typename Scalar>
+BasicNeuralNetwork<Scalar>& BasicNeuralNetwork<Scalar>::operator=(const BasicNeuralNetwork& other)
+{
+    if (this == &other)
+        return *this;
+
+    bool sameShape = networkLayers.size() == other.networkLayers.size() && reservedBatchSize == other.reservedBatchSize;
+    for (size_t i = 0; i < networkLayers.size() && sameShape; i++)
+    {
+        sameShape = networkLayers[i].size() == other.networkLayers[i].size()
+            && networkLayers[i].weights.size() == other.networkLayers[i].weights.size()
+            && networkLayers[i].optimizerState.size() == other.networkLayers[i].optimizerState.size();
+    }
+
+    // Anything else would grow the arenas with every assignment
+    if (!sameShape)
+        return *this = BasicNeuralNetwork(other);
+
+    for (size_t i = 0; i < networkLayers.size(); i++)
+    {
+        networkLayers[i] = other.networkLayers[i];
+        layerStates[i] = other.layerStates[i];
+    }
+    sparseInputThreshold = other.sparseInputThreshold;
+    return *this;
+}
+
+template <typename Scalar>
+BasicNeuralNetwork<Scalar>& BasicNeuralNetwork<Scalar>::operator=(BasicNeuralNetwork&& other) noexcept
+{
+    // The buffers have to go before the arenas they live in
+    networkLayers = std::move(other.networkLayers);
+    layerStates = std::move(other.layerStates);
+    memory = std::move(other.memory);
+    batchMemory = std::move(other.batchMemory);
+    sparseInputThreshold = other.sparseInputThreshold;
+    reservedBatchSize = other.reservedBatchSize;
+    return *this;
+}
+
+template <typename Scalar>
+std::pmr::memory_resource* BasicNeuralNetwork<Scalar>::memoryResource() const
+{
+    return memory != nullptr ? memory.get() : std::pmr::get_default_resource();
+}
+
+template <typename Scalar>
+std::pmr::memory_resource* BasicNeuralNetwork<Scalar>::batchMemoryResource() const
+{
+    return batchMemory != nullptr ? batchMemory.get() : std::pmr::get_default_resource();
+}
+
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::reserveBatch(size_t batchSize)
+{
+    if (batchSize <= reservedBatchSize)
+        return;
+
+    if (batchMemory != nullptr)
+    {
+        for (LayerState<Scalar>& state : layerStates)
+            state.releaseBatch();
+
+        size_t bytes = 0;
+        for (const NetworkLayer<Scalar>& layer : networkLayers)
+            bytes += layer.batchMemoryBytes(batchSize);
+        batchMemory->reset(bytes);
+    }
+
+    for (size_t i = 0; i < networkLayers.size(); i++)
+        networkLayers[i].reserveBatch(layerStates[i], batchSize);
+    reservedBatchSize = batchSize;
+}
+
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::setThreadPool(ThreadPool* threadPool)
+{
+    for (NetworkLayer<Scalar>& layer : networkLayers)
+        layer.threadPool = threadPool;
+}
+
+template <typename Scalar>
+std::vector<LayerState<Scalar>> BasicNeuralNetwork<Scalar>::createLayerStates(std::pmr::memory_resource* memory) const
+{
+    std::vector<LayerState<Scalar>> states;
+    states.reserve(networkLayers.size());
+    for (const NetworkLayer<Scalar>& layer : networkLayers)
+        states.emplace_back(layer.size(), memory);
+    return states;
+}
+
+template <typename Scalar>
+std::vector<Scalar> BasicNeuralNetwork<Scalar>::forwardPropagate(const std::vector<Scalar>& input)
 {
     // Input size does not match the number of inputs for the network
-    assert(input.size() == networkLayers[0].neurons.size());
-    
+    assert(input.size() == inputSize());
+
+    std::vector<Scalar> output(outputSize());
+    forwardPropagate(input.data(), output.data());
+    return output;
+}
+
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::forwardPropagate(const Scalar* input, Scalar* output)
+{
+    forwardPass(layerStates, input);
+
+    // Forward propagation is done, the output layer now contains the output from the network
+    std::copy(layerStates.back().outputs.begin(), layerStates.back().outputs.end(), output);
+}
+
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::predict(const Scalar* input, Scalar* output, std::vector<LayerState<Scalar>>& states) const
+{
+    // The states don't belong to this network
+    assert(states.size() == networkLayers.size());
+
+    forwardPass(states, input);
+    std::copy(states.back().outputs.begin(), states.back().outputs.end(), output);
+}
+
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::forwardPass(std::vector<LayerState<Scalar>>& states, const Scalar* input) const
+{
     // The input layer is just there as a container for the input data, we don't need
     // to calculate any output for it (just take it directly)
 
     // Initialize the input layer with the input data
-    for (size_t i = 0; i < input.size(); i++)
-        networkLayers[0].neurons[i].output = input[i];
+    std::copy(input, input + inputSize(), states[0].outputs.begin());
+    if (sparseInputThreshold > 0.0)
+        states[0].updateSparsity(sparseInputThreshold);
+    else
+        states[0].sparse = false;
     
     // Forward propagate
     for (size_t i = 1; i < networkLayers.size(); i++) // Skip input layer
     {
-        for (auto& neuron : networkLayers[i].neurons)
-            neuron.feedForward(networkLayers[i - 1].neurons); // Send the output from the previous layer
+        NN_PROFILE_LAYER(Profiler::Forward, i, layerFlops(networkLayers[i], 1), layerBytes(networkLayers[i], 1, false));
+        networkLayers[i].feedForward(states[i - 1], states[i]); // Send the output from the previous layer
     }
-    
-    // Forward propagation is done, the output layer now contains the output from the network
-
-    // Return the output layer neurons' output
-    std::vector<Neuron> outputLayer = networkLayers.back().neurons;
-    
-    std::vector<double> output;
-    output.reserve(outputLayer.size());
+}
 
-    for (const Neuron& neuron : outputLayer)
-        output.emplace_back(neuron.output);
-    
-    //std::cout << "NeuralNetwork: Forward propagation done.\n";
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::predictBatch(const Scalar* inputs, size_t count, Scalar* outputs)
+{
+    // A single sample is faster through the matrix-vector kernels
+    if (count == 1)
+    {
+        forwardPropagate(inputs, outputs);
+        return;
+    }
 
-    // Print neural network vizualization
-    /*std::cout << "NeuralNetwork: Neural network visualization:\n";
-    for (size_t i = 0; i < networkLayers.size(); i++)
+    reserveBatch(std::min(MAX_PREDICT_BATCH, count));
+    for (size_t first = 0; first < count; first += MAX_PREDICT_BATCH)
     {
-        std::cout << "Layer " << i << ":\n";
-        for (size_t k = 0; k < networkLayers[i].neurons.size(); k++)
+        const size_t batchSize = std::min(MAX_PREDICT_BATCH, count - first);
+
+        std::copy(inputs + first * inputSize(), inputs + (first + batchSize) * inputSize(), layerStates[0].batchOutputs.begin());
+
+        for (size_t i = 1; i < networkLayers.size(); i++)
         {
-            std::cout << "  Neuron " << k << ":\n";
-            std::cout << "    Output: " << networkLayers[i].neurons[k].output << "\n";
-            std::cout << "    Bias: " << networkLayers[i].neurons[k].bias << "\n";
-            std::cout << "    ErrGrad: " << networkLayers[i].neurons[k].errorGradient << "\n";
-            std::cout << "    Weights:\n";
-            for (size_t j = 0; j < networkLayers[i].neurons[k].weights.size(); j++)
-            {
-                std::cout << "      " << networkLayers[i].neurons[k].weights[j] << "\n";
-            }
-            if (i == networkLayers.size() - 1)
-            {
-                std::cout << "    Error difference: " << networkLayers[i].neurons[k].errorDelta << "\n";
-            }
+            NN_PROFILE_LAYER(Profiler::Forward, i, layerFlops(networkLayers[i], batchSize), layerBytes(networkLayers[i], batchSize, false));
+            networkLayers[i].feedForwardBatch(layerStates[i - 1], layerStates[i], batchSize);
         }
-    }*/
-    
-    return output;
+
+        const std::pmr::vector<Scalar>& batchOutputs = layerStates.back().batchOutputs;
+        std::copy(batchOutputs.begin(), batchOutputs.begin() + batchSize * outputSize(), outputs + first * outputSize());
+    }
 }
 
-double NeuralNetwork::backPropagate(const std::vector<double>& input, const std::vector<double>& targetOutput)
+template <typename Scalar>
+std::vector<Scalar> BasicNeuralNetwork<Scalar>::predictBatch(const std::vector<Scalar>& inputs)
 {
-    // Calculate overall error (MSE - mean squared error)
-    NetworkLayer& outputLayer = networkLayers.back();
-    double errorSum = 0.0;
+    // Input size has to be a whole number of samples
+    assert(inputs.size() % inputSize() == 0);
 
-    // Sum up the error for each neuron in the output layer
-    for (size_t i = 0; i < outputLayer.neurons.size(); i++)
-    {
-        double neronDeltaError = targetOutput[i] - outputLayer.neurons[i].output;
-        outputLayer.neurons[i].errorDelta = neronDeltaError;
-        errorSum += neronDeltaError * neronDeltaError;
-    }
+    const size_t count = inputs.size() / inputSize();
+    std::vector<Scalar> outputs(count * outputSize());
+    predictBatch(inputs.data(), count, outputs.data());
+    return outputs;
+}
 
-    const double meanSquareError = errorSum/(double)outputLayer.neurons.size();
-    
-    // Calculate output layer gradients (different function for output layer)
-    for (size_t i = 0; i < outputLayer.neurons.size() - 1; i++)
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::backPropagate(const std::vector<Scalar>& input, const std::vector<Scalar>& targetOutput)
+{
+    // Target size does not match the number of outputs for the network
+    assert(targetOutput.size() == outputSize());
+
+    return backwardPass(layerStates, targetOutput.data());
+}
+
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::backwardPass(std::vector<LayerState<Scalar>>& states, const Scalar* targetOutput)
+{
+    NetworkLayer<Scalar>& outputLayer = networkLayers.back();
+    LayerState<Scalar>& outputState = states.back();
+    const size_t outputIndex = networkLayers.size() - 1;
+
+    // Calculate the error for every neuron in the output layer, and the overall loss
+    // (MSE - mean squared error, or the cross-entropy for softmax) along with it
+    double loss;
     {
-        outputLayer.neurons[i].calculateOutputGradient(targetOutput[i]);
+        NN_PROFILE_LAYER(Profiler::Gradients, outputIndex, 3.0 * (double)outputSize(), 3.0 * (double)(outputSize() * sizeof(Scalar)));
+        loss = outputLayer.calculateOutputGradients(outputState, targetOutput);
     }
 
     // Calculate hidden layer gradients
     for (size_t i = networkLayers.size() - 2; i > 0; i--)
     {
-        NetworkLayer& thisLayer = networkLayers[i];
-        NetworkLayer& layerToTheRight = networkLayers[i + 1];
-
-        for (size_t k = 0; k < thisLayer.neurons.size(); k++)
-        {
-            thisLayer.neurons[k].calculateHiddenGradient(layerToTheRight, k);
-        }
+        NN_PROFILE_LAYER(Profiler::Gradients, i, layerFlops(networkLayers[i + 1], 1), layerBytes(networkLayers[i + 1], 1, false));
+        networkLayers[i].calculateHiddenGradients(networkLayers[i + 1], states[i + 1], states[i]);
     }
 
     // All error gradients have been calculated, now we need to update the weights and biases
     
     // Update output layer weights and biases
-    for (auto& neuron : outputLayer.neurons)
+    // Send the previous layer
     {
-        // Send the neurons from the previous layer
-        neuron.updateWeights(networkLayers[networkLayers.size() - 2].neurons, true);
-        neuron.updateBias();
+        NN_PROFILE_LAYER(Profiler::Update, outputIndex, layerFlops(outputLayer, 1), layerBytes(outputLayer, 1, true));
+        outputLayer.updateWeights(states[states.size() - 2], outputState, true);
+        outputLayer.updateBiases(outputState);
+        outputLayer.step();
     }
 
     // Update weights and biases for hidden layers
     for (size_t i = networkLayers.size() - 2; i > 0; i--)
     {
-        NetworkLayer& layer = networkLayers[i];
-        
-        for (auto& neuron : layer.neurons)
-        {
-            // Send the neurons from the previous layer
-            neuron.updateWeights(networkLayers[i-1].neurons, false);
-            neuron.updateBias();
-        }
+        NN_PROFILE_LAYER(Profiler::Update, i, layerFlops(networkLayers[i], 1), layerBytes(networkLayers[i], 1, true));
+        networkLayers[i].updateWeights(states[i - 1], states[i], false);
+        networkLayers[i].updateBiases(states[i]);
+        networkLayers[i].step();
     }
     
-    return meanSquareError;
+    return loss;
 }
 
-double NeuralNetwork::train(const std::vector<std::vector<double>>& trainingData, const std::vector<std::vector<double>>& targetOutput)
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput)
 {
-    double MSE = 0.0;
+    double loss = 0.0;
     for (size_t i = 0; i < trainingData.size(); i++)
     {
-        forwardPropagate(trainingData[i]);
-        MSE = backPropagate(trainingData[i], targetOutput[i]);
+        // Input size does not match the number of inputs for the network
+        assert(trainingData[i].size() == inputSize());
+
+        // Straight into layerStates, forwardPropagate would return a new vector for every sample
+        forwardPass(layerStates, trainingData[i].data());
+        loss = backPropagate(trainingData[i], targetOutput[i]);
     }
-    return MSE;
+    return loss;
 }
+
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::trainBatch(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput, size_t batchSize)
+{
+    assert(batchSize > 0);
+    assert(trainingData.size() == targetOutput.size());
+
+    double loss = 0.0;
+
+    reserveBatch(std::min(batchSize, trainingData.size()));
+    for (size_t first = 0; first < trainingData.size(); first += batchSize)
+    {
+        const size_t count = std::min(batchSize, trainingData.size() - first);
+
+        // Calculate the gradients for every layer before touching any weights, same as backPropagate
+        loss = calculateBatchGradients(layerStates, trainingData, targetOutput, first, count) / (double)count;
+
+        // One update per batch
+        updateWeightsBatch(count);
+    }
+
+    return loss;
+}
+
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::trainBatch(const Scalar* inputs, const Scalar* targetOutputs, size_t batchSize)
+{
+    assert(batchSize > 0);
+
+    reserveBatch(batchSize);
+    std::copy(inputs, inputs + batchSize * inputSize(), layerStates.front().batchOutputs.begin());
+    std::copy(targetOutputs, targetOutputs + batchSize * outputSize(), layerStates.back().batchErrorDeltas.begin());
+
+    const double lossSum = calculateBatchGradients(layerStates, batchSize);
+    updateWeightsBatch(batchSize);
+
+    return lossSum / (double)batchSize;
+}
+
+template <typename Scalar>
+void BasicNeuralNetwork<Scalar>::updateWeightsBatch(size_t batchSize)
+{
+    for (size_t i = networkLayers.size() - 1; i > 0; i--)
+    {
+        NN_PROFILE_LAYER(Profiler::Update, i, layerFlops(networkLayers[i], batchSize), layerBytes(networkLayers[i], batchSize, true));
+        networkLayers[i].updateWeightsBatch(layerStates[i - 1], layerStates[i], i == networkLayers.size() - 1, batchSize);
+    }
+}
+
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::calculateBatchGradients(std::vector<LayerState<Scalar>>& states, const std::vector<std::vector<Scalar>>& trainingData,
+    const std::vector<std::vector<Scalar>>& targetOutput, size_t firstSample, size_t batchSize) const
+{
+    // Copy the batch into the input layer and the targets into the output layer, one row per sample
+    states.front().reserveBatch(batchSize);
+    states.back().reserveBatch(batchSize);
+    for (size_t b = 0; b < batchSize; b++)
+    {
+        // Input size does not match the number of inputs for the network
+        assert(trainingData[firstSample + b].size() == inputSize());
+        assert(targetOutput[firstSample + b].size() == outputSize());
+        std::copy(trainingData[firstSample + b].begin(), trainingData[firstSample + b].end(),
+            states.front().batchOutputs.begin() + b * inputSize());
+        std::copy(targetOutput[firstSample + b].begin(), targetOutput[firstSample + b].end(),
+            states.back().batchErrorDeltas.begin() + b * outputSize());
+    }
+
+    return calculateBatchGradients(states, batchSize);
+}
+
+template <typename Scalar>
+double BasicNeuralNetwork<Scalar>::calculateBatchGradients(std::vector<LayerState<Scalar>>& states, size_t batchSize) const
+{
+    const NetworkLayer<Scalar>& outputLayer = networkLayers.back();
+
+    // Forward propagate the whole batch
+    for (size_t i = 1; i < networkLayers.size(); i++)
+    {
+        NN_PROFILE_LAYER(Profiler::Forward, i, layerFlops(networkLayers[i], batchSize), layerBytes(networkLayers[i], batchSize, false));
+        networkLayers[i].feedForwardBatch(states[i - 1], states[i], batchSize);
+    }
+
+    // The targets are in batchErrorDeltas, and get replaced by the deltas
+    LayerState<Scalar>& outputState = states.back();
+    double lossSum;
+    {
+        NN_PROFILE_LAYER(Profiler::Gradients, networkLayers.size() - 1, 3.0 * (double)(outputSize() * batchSize),
+            3.0 * (double)(outputSize() * batchSize * sizeof(Scalar)));
+        lossSum = outputLayer.calculateOutputGradientsBatch(outputState, outputState.batchErrorDeltas.data(), batchSize);
+    }
+
+    for (size_t i = networkLayers.size() - 2; i > 0; i--)
+    {
+        NN_PROFILE_LAYER(Profiler::Gradients, i, layerFlops(networkLayers[i + 1], batchSize), layerBytes(networkLayers[i + 1], batchSize, false));
+        networkLayers[i].calculateHiddenGradientsBatch(networkLayers[i + 1], states[i + 1], states[i], batchSize);
+    }
+
+    return lossSum;
+}
+
+template class BasicNeuralNetwork<float>;
+template class BasicNeuralNetwork<double>;
@@ -1,18 +1,46 @@
 ﻿#pragma once
 
+#include <memory>
 #include <vector>
 #include "ActivationFunction.h"
+#include "Arena.h"
 #include "NetworkLayer.h"
 
 struct LayerInfo;
+class Checkpoint;
+template <typename Scalar>
+class DataParallelTrainer;
+template <typename Scalar>
+class HogwildTrainer;
+template <typename Scalar>
+class MagnitudePruner;
+
 /**
  * \brief A complete neural network with a number of layers, each containing a number of neurons.
  * Has the ability to predict outputs and adjust weights and biases through training.
+ * \tparam Scalar The floating point type of the weights, activations and data, float or double.
+ * Use the NeuralNetwork (double) and NeuralNetworkFloat aliases.
+ * The weights, biases, optimizer state and activations of every layer live in one Arena sized up front, and the batch
+ * buffers in a second one (see NNConstructionInfo::useArena), so training doesn't allocate once the batch buffers fit
+ * the largest batch.
  */
-class NeuralNetwork
+template <typename Scalar>
+class BasicNeuralNetwork
 {
 public:
-    NeuralNetwork(const NNConstructionInfo& constructionInfo);
+    BasicNeuralNetwork(const NNConstructionInfo& constructionInfo);
+
+    /**
+     * \brief Copies the network into arenas of its own.
+     */
+    BasicNeuralNetwork(const BasicNeuralNetwork& other);
+    BasicNeuralNetwork(BasicNeuralNetwork&& other) = default;
+
+    /**
+     * \brief Copies into the existing buffers when other has the same topology and batch size, which doesn't allocate.
+     */
+    BasicNeuralNetwork& operator=(const BasicNeuralNetwork& other);
+    BasicNeuralNetwork& operator=(BasicNeuralNetwork&& other) noexcept;
 
     /**
      * \brief Process the input data through the network. This is the same as
@@ -20,16 +48,25 @@ public:
      * \param input The input data to process
      * \return A vector containing the output from each output layer neuron in the network
      */
-    std::vector<double> forwardPropagate(const std::vector<double>& input);
+    std::vector<Scalar> forwardPropagate(const std::vector<Scalar>& input);
+
+    /**
+     * \brief Same as forwardPropagate, but writes the output into a buffer owned by the caller.
+     * Doesn't allocate any memory.
+     * \param input inputSize() values to process.
+     * \param output Receives outputSize() values, one from each output layer neuron.
+     */
+    void forwardPropagate(const Scalar* input, Scalar* output);
 
     /**
      * \brief Calculate the error for the output layer and then backpropagate the error,
      * updating the weights and biases for each neuron in the network.
      * \param input The input data processed in the last forward propagation.
      * \param targetOutput The expected output for the given input data.
-     * \return The mean squared error (MSE) from the backpropagation.
+     * \return The loss from the backpropagation: the mean squared error (MSE), or the cross-entropy if the
+     * output layer uses Softmax.
      */
-    double backPropagate(const std::vector<double>& input, const std::vector<double>& targetOutput);
+    double backPropagate(const std::vector<Scalar>& input, const std::vector<Scalar>& targetOutput);
     
     /**
      * \brief Train by forward propagating and backpropagating the network as many times as there are inputs
@@ -38,20 +75,194 @@ public:
      * If you only have one input, use a vector with only one element.
      * \param targetOutput The expected output for each input in the trainingData vector.
      * If you only have one expected output, use a vector with only one element.
-     * \return The mean squared error (MSE) for the last backpropagation
+     * \return The loss (MSE or cross-entropy, see backPropagate) for the last backpropagation
      */
-    double train(const std::vector<std::vector<double>>& trainingData, const std::vector<std::vector<double>>& targetOutput);
+    double train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput);
+
+    /**
+     * \brief Train in mini-batches. Each batch is pushed through every layer as one matrix-matrix
+     * product, the weight and bias changes are accumulated (averaged) over the batch, and then applied
+     * as one update per batch. With a batch size of 1 this behaves the same as train.
+     * \param trainingData A vector containing a list of input data. Each input is a vector of input values.
+     * \param targetOutput The expected output for each input in the trainingData vector.
+     * \param batchSize How many samples to accumulate before updating the weights.
+     * The last batch is smaller if the number of samples isn't divisible by batchSize.
+     * \return The loss (MSE or cross-entropy, see backPropagate) averaged over every sample in the last batch.
+     */
+    double trainBatch(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput, size_t batchSize);
+
+    /**
+     * \brief Train on a single mini-batch stored as one contiguous block, with one update for the whole batch.
+     * \param inputs batchSize x inputSize() values, row-major, one row per sample.
+     * \param targetOutputs batchSize x outputSize() values, one row per sample.
+     * \param batchSize The number of samples in the batch.
+     * \return The loss (MSE or cross-entropy, see backPropagate) averaged over every sample in the batch.
+     */
+    double trainBatch(const Scalar* inputs, const Scalar* targetOutputs, size_t batchSize);
 
     /**
      * \brief Predict the output for a given input. Calls forwardPropagate.
      * \param input The input data to process.
      * \return A vector containing the output from each output layer neuron in the network.
      */
-    std::vector<double> predict(const std::vector<double>& input)
+    std::vector<Scalar> predict(const std::vector<Scalar>& input)
     {
         return forwardPropagate(input);
     }
 
+    /**
+     * \brief Predict into a buffer owned by the caller. Doesn't allocate any memory.
+     * \param input inputSize() values to process.
+     * \param output Receives outputSize() values.
+     */
+    void predict(const Scalar* input, Scalar* output)
+    {
+        forwardPropagate(input, output);
+    }
+
+    /**
+     * \brief Thread-safe predict. Only reads the network and keeps every activation in states, so any number of
+     * threads can predict at the same time, each with its own states. Training the same network at the same
+     * time isn't safe, use a ServingNetwork for that. Doesn't allocate any memory.
+     * \param input inputSize() values to process.
+     * \param output Receives outputSize() values.
+     * \param states Scratch buffers from createLayerStates.
+     */
+    void predict(const Scalar* input, Scalar* output, std::vector<LayerState<Scalar>>& states) const;
+
+    /**
+     * \brief Predict into a vector owned by the caller. Only allocates if output is smaller than outputSize(),
+     * so reusing the same vector makes every call after the first allocation-free.
+     */
+    void predict(const std::vector<Scalar>& input, std::vector<Scalar>& output)
+    {
+        output.resize(outputSize());
+        forwardPropagate(input.data(), output.data());
+    }
+
+    /**
+     * \brief Predict the outputs for a whole batch of samples. Every layer runs as a matrix-matrix
+     * product over the batch, so each weight is loaded once per batch instead of once per sample.
+     * Large batches are split over the thread pool.
+     * \param inputs count x inputSize() values, row-major, one row per sample.
+     * \param count The number of samples.
+     * \param outputs Receives count x outputSize() values, one row per sample.
+     */
+    void predictBatch(const Scalar* inputs, size_t count, Scalar* outputs);
+
+    // predictBatch pushes at most this many samples through the network at a time. Bounds the memory
+    // of the batch buffers for huge inputs, and big enough that the weights are well reused.
+    static constexpr size_t MAX_PREDICT_BATCH = 256;
+
+    /**
+     * \param inputs N x inputSize() values, row-major, one row per sample.
+     * \return N x outputSize() values, one row per sample.
+     */
+    std::vector<Scalar> predictBatch(const std::vector<Scalar>& inputs);
+
+    size_t inputSize() const { return networkLayers.front().size(); }
+    size_t outputSize() const { return networkLayers.back().size(); }
+
+    /**
+     * \brief Make a fresh set of activation and gradient buffers, one LayerState per layer.
+     * Forward and backward passes that use their own states can run at the same time.
+     * \param memory Where the buffers come from, e.g. an Arena of the caller's. Has to outlive the states.
+     */
+    std::vector<LayerState<Scalar>> createLayerStates(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const;
+
+    /**
+     * \return The arena holding the layers and layerStates, and the one holding the batch buffers.
+     * nullptr without NNConstructionInfo::useArena.
+     */
+    const Arena* memoryArena() const { return memory.get(); }
+    const Arena* batchArena() const { return batchMemory.get(); }
+
+    /**
+     * \return Every layer in the network, the input layer first.
+     */
+    const std::vector<NetworkLayer<Scalar>>& layers() const { return networkLayers; }
+
+    /**
+     * \brief Inputs with at most this fraction of non-zero values go through the first hidden layer with
+     * sparse kernels, which skip the zeros in the forward pass and the weight update. Only the single-sample
+     * passes (predict, forwardPropagate, backPropagate and train) use it.
+     * \param maxDensity Between 0 and 1. 0 always uses the dense kernels.
+     */
+    void setSparseInputThreshold(double maxDensity) { sparseInputThreshold = maxDensity; }
+
+    /**
+     * \brief Choose the pool that wide layers split their work over. ThreadPool::global() by default.
+     * \param threadPool The pool to use, or nullptr to run every layer on the calling thread.
+     */
+    void setThreadPool(ThreadPool* threadPool);
+
 protected:
-    std::vector<NetworkLayer> networkLayers;
+    friend class DataParallelTrainer<Scalar>;
+    friend class HogwildTrainer<Scalar>;
+    friend class Checkpoint;
+    friend class MagnitudePruner<Scalar>;
+
+    /**
+     * \brief forwardPropagate into the given states instead of layerStates. Only reads the network, so it can
+     * run on several threads with separate states.
+     * \param states The buffers to use, from createLayerStates. The output ends up in states.back().outputs.
+     */
+    void forwardPass(std::vector<LayerState<Scalar>>& states, const Scalar* input) const;
+
+    /**
+     * \brief backPropagate with the given states, after a forwardPass on the same states.
+     * Updates the weights and biases right away.
+     * \param targetOutput outputSize() values.
+     * \return The loss, MSE or cross-entropy.
+     */
+    double backwardPass(std::vector<LayerState<Scalar>>& states, const Scalar* targetOutput);
+
+    /**
+     * \brief Forward propagate a batch and calculate every layer's error gradients, without touching
+     * the weights. Only reads the network, so it can run on several threads with separate states.
+     * \param states The buffers to use, from createLayerStates.
+     * \param firstSample Index of the batch's first sample in trainingData and targetOutput.
+     * \param batchSize The number of samples in the batch.
+     * \return The loss of every sample in the batch, summed.
+     */
+    double calculateBatchGradients(std::vector<LayerState<Scalar>>& states, const std::vector<std::vector<Scalar>>& trainingData,
+        const std::vector<std::vector<Scalar>>& targetOutput, size_t firstSample, size_t batchSize) const;
+
+    /**
+     * \brief Same as above, for a batch whose inputs are already in states[0].batchOutputs and whose targets
+     * are in the output layer's batchErrorDeltas, one row per sample.
+     */
+    double calculateBatchGradients(std::vector<LayerState<Scalar>>& states, size_t batchSize) const;
+
+    /**
+     * \brief Apply the changes from the last calculateBatchGradients on layerStates, as one update per layer.
+     */
+    void updateWeightsBatch(size_t batchSize);
+
+    /**
+     * \brief Size the batch buffers of every layer in layerStates for batchSize samples. Only does something when
+     * batchSize is larger than before, and then carves all of them out of the reset batch arena again, so the
+     * smaller buffers don't stay behind.
+     */
+    void reserveBatch(size_t batchSize);
+
+    std::pmr::memory_resource* memoryResource() const;
+    std::pmr::memory_resource* batchMemoryResource() const;
+
+    // Where networkLayers and layerStates keep their buffers. Declared before them, so the arenas outlive the buffers.
+    std::unique_ptr<Arena> memory;
+    std::unique_ptr<Arena> batchMemory;
+
+    std::vector<NetworkLayer<Scalar>> networkLayers;
+
+    // Activations and gradients used by forwardPropagate, backPropagate, train and trainBatch
+    std::vector<LayerState<Scalar>> layerStates;
+
+    double sparseInputThreshold;
+
+    // How many samples the batch buffers of layerStates hold, see reserveBatch
+    size_t reservedBatchSize = 0;
 };
+
+using NeuralNetwork = BasicNeuralNetwork<double>;
+using NeuralNetworkFloat = BasicNeuralNetwork<float>;
@@ -0,0 +1,174 @@
+﻿#include "Profiler.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // Trace events kept at most, about 40 MB
+    constexpr size_t MAX_TRACE_EVENTS = 1 << 20;
+
+    struct TraceEvent
+    {
+        Profiler::Phase phase;
+        size_t layer;
+        size_t thread;
+        double startMicroseconds;
+        double durationMicroseconds;
+    };
+
+    std::atomic<bool> tracing{ false };
+
+    // Guards everything below
+    std::mutex mutex;
+    // Indexed by layer * 3 + phase
+    std::vector<Profiler::LayerProfile> profiles;
+    std::vector<TraceEvent> traceEvents;
+    std::vector<std::thread::id> traceThreads;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    size_t threadIndex(std::thread::id thread)
+    {
+        const auto it = std::find(traceThreads.begin(), traceThreads.end(), thread);
+        if (it != traceThreads.end())
+            return (size_t)(it - traceThreads.begin());
+        traceThreads.push_back(thread);
+        return traceThreads.size() - 1;
+    }
+}
+
+namespace Profiler
+{
+    void enable(bool enabled)
+    {
+        profilingEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void enableTrace(bool enabled)
+    {
+        tracing.store(enabled, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        profiles.clear();
+        traceEvents.clear();
+        traceThreads.clear();
+        epoch = std::chrono::steady_clock::now();
+    }
+
+    std::vector<LayerProfile> report()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<LayerProfile> recorded;
+        for (const LayerProfile& profile : profiles)
+        {
+            if (profile.calls > 0)
+                recorded.push_back(profile);
+        }
+        return recorded;
+    }
+
+    void writeJson(std::ostream& stream)
+    {
+        const std::vector<LayerProfile> recorded = report();
+        stream << "[\n";
+        for (size_t i = 0; i < recorded.size(); i++)
+        {
+            const LayerProfile& profile = recorded[i];
+            stream << "  { \"layer\": " << profile.layer << ", \"phase\": \"" << phaseName(profile.phase) << "\", \"calls\": " << profile.calls
+                << ", \"seconds\": " << profile.seconds << ", \"flops\": " << profile.flops << ", \"bytes\": " << profile.bytes
+                << ", \"gflopsPerSecond\": " << profile.gflopsPerSecond() << ", \"gigabytesPerSecond\": " << profile.gigabytesPerSecond()
+                << ", \"allocations\": " << profile.allocations << " }" << (i + 1 < recorded.size() ? "," : "") << "\n";
+        }
+        stream << "]\n";
+    }
+
+    void writeCsv(std::ostream& stream)
+    {
+        stream << "layer,phase,calls,seconds,flops,bytes,gflopsPerSecond,gigabytesPerSecond,allocations\n";
+        for (const LayerProfile& profile : report())
+        {
+            stream << profile.layer << "," << phaseName(profile.phase) << "," << profile.calls << "," << profile.seconds << ","
+                << profile.flops << "," << profile.bytes << "," << profile.gflopsPerSecond() << "," << profile.gigabytesPerSecond() << ","
+                << profile.allocations << "\n";
+        }
+    }
+
+    void writeChromeTrace(std::ostream& stream)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stream << "{ \"traceEvents\": [\n" << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < traceEvents.size(); i++)
+        {
+            const TraceEvent& event = traceEvents[i];
+            stream << "  { \"name\": \"layer " << event.layer << " " << phaseName(event.phase) << "\", \"cat\": \"" << phaseName(event.phase)
+                << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << event.thread << ", \"ts\": " << event.startMicroseconds
+                << ", \"dur\": " << event.durationMicroseconds << " }" << (i + 1 < traceEvents.size() ? "," : "") << "\n";
+        }
+        stream << "] }\n" << std::defaultfloat;
+    }
+
+    const char* phaseName(Phase phase)
+    {
+        switch (phase)
+        {
+        case Forward:
+            return "forward";
+        case Gradients:
+            return "gradients";
+        case Update:
+            return "update";
+        default:
+            return "unknown";
+        }
+    }
+
+    void Scope::begin(Phase phase, size_t layer, double flops, double bytes)
+    {
+        active = true;
+        this->phase = phase;
+        this->layer = layer;
+        this->flops = flops;
+        this->bytes = bytes;
+        allocationsBefore = AllocationCounter::allocations();
+        start = std::chrono::steady_clock::now();
+    }
+
+    void Scope::end()
+    {
+        const std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+        const size_t allocations = AllocationCounter::allocations() - allocationsBefore;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const size_t index = layer * 3 + phase;
+        if (profiles.size() <= index)
+        {
+            const size_t oldSize = profiles.size();
+            profiles.resize(index + 1);
+            for (size_t i = oldSize; i < profiles.size(); i++)
+            {
+                profiles[i].layer = i / 3;
+                profiles[i].phase = (Phase)(i % 3);
+            }
+        }
+
+        LayerProfile& profile = profiles[index];
+        profile.calls++;
+        profile.seconds += std::chrono::duration<double>(finish - start).count();
+        profile.flops += flops;
+        profile.bytes += bytes;
+        profile.allocations += allocations;
+
+        if (tracing.load(std::memory_order_relaxed) && traceEvents.size() < MAX_TRACE_EVENTS)
+        {
+            traceEvents.push_back(TraceEvent{ phase, layer, threadIndex(std::this_thread::get_id()),
+                std::chrono::duration<double, std::micro>(start - epoch).count(),
+                std::chrono::duration<double, std::micro>(finish - start).count() });
+        }
+    }
+}
@@ -0,0 +1,152 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * \brief Per-layer profiling of the network's forward passes, gradient calculations and weight updates.
+ * BasicNeuralNetwork wraps every layer of every pass in an NN_PROFILE_LAYER scope. Builds with
+ * NN_NO_PROFILING defined compile the scopes out completely. Otherwise, while the profiler is disabled (the default),
+ * a scope costs one inlined relaxed load of an atomic flag and a branch. Its flops and bytes aren't even worked out, so
+ * it can stay in release builds.
+ * Layers are counted by their index in the network, so profiling two networks at once adds them together.
+ */
+namespace Profiler
+{
+    enum Phase
+    {
+        Forward,
+        // Error deltas and gradients of a layer, from the targets or the next layer
+        Gradients,
+        // Weight and bias changes
+        Update
+    };
+
+    /**
+     * \brief Everything recorded for one layer and phase.
+     * The flops and bytes are nominal: every weight used once per sample in a matrix pass, and read once
+     * (read and written for updates) per pass. Sparse inputs and cache hits make the real numbers lower.
+     */
+    struct LayerProfile
+    {
+        size_t layer = 0;
+        Phase phase = Forward;
+        uint64_t calls = 0;
+        double seconds = 0.0;
+        double flops = 0.0;
+        double bytes = 0.0;
+        // Only counted in builds with NN_COUNT_ALLOCATIONS, see AllocationCounter. Counts every thread.
+        uint64_t allocations = 0;
+
+        double gflopsPerSecond() const { return seconds > 0.0 ? flops / seconds * 1e-9 : 0.0; }
+        double gigabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds * 1e-9 : 0.0; }
+    };
+
+    // Set by enable. Defined in the header, so the scopes check it without calling into Profiler.cpp.
+    inline std::atomic<bool> profilingEnabled{ false };
+
+    void enable(bool enabled);
+    inline bool enabled() { return profilingEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * \brief Also keep every scope as an event for writeChromeTrace. Only while the profiler is enabled,
+     * and up to a fixed number of events, so leaving it on doesn't grow without bound.
+     */
+    void enableTrace(bool enabled);
+
+    /**
+     * \brief Forget everything recorded so far, and start the trace's clock over.
+     */
+    void reset();
+
+    /**
+     * \return Every layer and phase that was recorded, ordered by layer and then phase.
+     */
+    std::vector<LayerProfile> report();
+
+    /**
+     * \brief The report as a JSON array of objects, one per layer and phase.
+     */
+    void writeJson(std::ostream& stream);
+
+    /**
+     * \brief The report as CSV, with a header row.
+     */
+    void writeCsv(std::ostream& stream);
+
+    /**
+     * \brief The traced events in the Chrome trace event format, for chrome://tracing or Perfetto.
+     * Every thread that ran a layer gets its own row.
+     */
+    void writeChromeTrace(std::ostream& stream);
+
+    const char* phaseName(Phase phase);
+
+    /**
+     * \brief What a Scope records, apart from the time and allocations.
+     */
+    struct ScopeInfo
+    {
+        Phase phase;
+        size_t layer;
+        double flops;
+        double bytes;
+    };
+
+    /**
+     * \brief Records the time, flops, bytes and allocations from its construction to its destruction.
+     * Use NN_PROFILE_LAYER instead, so it compiles out with NN_NO_PROFILING.
+     */
+    class Scope
+    {
+    public:
+        /**
+         * \param describe Returns the ScopeInfo. Only called while the profiler is enabled.
+         */
+        template <typename Describe>
+        explicit Scope(const Describe& describe)
+        {
+            if (enabled())
+            {
+                const ScopeInfo info = describe();
+                begin(info.phase, info.layer, info.flops, info.bytes);
+            }
+        }
+
+        ~Scope()
+        {
+            if (active)
+                end();
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        void begin(Phase phase, size_t layer, double flops, double bytes);
+        void end();
+
+        bool active = false;
+        Phase phase = Forward;
+        size_t layer = 0;
+        double flops = 0.0;
+        double bytes = 0.0;
+        size_t allocationsBefore = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#ifdef NN_NO_PROFILING
+// Unevaluated, so nothing runs, but the arguments still count as used and keep compiling
+#define NN_PROFILE_LAYER(phase, layer, flops, bytes) \
+    (void)sizeof(Profiler::ScopeInfo{ phase, (size_t)(layer), (double)(flops), (double)(bytes) })
+#else
+// Profile the rest of the enclosing block as phase of layer, see Profiler. The arguments are only evaluated while
+// the profiler is enabled.
+#define NN_PROFILE_LAYER(phase, layer, flops, bytes) \
+    Profiler::Scope profilerScope([&] { return Profiler::ScopeInfo{ phase, (size_t)(layer), (double)(flops), (double)(bytes) }; })
+#endif
@@ -0,0 +1,139 @@
+﻿#include "QuantizedNetwork.h"
+#include "Kernels.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+template <typename Scalar>
+QuantizedNetwork::QuantizedNetwork(const BasicNeuralNetwork<Scalar>& network, const std::vector<std::vector<Scalar>>& calibrationData)
+{
+    const std::vector<NetworkLayer<Scalar>>& layers = network.layers();
+    numInputs = layers[0].size();
+
+    // Only dense layers can be converted
+    assert(std::all_of(layers.begin(), layers.end(), [](const NetworkLayer<Scalar>& layer) { return layer.type == Dense; }));
+
+    // Calibration: the largest absolute value every layer outputs, which is the input range of the next layer
+    std::vector<double> maxOutputs(layers.size(), 0.0);
+    std::vector<LayerState<Scalar>> states = network.createLayerStates();
+    for (const std::vector<Scalar>& sample : calibrationData)
+    {
+        assert(sample.size() == numInputs);
+        std::copy(sample.begin(), sample.end(), states[0].outputs.begin());
+        for (size_t i = 1; i < layers.size(); i++)
+            layers[i].feedForward(states[i - 1], states[i]);
+
+        for (size_t i = 0; i < layers.size(); i++)
+            for (Scalar output : states[i].outputs)
+                maxOutputs[i] = std::max(maxOutputs[i], (double)std::fabs(output));
+    }
+
+    size_t widest = numInputs;
+    for (size_t i = 1; i < layers.size(); i++)
+    {
+        const NetworkLayer<Scalar>& layer = layers[i];
+        QuantizedLayer quantized;
+        quantized.numNeurons = layer.numNeurons;
+        quantized.numInputs = layer.numInputs;
+        quantized.activationFunction = layer.activationFunction;
+        quantized.inputScale = maxOutputs[i - 1] > 0.0 ? (float)(maxOutputs[i - 1] / 127.0) : 1.0f;
+        quantized.weights.resize(layer.weights.size());
+        quantized.outputScales.resize(layer.numNeurons);
+        quantized.biases.assign(layer.biases.begin(), layer.biases.end());
+
+        for (size_t n = 0; n < layer.numNeurons; n++)
+        {
+            const Scalar* row = layer.weightRow(n);
+            double maxWeight = 0.0;
+            for (size_t k = 0; k < layer.numInputs; k++)
+                maxWeight = std::max(maxWeight, (double)std::fabs(row[k]));
+
+            const float rowScale = maxWeight > 0.0 ? (float)(maxWeight / 127.0) : 1.0f;
+            for (size_t k = 0; k < layer.numInputs; k++)
+                quantized.weights[n * layer.numInputs + k] = quantize((float)row[k], 1.0f / rowScale);
+
+            quantized.outputScales[n] = rowScale * quantized.inputScale;
+        }
+
+        widest = std::max(widest, layer.numNeurons);
+        quantizedLayers.push_back(std::move(quantized));
+    }
+
+    quantizedInputs.resize(widest);
+    sums.resize(widest);
+    activations.resize(widest);
+}
+
+template QuantizedNetwork::QuantizedNetwork(const BasicNeuralNetwork<float>&, const std::vector<std::vector<float>>&);
+template QuantizedNetwork::QuantizedNetwork(const BasicNeuralNetwork<double>&, const std::vector<std::vector<double>>&);
+
+int8_t QuantizedNetwork::quantize(float value, float inverseScale)
+{
+    const float scaled = std::nearbyint(value * inverseScale);
+    return (int8_t)std::min(127.0f, std::max(-127.0f, scaled));
+}
+
+std::vector<float> QuantizedNetwork::predict(const std::vector<double>& input)
+{
+    assert(input.size() == numInputs);
+    std::vector<float> output(outputSize());
+    run(input.data(), output.data());
+    return output;
+}
+
+std::vector<float> QuantizedNetwork::predict(const std::vector<float>& input)
+{
+    assert(input.size() == numInputs);
+    std::vector<float> output(outputSize());
+    run(input.data(), output.data());
+    return output;
+}
+
+void QuantizedNetwork::predict(const double* input, float* output)
+{
+    run(input, output);
+}
+
+void QuantizedNetwork::predict(const float* input, float* output)
+{
+    run(input, output);
+}
+
+template <typename Scalar>
+void QuantizedNetwork::run(const Scalar* input, float* output)
+{
+    const float inverseInputScale = 1.0f / quantizedLayers[0].inputScale;
+    for (size_t k = 0; k < numInputs; k++)
+        quantizedInputs[k] = quantize((float)input[k], inverseInputScale);
+
+    for (size_t i = 0; i < quantizedLayers.size(); i++)
+    {
+        const QuantizedLayer& layer = quantizedLayers[i];
+        Kernels::gemvInt8(layer.weights.data(), quantizedInputs.data(), sums.data(), layer.numNeurons, layer.numInputs);
+
+        for (size_t n = 0; n < layer.numNeurons; n++)
+            activations[n] = (float)sums[n] * layer.outputScales[n] + layer.biases[n];
+        activate(layer.activationFunction, activations.data(), activations.data(), layer.numNeurons);
+
+        // Quantize for the next layer. The output layer stays in float.
+        if (i + 1 < quantizedLayers.size())
+        {
+            const float inverseScale = 1.0f / quantizedLayers[i + 1].inputScale;
+            for (size_t n = 0; n < layer.numNeurons; n++)
+                quantizedInputs[n] = quantize(activations[n], inverseScale);
+        }
+    }
+
+    std::copy(activations.begin(), activations.begin() + outputSize(), output);
+}
+
+size_t QuantizedNetwork::modelSize() const
+{
+    size_t bytes = 0;
+    for (const QuantizedLayer& layer : quantizedLayers)
+    {
+        bytes += layer.weights.size() * sizeof(int8_t);
+        bytes += (layer.outputScales.size() + layer.biases.size()) * sizeof(float);
+    }
+    return bytes;
+}
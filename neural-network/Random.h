@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/**
+ * \brief Counter-based random numbers. Value number i of a stream is a hash of the stream's key and i,
+ * so any part of a stream can be generated on its own, on any thread and in any order, and the values
+ * only depend on the key. Based on SplitMix64, which is the same as hashing successive counters.
+ */
+namespace Random
+{
+    /**
+     * \brief SplitMix64's output function. Every input gives a different, well mixed output.
+     */
+    inline uint64_t mix(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    /**
+     * \return Value number index of the stream key, as 64 random bits.
+     */
+    inline uint64_t bits(uint64_t key, uint64_t index)
+    {
+        return mix(key + (index + 1) * 0x9E3779B97F4A7C15ull);
+    }
+
+    /**
+     * \return Value number index of the stream key, uniform in [-1, 1).
+     */
+    inline double uniform(uint64_t key, uint64_t index)
+    {
+        // The top 53 bits fill a double's mantissa exactly
+        return (double)(bits(key, index) >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+    }
+}
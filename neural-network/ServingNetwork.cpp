@@ -0,0 +1,65 @@
+﻿#include "ServingNetwork.h"
+#include <cassert>
+
+template <typename Scalar>
+ServingNetwork<Scalar>::ServingNetwork(const BasicNeuralNetwork<Scalar>& network, ThreadPool* threadPool)
+    : current(std::make_shared<BasicNeuralNetwork<Scalar>>(network)), publishCount(0), threadPool(threadPool)
+{
+    current->setThreadPool(threadPool);
+}
+
+template <typename Scalar>
+void ServingNetwork<Scalar>::publish(const BasicNeuralNetwork<Scalar>& network)
+{
+    std::lock_guard<std::mutex> lock(publishMutex);
+
+    // Nobody can load the previous snapshot anymore, so once its count is down to our own reference,
+    // every reader is done with it and it can be overwritten
+    std::shared_ptr<BasicNeuralNetwork<Scalar>> next;
+    if (previous != nullptr && previous.use_count() == 1)
+    {
+        // Order the readers' last reads before our writes
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next = std::move(previous);
+        *next = network; // Copies into the existing buffers when the topology is the same
+    }
+    else
+    {
+        next = std::make_shared<BasicNeuralNetwork<Scalar>>(network);
+    }
+    next->setThreadPool(threadPool);
+
+    previous = std::atomic_exchange(&current, std::move(next));
+    publishCount.fetch_add(1, std::memory_order_release);
+}
+
+template <typename Scalar>
+std::shared_ptr<const BasicNeuralNetwork<Scalar>> ServingNetwork<Scalar>::snapshot() const
+{
+    return std::atomic_load(&current);
+}
+
+template <typename Scalar>
+void ServingNetwork<Scalar>::predict(const Scalar* input, Scalar* output, std::vector<LayerState<Scalar>>& states) const
+{
+    // Holding the pointer keeps the snapshot from being reused until the prediction is done
+    const std::shared_ptr<const BasicNeuralNetwork<Scalar>> network = snapshot();
+    network->predict(input, output, states);
+}
+
+template <typename Scalar>
+std::vector<Scalar> ServingNetwork<Scalar>::predict(const std::vector<Scalar>& input) const
+{
+    const std::shared_ptr<const BasicNeuralNetwork<Scalar>> network = snapshot();
+
+    // Input size does not match the number of inputs for the network
+    assert(input.size() == network->inputSize());
+
+    std::vector<LayerState<Scalar>> states = network->createLayerStates();
+    std::vector<Scalar> output(network->outputSize());
+    network->predict(input.data(), output.data(), states);
+    return output;
+}
+
+template class ServingNetwork<float>;
+template class ServingNetwork<double>;
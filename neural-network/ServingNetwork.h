@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "NeuralNetwork.h"
+
+class ThreadPool;
+
+/**
+ * \brief Serves predictions from any number of threads while another thread keeps training.
+ * The trainer owns its own network and publishes copies of it. Readers always predict with the latest
+ * published snapshot, which is never written to while anyone can still read it.
+ * A snapshot is a shared_ptr that is swapped atomically, RCU-style. Readers never wait on the trainer:
+ * a reader holds on to the snapshot it loaded until its predict is done, and a publish only replaces which
+ * snapshot the next readers load. The old snapshot's memory is reused by the next publish once no reader
+ * holds it anymore.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+class ServingNetwork
+{
+public:
+    /**
+     * \param network Published as the first snapshot.
+     * \param threadPool The pool the snapshots split wide layers over. nullptr, the default, runs every predict
+     * on the thread that calls it, so requests don't queue up behind each other's (or the trainer's) chunks.
+     */
+    explicit ServingNetwork(const BasicNeuralNetwork<Scalar>& network, ThreadPool* threadPool = nullptr);
+
+    /**
+     * \brief Copy the weights of network into a new snapshot and swap it in. Readers that are in the
+     * middle of a predict finish it on the snapshot they started with. Copies the whole network, so call
+     * it every so many batches, not every sample. Publishes from several threads are serialized.
+     * \param network The network to copy. Can't be trained while it is being copied.
+     */
+    void publish(const BasicNeuralNetwork<Scalar>& network);
+
+    /**
+     * \return The latest snapshot. Stays valid and unchanged for as long as the pointer is held.
+     */
+    std::shared_ptr<const BasicNeuralNetwork<Scalar>> snapshot() const;
+
+    /**
+     * \brief Predict with the latest snapshot. Thread-safe, and doesn't allocate any memory.
+     * \param input inputSize() values to process.
+     * \param output Receives outputSize() values.
+     * \param states Scratch buffers from createLayerStates, one set per thread. Every published network
+     * has to have the same topology for them to fit.
+     */
+    void predict(const Scalar* input, Scalar* output, std::vector<LayerState<Scalar>>& states) const;
+
+    /**
+     * \brief Same as above, with scratch buffers allocated for this one call.
+     */
+    std::vector<Scalar> predict(const std::vector<Scalar>& input) const;
+
+    std::vector<LayerState<Scalar>> createLayerStates() const { return snapshot()->createLayerStates(); }
+
+    /**
+     * \return How many times publish has been called.
+     */
+    uint64_t version() const { return publishCount.load(std::memory_order_acquire); }
+
+protected:
+    // Only ever accessed through std::atomic_load and std::atomic_exchange
+    std::shared_ptr<BasicNeuralNetwork<Scalar>> current;
+
+    // The snapshot before current, reused by the next publish if no reader holds it. Guarded by publishMutex.
+    std::shared_ptr<BasicNeuralNetwork<Scalar>> previous;
+
+    std::mutex publishMutex;
+    std::atomic<uint64_t> publishCount;
+    ThreadPool* threadPool;
+};
@@ -0,0 +1,170 @@
+﻿#include "SparseNetwork.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+
+template <typename Scalar>
+SparseNetwork<Scalar>::SparseNetwork(const BasicNeuralNetwork<Scalar>& network, double maxDensity)
+    : threadPool(&ThreadPool::global())
+{
+    const std::vector<NetworkLayer<Scalar>>& layers = network.layers();
+    numInputs = layers[0].size();
+
+    // Only dense layers can be converted
+    assert(std::all_of(layers.begin(), layers.end(), [](const NetworkLayer<Scalar>& layer) { return layer.type == Dense; }));
+
+    size_t widest = numInputs;
+    for (size_t i = 1; i < layers.size(); i++)
+    {
+        const NetworkLayer<Scalar>& layer = layers[i];
+        SparseLayer sparseLayer;
+        sparseLayer.numNeurons = layer.numNeurons;
+        sparseLayer.numInputs = layer.numInputs;
+        sparseLayer.activationFunction = layer.activationFunction;
+        sparseLayer.biases.assign(layer.biases.begin(), layer.biases.end());
+
+        const size_t nonZero = layer.weights.size() - std::count(layer.weights.begin(), layer.weights.end(), Scalar(0));
+        sparseLayer.sparse = (double)nonZero <= maxDensity * (double)layer.weights.size();
+
+        if (sparseLayer.sparse)
+        {
+            sparseLayer.values.reserve(nonZero);
+            sparseLayer.columns.reserve(nonZero);
+            sparseLayer.rowStarts.reserve(layer.numNeurons + 1);
+            for (size_t n = 0; n < layer.numNeurons; n++)
+            {
+                sparseLayer.rowStarts.push_back((uint32_t)sparseLayer.values.size());
+                const Scalar* row = layer.weightRow(n);
+                for (size_t k = 0; k < layer.numInputs; k++)
+                {
+                    if (row[k] != 0)
+                    {
+                        sparseLayer.values.push_back(row[k]);
+                        sparseLayer.columns.push_back((uint32_t)k);
+                    }
+                }
+            }
+            sparseLayer.rowStarts.push_back((uint32_t)sparseLayer.values.size());
+        }
+        else
+        {
+            sparseLayer.weights.assign(layer.weights.begin(), layer.weights.end());
+        }
+
+        widest = std::max(widest, layer.numNeurons);
+        sparseLayers.push_back(std::move(sparseLayer));
+    }
+
+    activations.resize(widest);
+    nextActivations.resize(widest);
+}
+
+template <typename Scalar>
+std::vector<Scalar> SparseNetwork<Scalar>::predict(const std::vector<Scalar>& input)
+{
+    // Input size does not match the number of inputs for the network
+    assert(input.size() == inputSize());
+
+    std::vector<Scalar> output(outputSize());
+    predict(input.data(), output.data());
+    return output;
+}
+
+template <typename Scalar>
+void SparseNetwork<Scalar>::predict(const Scalar* input, Scalar* output)
+{
+    std::copy(input, input + numInputs, activations.begin());
+
+    for (const SparseLayer& layer : sparseLayers)
+    {
+        ParallelWork::forEachChunk(threadPool, layer.numNeurons, layer.work() / layer.numNeurons, [&](size_t first, size_t last)
+        {
+            if (layer.sparse)
+                Kernels::csrGemv(layer.values.data(), layer.columns.data(), layer.rowStarts.data() + first,
+                    activations.data(), nextActivations.data() + first, last - first);
+            else
+                Kernels::gemv(layer.weights.data() + first * layer.numInputs, activations.data(), nextActivations.data() + first,
+                    last - first, layer.numInputs);
+
+            for (size_t n = first; n < last; n++)
+                nextActivations[n] += layer.biases[n];
+            if (isElementWise(layer.activationFunction))
+                activate(layer.activationFunction, nextActivations.data() + first, nextActivations.data() + first, last - first);
+        });
+
+        if (!isElementWise(layer.activationFunction))
+            activate(layer.activationFunction, nextActivations.data(), nextActivations.data(), layer.numNeurons);
+
+        activations.swap(nextActivations);
+    }
+
+    std::copy(activations.begin(), activations.begin() + outputSize(), output);
+}
+
+template <typename Scalar>
+void SparseNetwork<Scalar>::predictBatch(const Scalar* inputs, size_t count, Scalar* outputs)
+{
+    size_t widest = numInputs;
+    for (const SparseLayer& layer : sparseLayers)
+        widest = std::max(widest, layer.numNeurons);
+
+    // Only grows, like LayerState::reserveBatch
+    const size_t batchCapacity = std::min(count, BasicNeuralNetwork<Scalar>::MAX_PREDICT_BATCH) * widest;
+    if (activations.size() < batchCapacity)
+    {
+        activations.resize(batchCapacity);
+        nextActivations.resize(batchCapacity);
+    }
+
+    for (size_t first = 0; first < count; first += BasicNeuralNetwork<Scalar>::MAX_PREDICT_BATCH)
+    {
+        const size_t batchSize = std::min(BasicNeuralNetwork<Scalar>::MAX_PREDICT_BATCH, count - first);
+        std::copy(inputs + first * numInputs, inputs + (first + batchSize) * numInputs, activations.begin());
+
+        for (const SparseLayer& layer : sparseLayers)
+        {
+            // Split the samples, so every chunk writes whole output rows
+            ParallelWork::forEachChunk(threadPool, batchSize, layer.work(), [&](size_t firstSample, size_t lastSample)
+            {
+                Scalar* out = nextActivations.data() + firstSample * layer.numNeurons;
+                for (size_t b = firstSample; b < lastSample; b++)
+                    std::copy(layer.biases.begin(), layer.biases.end(), nextActivations.begin() + b * layer.numNeurons);
+
+                const Scalar* in = activations.data() + firstSample * layer.numInputs;
+                if (layer.sparse)
+                    Kernels::csrGemmNT(layer.values.data(), layer.columns.data(), layer.rowStarts.data(), layer.numNeurons,
+                        in, layer.numInputs, out, lastSample - firstSample);
+                else
+                    Kernels::gemmNT(in, layer.weights.data(), out, lastSample - firstSample, layer.numNeurons, layer.numInputs);
+
+                activateRows(layer.activationFunction, out, out, lastSample - firstSample, layer.numNeurons);
+            });
+
+            activations.swap(nextActivations);
+        }
+
+        std::copy(activations.begin(), activations.begin() + batchSize * outputSize(), outputs + first * outputSize());
+    }
+}
+
+template <typename Scalar>
+size_t SparseNetwork<Scalar>::modelSize() const
+{
+    size_t bytes = 0;
+    for (const SparseLayer& layer : sparseLayers)
+    {
+        bytes += (layer.values.size() + layer.weights.size() + layer.biases.size()) * sizeof(Scalar);
+        bytes += (layer.columns.size() + layer.rowStarts.size()) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+template <typename Scalar>
+size_t SparseNetwork<Scalar>::numSparseLayers() const
+{
+    return std::count_if(sparseLayers.begin(), sparseLayers.end(), [](const SparseLayer& layer) { return layer.sparse; });
+}
+
+template class SparseNetwork<float>;
+template class SparseNetwork<double>;
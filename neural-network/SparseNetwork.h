@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ActivationFunction.h"
+#include "NeuralNetwork.h"
+
+class ThreadPool;
+
+/**
+ * \brief Inference-only copy of a pruned network, with the zero weights left out.
+ * Layers where few enough weights are non-zero are stored in CSR form (the non-zero values of every row, and
+ * the column of each) and run with the sparse kernels. The other layers stay dense, because below about two thirds
+ * zeros, looking up the column of every weight costs more time than skipping the zeros saves.
+ * \tparam Scalar The floating point type of the network, float or double.
+ */
+template <typename Scalar>
+class SparseNetwork
+{
+public:
+    /**
+     * \param network The pruned network, e.g. by MagnitudePruner, of dense layers only. Not referenced after construction.
+     * \param maxDensity Layers with at most this fraction of non-zero weights are stored sparse.
+     */
+    explicit SparseNetwork(const BasicNeuralNetwork<Scalar>& network, double maxDensity = 0.3);
+
+    /**
+     * \brief Predict the output for a given input, like NeuralNetwork::predict.
+     */
+    std::vector<Scalar> predict(const std::vector<Scalar>& input);
+
+    /**
+     * \brief Predict into a buffer owned by the caller. Doesn't allocate any memory.
+     */
+    void predict(const Scalar* input, Scalar* output);
+
+    /**
+     * \brief Predict a whole batch at once, like NeuralNetwork::predictBatch. Every non-zero weight is loaded
+     * once per few samples instead of once per sample.
+     * \param inputs count x inputSize() values, row-major, one row per sample.
+     * \param outputs Receives count x outputSize() values, one row per sample.
+     */
+    void predictBatch(const Scalar* inputs, size_t count, Scalar* outputs);
+
+    size_t inputSize() const { return numInputs; }
+    size_t outputSize() const { return sparseLayers.back().numNeurons; }
+
+    /**
+     * \return The number of bytes taken up by the weights, column indices, row starts and biases.
+     */
+    size_t modelSize() const;
+
+    /**
+     * \return How many of the layers, not counting the input layer, are stored sparse.
+     */
+    size_t numSparseLayers() const;
+
+    // Where wide layers split their work. ThreadPool::global() by default, nullptr runs on the calling thread.
+    ThreadPool* threadPool;
+
+protected:
+    struct SparseLayer
+    {
+        size_t numNeurons;
+        size_t numInputs;
+        ActiviationFunction activationFunction;
+        bool sparse;
+
+        // CSR form, if sparse: the non-zero weights row by row, the column of each, and where every row starts
+        std::vector<Scalar> values;
+        std::vector<uint32_t> columns;
+        std::vector<uint32_t> rowStarts;
+
+        // numNeurons x numInputs, row-major, if not sparse
+        std::vector<Scalar> weights;
+        std::vector<Scalar> biases;
+
+        // Multiply-adds for one sample, to decide whether to split the layer
+        size_t work() const { return sparse ? values.size() : weights.size(); }
+    };
+
+    std::vector<SparseLayer> sparseLayers;
+    size_t numInputs;
+
+    // Buffers for predict and predictBatch, so they don't allocate on every call.
+    // One layer reads one and writes the other.
+    std::vector<Scalar> activations;
+    std::vector<Scalar> nextActivations;
+};
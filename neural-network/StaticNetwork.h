@@ -0,0 +1,405 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <vector>
+#include "ActivationFunction.h"
+#include "Random.h"
+
+/**
+ * \brief A layer of a StaticNetwork: its number of neurons and activation function, both fixed at compile time.
+ */
+template <size_t Neurons, ActiviationFunction Activation>
+struct Layer
+{
+    static constexpr size_t size = Neurons;
+    static constexpr ActiviationFunction activationFunction = Activation;
+};
+
+namespace StaticNetworkDetail
+{
+    /**
+     * \brief Dot product of Count values, over several partial sums so the compiler can vectorize it
+     * without having to reorder a single sum.
+     */
+    template <size_t Count, typename Scalar>
+    Scalar dot(const Scalar* a, const Scalar* b)
+    {
+        constexpr size_t lanes = 8;
+        std::array<Scalar, lanes> sums{};
+        size_t i = 0;
+        for (; i + lanes <= Count; i += lanes)
+        {
+            for (size_t lane = 0; lane < lanes; lane++)
+                sums[lane] += a[i + lane] * b[i + lane];
+        }
+        Scalar sum = 0;
+        for (; i < Count; i++)
+            sum += a[i] * b[i];
+        for (size_t lane = 0; lane < lanes; lane++)
+            sum += sums[lane];
+        return sum;
+    }
+}
+
+/**
+ * \brief One layer of a StaticNetwork with its weights, biases, activations and gradients, all in std::arrays
+ * of compile-time sizes.
+ */
+template <typename Scalar, size_t Inputs, size_t Neurons, ActiviationFunction Activation>
+struct StaticLayer
+{
+    using Policy = typename ActivationPolicy<Activation>::type;
+
+    static constexpr size_t numInputs = Inputs;
+    static constexpr size_t numNeurons = Neurons;
+
+    // Layers with more neurons than inputs, like the 300 neurons on 2 inputs of XOR, store their weights
+    // column-major, one column of Neurons weights per input, so the forward pass and the update run over
+    // the neurons in contiguous loops. The others store them row-major like NetworkLayer, one dot product per neuron.
+    static constexpr bool columnMajor = Neurons > Inputs;
+
+    /**
+     * \return Where the weight from input i to neuron n is in weights.
+     */
+    static constexpr size_t weightIndex(size_t n, size_t i) { return columnMajor ? i * Neurons + n : n * Inputs + i; }
+
+    std::array<Scalar, Neurons * Inputs> weights;
+    std::array<Scalar, Neurons> biases;
+    std::array<Scalar, Neurons> outputs;
+    std::array<Scalar, Neurons> errorGradients;
+    std::array<Scalar, Neurons> errorDeltas;
+
+    /**
+     * \brief Same initial values as a NetworkLayer with UniformInit and the same seed, whatever the layout.
+     */
+    void initialize(unsigned int seed)
+    {
+        const uint64_t key = Random::mix(seed);
+        for (size_t n = 0; n < Neurons; n++)
+        {
+            for (size_t i = 0; i < Inputs; i++)
+                weights[weightIndex(n, i)] = (Scalar)Random::uniform(key, n * Inputs + i);
+            biases[n] = (Scalar)Random::uniform(key, weights.size() + n);
+        }
+    }
+
+    void feedForward(const Scalar* inputs)
+    {
+        if constexpr (columnMajor)
+        {
+            outputs = biases;
+            for (size_t i = 0; i < Inputs; i++)
+            {
+                const Scalar* column = weights.data() + i * Neurons;
+                const Scalar input = inputs[i];
+                for (size_t n = 0; n < Neurons; n++)
+                    outputs[n] += column[n] * input;
+            }
+        }
+        else
+        {
+            for (size_t n = 0; n < Neurons; n++)
+                outputs[n] = StaticNetworkDetail::dot<Inputs>(weights.data() + n * Inputs, inputs) + biases[n];
+        }
+
+        if constexpr (Activation == Softmax)
+        {
+            // Shifted by the largest input so the exponentials can't overflow, same as the dynamic layers
+            const Scalar largest = *std::max_element(outputs.begin(), outputs.end());
+            Scalar sum = 0;
+            for (Scalar& output : outputs)
+            {
+                output = std::exp(output - largest);
+                sum += output;
+            }
+            for (Scalar& output : outputs)
+                output /= sum;
+        }
+        else
+        {
+            // Sigmoid and tanh follow useApproximateActivations, like the dynamic layers
+            if constexpr (Activation == Sigmoid || Activation == Tanh)
+            {
+                if (approximateActivations())
+                {
+                    activate(Activation, outputs.data(), outputs.data(), Neurons);
+                    return;
+                }
+            }
+
+            for (Scalar& output : outputs)
+                output = Policy::activate(output);
+        }
+    }
+
+    /**
+     * \brief Output layer deltas and gradients, and the loss: the cross-entropy for Softmax, the MSE otherwise.
+     */
+    double calculateOutputGradients(const Scalar* targetOutput)
+    {
+        double loss = 0.0;
+        for (size_t n = 0; n < Neurons; n++)
+        {
+            errorDeltas[n] = targetOutput[n] - outputs[n];
+            if constexpr (Activation == Softmax)
+            {
+                if (targetOutput[n] != 0)
+                    loss -= targetOutput[n] * std::log(std::max(outputs[n], std::numeric_limits<Scalar>::min()));
+            }
+            else
+            {
+                loss += errorDeltas[n] * errorDeltas[n];
+            }
+            errorGradients[n] = errorDeltas[n] * Policy::derivative(outputs[n]);
+        }
+        return Activation == Softmax ? loss : loss / (double)Neurons;
+    }
+
+    template <typename NextLayer>
+    void calculateHiddenGradients(const NextLayer& next)
+    {
+        constexpr size_t nextNeurons = NextLayer::numNeurons;
+        if constexpr (NextLayer::columnMajor)
+        {
+            // Next layer's column n holds the weights from this layer's neuron n
+            for (size_t n = 0; n < Neurons; n++)
+                errorGradients[n] = StaticNetworkDetail::dot<nextNeurons>(next.weights.data() + n * nextNeurons, next.errorGradients.data());
+        }
+        else
+        {
+            errorGradients.fill(Scalar(0));
+            for (size_t k = 0; k < nextNeurons; k++)
+            {
+                const Scalar* row = next.weights.data() + k * Neurons;
+                const Scalar gradient = next.errorGradients[k];
+                for (size_t n = 0; n < Neurons; n++)
+                    errorGradients[n] += row[n] * gradient;
+            }
+        }
+
+        for (size_t n = 0; n < Neurons; n++)
+            errorGradients[n] *= Policy::derivative(outputs[n]);
+    }
+
+    /**
+     * \brief Same update as NetworkLayer: the output layer's weights move by its deltas, hidden layers' by their
+     * gradients, and the biases by the gradients.
+     */
+    void updateWeights(const Scalar* inputs, Scalar learningRate, bool isOutputLayer)
+    {
+        const std::array<Scalar, Neurons>& errors = isOutputLayer ? errorDeltas : errorGradients;
+        if constexpr (columnMajor)
+        {
+            for (size_t i = 0; i < Inputs; i++)
+            {
+                Scalar* column = weights.data() + i * Neurons;
+                const Scalar change = learningRate * inputs[i];
+                for (size_t n = 0; n < Neurons; n++)
+                    column[n] += change * errors[n];
+            }
+        }
+        else
+        {
+            for (size_t n = 0; n < Neurons; n++)
+            {
+                Scalar* row = weights.data() + n * Inputs;
+                const Scalar change = learningRate * errors[n];
+                for (size_t i = 0; i < Inputs; i++)
+                    row[i] += change * inputs[i];
+            }
+        }
+
+        for (size_t n = 0; n < Neurons; n++)
+            biases[n] += learningRate * errorGradients[n];
+    }
+};
+
+namespace StaticNetworkDetail
+{
+    // The tuple of StaticLayers for a list of Layers, each taking the previous layer's outputs as its inputs
+    template <typename Scalar, size_t Inputs, typename... Layers>
+    struct LayerTuple
+    {
+        using type = std::tuple<>;
+    };
+
+    template <typename Scalar, size_t Inputs, typename First, typename... Rest>
+    struct LayerTuple<Scalar, Inputs, First, Rest...>
+    {
+        using type = decltype(std::tuple_cat(
+            std::declval<std::tuple<StaticLayer<Scalar, Inputs, First::size, First::activationFunction>>>(),
+            std::declval<typename LayerTuple<Scalar, First::size, Rest...>::type>()));
+    };
+}
+
+/**
+ * \brief A network whose topology is fixed at compile time, for tiny models like the 2->300->1 XOR network.
+ * Every layer size and activation function is a template argument, and every weight, bias and activation
+ * lives in a std::array inside the network, so the compiler can unroll and vectorize every loop and
+ * inline every activation. Forward and backward passes work the same as in BasicNeuralNetwork, and with the
+ * same seed the initial weights are the same as those of a BasicNeuralNetwork with the same topology, so
+ * both train the same up to rounding.
+ * Everything is stored in the object itself, so networks with more than a few thousand weights belong on
+ * the heap, not the stack. Runs on the calling thread only.
+ * \tparam Inputs The number of inputs.
+ * \tparam Layers The hidden layers and the output layer, each a Layer<Neurons, Activation>.
+ * Use the StaticNetwork (double) and StaticNetworkFloat aliases.
+ */
+template <typename Scalar, size_t Inputs, typename... Layers>
+class BasicStaticNetwork
+{
+public:
+    static_assert(sizeof...(Layers) > 0, "A network needs at least an output layer");
+
+    static constexpr size_t numLayers = sizeof...(Layers);
+    using LayerTuple = typename StaticNetworkDetail::LayerTuple<Scalar, Inputs, Layers...>::type;
+    using OutputLayer = typename std::tuple_element<numLayers - 1, LayerTuple>::type;
+    static constexpr size_t numOutputs = OutputLayer::numNeurons;
+
+    /**
+     * \param learningRate The learning rate of every layer.
+     * \param seed Seed for the initial weights and biases, see NNConstructionInfo::seed. 0 picks a random seed.
+     */
+    explicit BasicStaticNetwork(double learningRate = 0.05, unsigned int seed = 0)
+        : learningRate((Scalar)learningRate), inputs{}
+    {
+        if (seed == 0)
+            seed = std::random_device()();
+        initializeLayers<0>(seed);
+    }
+
+    /**
+     * \brief Process inputSize() values through the network into outputSize() values.
+     */
+    void forwardPropagate(const Scalar* input, Scalar* output)
+    {
+        std::copy(input, input + Inputs, inputs.begin());
+        feedForward<0>(inputs.data());
+
+        const OutputLayer& outputLayer = std::get<numLayers - 1>(layers);
+        std::copy(outputLayer.outputs.begin(), outputLayer.outputs.end(), output);
+    }
+
+    std::array<Scalar, numOutputs> forwardPropagate(const std::array<Scalar, Inputs>& input)
+    {
+        std::array<Scalar, numOutputs> output;
+        forwardPropagate(input.data(), output.data());
+        return output;
+    }
+
+    std::vector<Scalar> forwardPropagate(const std::vector<Scalar>& input)
+    {
+        // Input size does not match the number of inputs for the network
+        assert(input.size() == Inputs);
+
+        std::vector<Scalar> output(numOutputs);
+        forwardPropagate(input.data(), output.data());
+        return output;
+    }
+
+    std::vector<Scalar> predict(const std::vector<Scalar>& input) { return forwardPropagate(input); }
+    void predict(const Scalar* input, Scalar* output) { forwardPropagate(input, output); }
+
+    /**
+     * \brief Calculate the error of the last forward propagation and update every weight and bias,
+     * same as BasicNeuralNetwork::backPropagate.
+     * \param targetOutput outputSize() values.
+     * \return The mean squared error, or the cross-entropy if the output layer uses Softmax.
+     */
+    double backPropagate(const Scalar* targetOutput)
+    {
+        const double loss = std::get<numLayers - 1>(layers).calculateOutputGradients(targetOutput);
+        if constexpr (numLayers > 1)
+            calculateHiddenGradients<numLayers - 2>();
+
+        // Every gradient is known before any weight changes
+        updateWeights<0>(inputs.data());
+        return loss;
+    }
+
+    /**
+     * \brief Forward propagate and backpropagate every sample in turn, same as BasicNeuralNetwork::train.
+     * \return The loss of the last sample.
+     */
+    double train(const std::vector<std::vector<Scalar>>& trainingData, const std::vector<std::vector<Scalar>>& targetOutput)
+    {
+        assert(trainingData.size() == targetOutput.size());
+
+        std::array<Scalar, numOutputs> output;
+        double loss = 0.0;
+        for (size_t i = 0; i < trainingData.size(); i++)
+        {
+            // Input or target size does not match the network
+            assert(trainingData[i].size() == Inputs && targetOutput[i].size() == numOutputs);
+
+            forwardPropagate(trainingData[i].data(), output.data());
+            loss = backPropagate(targetOutput[i].data());
+        }
+        return loss;
+    }
+
+    static constexpr size_t inputSize() { return Inputs; }
+    static constexpr size_t outputSize() { return numOutputs; }
+
+    /**
+     * \return Layer I, 0 being the first hidden layer (there is no input layer).
+     */
+    template <size_t I>
+    const typename std::tuple_element<I, LayerTuple>::type& layer() const { return std::get<I>(layers); }
+
+protected:
+    template <size_t I>
+    void initializeLayers(unsigned int seed)
+    {
+        // The same per-layer seed as BasicNeuralNetwork, whose layer I + 1 this is
+        std::seed_seq layerSeed{ seed, (unsigned int)(I + 1) };
+        unsigned int layerSeedValue;
+        layerSeed.generate(&layerSeedValue, &layerSeedValue + 1);
+        std::get<I>(layers).initialize(layerSeedValue);
+
+        if constexpr (I + 1 < numLayers)
+            initializeLayers<I + 1>(seed);
+    }
+
+    template <size_t I>
+    void feedForward(const Scalar* layerInputs)
+    {
+        std::get<I>(layers).feedForward(layerInputs);
+        if constexpr (I + 1 < numLayers)
+            feedForward<I + 1>(std::get<I>(layers).outputs.data());
+    }
+
+    template <size_t I>
+    void calculateHiddenGradients()
+    {
+        std::get<I>(layers).calculateHiddenGradients(std::get<I + 1>(layers));
+        if constexpr (I > 0)
+            calculateHiddenGradients<I - 1>();
+    }
+
+    template <size_t I>
+    void updateWeights(const Scalar* layerInputs)
+    {
+        std::get<I>(layers).updateWeights(layerInputs, learningRate, I + 1 == numLayers);
+        if constexpr (I + 1 < numLayers)
+            updateWeights<I + 1>(std::get<I>(layers).outputs.data());
+    }
+
+    Scalar learningRate;
+
+    // The inputs of the last forward propagation, for the weight update of the first layer
+    std::array<Scalar, Inputs> inputs;
+
+    LayerTuple layers;
+};
+
+template <size_t Inputs, typename... Layers>
+using StaticNetwork = BasicStaticNetwork<double, Inputs, Layers...>;
+template <size_t Inputs, typename... Layers>
+using StaticNetworkFloat = BasicStaticNetwork<float, Inputs, Layers...>;
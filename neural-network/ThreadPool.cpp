@@ -0,0 +1,173 @@
+﻿#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // The calling thread is one of the threads, so only numThreads - 1 workers are needed
+    for (size_t i = 0; i + 1 < numThreads; i++)
+        queues.push_back(std::make_unique<WorkQueue>());
+
+    for (size_t i = 0; i + 1 < numThreads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::WorkQueue::pushBack(const Task& task)
+{
+    if (count == tasks.size())
+    {
+        // Full, unroll the ring into a bigger buffer
+        std::vector<Task> bigger(std::max<size_t>(16, tasks.size() * 2));
+        for (size_t i = 0; i < count; i++)
+            bigger[i] = tasks[(first + i) % tasks.size()];
+        tasks.swap(bigger);
+        first = 0;
+    }
+
+    tasks[(first + count) % tasks.size()] = task;
+    count++;
+}
+
+bool ThreadPool::WorkQueue::popBack(Task& task)
+{
+    if (count == 0)
+        return false;
+
+    count--;
+    task = tasks[(first + count) % tasks.size()];
+    return true;
+}
+
+bool ThreadPool::WorkQueue::popFront(Task& task)
+{
+    if (count == 0)
+        return false;
+
+    task = tasks[first];
+    first = (first + 1) % tasks.size();
+    count--;
+    return true;
+}
+
+void ThreadPool::runChunks(size_t begin, size_t end, size_t grainSize, ChunkFunction body)
+{
+    if (begin >= end)
+        return;
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    const size_t count = end - begin;
+
+    // Not worth splitting, or nobody to split it with
+    if (workers.empty() || count < 2 * grainSize)
+    {
+        body.call(body.object, begin, end);
+        return;
+    }
+
+    // A few chunks per thread, so threads that finish early have something left to steal
+    const size_t maxChunks = threadCount() * 4;
+    const size_t numChunks = std::min(maxChunks, count / grainSize);
+
+    std::atomic<size_t> remaining{ numChunks };
+
+    // Hand the chunks out round robin, starting at a different queue each call
+    const size_t firstQueue = nextQueue.fetch_add(1, std::memory_order_relaxed);
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        Task task{ body, begin + chunk * count / numChunks, begin + (chunk + 1) * count / numChunks, &remaining };
+
+        WorkQueue& queue = *queues[(firstQueue + chunk) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pushBack(task);
+    }
+
+    {
+        // Taking the lock orders the increment against a worker that is about to go to sleep
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queuedTasks.fetch_add(numChunks);
+    }
+    wakeUp.notify_all();
+
+    // Help out until every chunk has been run. Might run chunks from other parallelFor calls too.
+    Task task;
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (takeTask(firstQueue % queues.size(), task))
+            runTask(task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+bool ThreadPool::takeTask(size_t preferred, Task& task)
+{
+    if (queuedTasks.load(std::memory_order_acquire) == 0)
+        return false;
+
+    {
+        WorkQueue& own = *queues[preferred];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.popBack(task))
+        {
+            queuedTasks.fetch_sub(1);
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        WorkQueue& victim = *queues[(preferred + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.popFront(task))
+        {
+            queuedTasks.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::runTask(const Task& task)
+{
+    task.body.call(task.body.object, task.begin, task.end);
+    task.remaining->fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    Task task;
+    while (true)
+    {
+        if (takeTask(index, task))
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this] { return stopping || queuedTasks.load() > 0; });
+        if (stopping)
+            return;
+    }
+}
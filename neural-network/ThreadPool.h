@@ -0,0 +1,141 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A persistent pool of worker threads with one task queue per worker.
+ * Workers take tasks from the back of their own queue and steal from the front of the other
+ * queues when they run dry, so uneven chunks still keep every core busy. The thread that calls
+ * parallelFor helps with the work until all of it is done, which also makes nested parallelFor
+ * calls from inside a task safe. Once the queues have grown to fit the largest parallelFor,
+ * parallelFor doesn't allocate any memory.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * \param numThreads The total number of threads working on a parallelFor, including the calling
+     * thread. 0 uses one per hardware thread. 1 runs everything on the calling thread.
+     */
+    explicit ThreadPool(size_t numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * \brief Call body(chunkBegin, chunkEnd) for chunks covering [begin, end), spread over the pool,
+     * and return once every chunk is done.
+     * \param grainSize The smallest chunk worth handing to another thread.
+     * \param body Only referenced until parallelFor returns, so it isn't copied.
+     */
+    template <typename Function>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, const Function& body)
+    {
+        runChunks(begin, end, grainSize, ChunkFunction{ &body, &callChunk<Function> });
+    }
+
+    /**
+     * \return The number of threads that work on a parallelFor, including the calling thread.
+     */
+    size_t threadCount() const { return workers.size() + 1; }
+
+    /**
+     * \return The pool shared by the whole program, with one thread per hardware thread.
+     */
+    static ThreadPool& global();
+
+protected:
+    /**
+     * \brief Non-owning reference to the body of a parallelFor. Unlike std::function it never allocates.
+     */
+    struct ChunkFunction
+    {
+        const void* object;
+        void (*call)(const void* object, size_t begin, size_t end);
+    };
+
+    template <typename Function>
+    static void callChunk(const void* object, size_t begin, size_t end)
+    {
+        (*static_cast<const Function*>(object))(begin, end);
+    }
+
+    void runChunks(size_t begin, size_t end, size_t grainSize, ChunkFunction body);
+
+    struct Task
+    {
+        ChunkFunction body;
+        size_t begin;
+        size_t end;
+        std::atomic<size_t>* remaining;
+    };
+
+    /**
+     * \brief Double-ended ring buffer of tasks. Only grows, so a busy queue stops allocating.
+     */
+    struct WorkQueue
+    {
+        void pushBack(const Task& task);
+        bool popBack(Task& task);
+        bool popFront(Task& task);
+
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t first = 0;
+        size_t count = 0;
+    };
+
+    void workerLoop(size_t index);
+
+    /**
+     * \brief Take a task from the back of queue 'preferred', or steal one from the front of any other queue.
+     */
+    bool takeTask(size_t preferred, Task& task);
+
+    static void runTask(const Task& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    // Tasks sitting in the queues, so sleeping workers know when to wake up
+    std::atomic<size_t> queuedTasks{ 0 };
+    std::atomic<size_t> nextQueue{ 0 };
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+};
+
+namespace ParallelWork
+{
+    // Below this many multiply-adds per pass, waking up other threads costs more than it saves
+    constexpr size_t MIN_PARALLEL_WORK = 1 << 15;
+
+    // The smallest chunk, in multiply-adds, worth handing to another thread
+    constexpr size_t MIN_CHUNK_WORK = 1 << 13;
+
+    /**
+     * \brief Call function(first, last) over chunks of [0, count), on threadPool if there is enough work,
+     * otherwise once over the whole range on the calling thread.
+     * \param threadPool Can be nullptr, which runs everything on the calling thread.
+     * \param workPerItem Roughly how many multiply-adds one item in the range costs.
+     */
+    template <typename Function>
+    void forEachChunk(ThreadPool* threadPool, size_t count, size_t workPerItem, const Function& function)
+    {
+        if (threadPool == nullptr || threadPool->threadCount() == 1 || count * workPerItem < MIN_PARALLEL_WORK)
+        {
+            function(0, count);
+            return;
+        }
+
+        threadPool->parallelFor(0, count, std::max<size_t>(1, MIN_CHUNK_WORK / std::max<size_t>(1, workPerItem)), function);
+    }
+}
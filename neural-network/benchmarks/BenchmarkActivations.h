@@ -0,0 +1,223 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../ActivationFunction.h"
+#include "../Kernels.h"
+#include "../NeuralNetwork.h"
+
+/**
+ * \brief Per-activation microbenchmarks. Compares applying the activation one value at a time through the
+ * runtime switch, the compile-time policy loop with libm, and the SIMD polynomial approximations on every
+ * instruction set the CPU supports. Also measures the approximations' maximum error against libm, and the
+ * effect on a whole batched forward pass through the MNIST network.
+ */
+class BenchmarkActivations : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        run<float>("float");
+        run<double>("double");
+    }
+
+protected:
+    // One hidden layer of the MNIST topology over a mini-batch of 128
+    static constexpr size_t NUM_VALUES = 1568 * 128;
+
+    template <typename Scalar>
+    void run(const char* scalarName)
+    {
+        const bool previousApproximate = approximateActivations();
+        const Kernels::Isa previousIsa = Kernels::activeIsa();
+
+        std::cout << "Activation benchmark (" << scalarName << "), " << NUM_VALUES << " values\n";
+
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<Scalar> distribution(-8, 8);
+        std::vector<Scalar> inputs(NUM_VALUES);
+        for (Scalar& input : inputs)
+            input = distribution(generator);
+        std::vector<Scalar> outputs(NUM_VALUES);
+        std::vector<Scalar> activated(NUM_VALUES);
+        std::vector<Scalar> gradients(NUM_VALUES);
+
+        for (ActiviationFunction activationFunction : { Sigmoid, Tanh, ReLU })
+        {
+            std::cout << name(activationFunction) << ":\n";
+
+            const double switchSeconds = BenchmarkUtils::bestOf(5, [&]
+            {
+                for (size_t i = 0; i < NUM_VALUES; i++)
+                    outputs[i] = ::activate(activationFunction, inputs[i]);
+            });
+            report("switch per value", switchSeconds, switchSeconds);
+
+            useApproximateActivations(false);
+            report("policy loop, libm", BenchmarkUtils::bestOf(5, [&] { ::activate(activationFunction, inputs.data(), outputs.data(), NUM_VALUES); }), switchSeconds);
+
+            if (activationFunction != ReLU)
+            {
+                for (Kernels::Isa isa : { Kernels::Isa::Scalar, Kernels::Isa::SSE, Kernels::Isa::AVX2, Kernels::Isa::AVX512 })
+                {
+                    const Kernels::KernelTable<Scalar>* kernels = Kernels::table<Scalar>(isa);
+                    if (kernels == nullptr)
+                        continue;
+
+                    auto approximation = activationFunction == Sigmoid ? kernels->sigmoidApprox : kernels->tanhApprox;
+                    report((std::string("approximation, ") + Kernels::isaName(isa)).c_str(),
+                        BenchmarkUtils::bestOf(5, [&] { approximation(inputs.data(), outputs.data(), NUM_VALUES); }), switchSeconds);
+                }
+            }
+
+            // The derivative is taken of the activated outputs, and the gradients are reset before every run so they stay normal numbers
+            ::activate(activationFunction, inputs.data(), activated.data(), NUM_VALUES);
+            auto resetGradients = [&] { std::fill(gradients.begin(), gradients.end(), Scalar(0.5)); };
+            const double derivativeSwitchSeconds = BenchmarkUtils::bestOf(5, [&]
+            {
+                for (size_t i = 0; i < NUM_VALUES; i++)
+                    gradients[i] *= activateDerivative(activationFunction, activated[i]);
+            }, resetGradients);
+            report("derivative, switch per value", derivativeSwitchSeconds, derivativeSwitchSeconds);
+            report("derivative, policy loop", BenchmarkUtils::bestOf(5, [&] { multiplyByDerivative(activationFunction, activated.data(), gradients.data(), NUM_VALUES); },
+                resetGradients), derivativeSwitchSeconds);
+        }
+
+        std::cout << "exp:\n";
+        const double libmSeconds = BenchmarkUtils::bestOf(5, [&]
+        {
+            for (size_t i = 0; i < NUM_VALUES; i++)
+                outputs[i] = std::exp(inputs[i]);
+        });
+        report("libm", libmSeconds, libmSeconds);
+        for (Kernels::Isa isa : { Kernels::Isa::Scalar, Kernels::Isa::SSE, Kernels::Isa::AVX2, Kernels::Isa::AVX512 })
+        {
+            const Kernels::KernelTable<Scalar>* kernels = Kernels::table<Scalar>(isa);
+            if (kernels != nullptr)
+                report((std::string("approximation, ") + Kernels::isaName(isa)).c_str(),
+                    BenchmarkUtils::bestOf(5, [&] { kernels->expApprox(inputs.data(), outputs.data(), NUM_VALUES); }), libmSeconds);
+        }
+
+        measureErrors<Scalar>();
+        benchmarkForwardPass<Scalar>();
+
+        useApproximateActivations(previousApproximate);
+        Kernels::setIsa(previousIsa);
+    }
+
+    /**
+     * \brief Maximum error of every approximation on every instruction set, against libm in long double.
+     * exp is measured relative to the exact value over its whole input range, sigmoid and tanh absolute
+     * over the range where they aren't saturated yet.
+     */
+    template <typename Scalar>
+    void measureErrors()
+    {
+        const Scalar expRange = sizeof(Scalar) == 4 ? Scalar(87) : Scalar(708);
+        const std::vector<Scalar> expInputs = sweep(-expRange, expRange);
+        const std::vector<Scalar> activationInputs = sweep(Scalar(-40), Scalar(40));
+        std::vector<Scalar> outputs(expInputs.size());
+
+        std::cout << "Maximum error against libm:\n";
+        for (Kernels::Isa isa : { Kernels::Isa::Scalar, Kernels::Isa::SSE, Kernels::Isa::AVX2, Kernels::Isa::AVX512 })
+        {
+            const Kernels::KernelTable<Scalar>* kernels = Kernels::table<Scalar>(isa);
+            if (kernels == nullptr)
+                continue;
+
+            double expError = 0.0;
+            kernels->expApprox(expInputs.data(), outputs.data(), expInputs.size());
+            for (size_t i = 0; i < expInputs.size(); i++)
+            {
+                const long double exact = std::exp((long double)expInputs[i]);
+                expError = std::max(expError, (double)(std::fabs(outputs[i] - exact) / exact));
+            }
+
+            double sigmoidError = 0.0;
+            kernels->sigmoidApprox(activationInputs.data(), outputs.data(), activationInputs.size());
+            for (size_t i = 0; i < activationInputs.size(); i++)
+                sigmoidError = std::max(sigmoidError, (double)std::fabs(outputs[i] - 1 / (1 + std::exp(-(long double)activationInputs[i]))));
+
+            double tanhError = 0.0;
+            kernels->tanhApprox(activationInputs.data(), outputs.data(), activationInputs.size());
+            for (size_t i = 0; i < activationInputs.size(); i++)
+                tanhError = std::max(tanhError, (double)std::fabs(outputs[i] - std::tanh((long double)activationInputs[i])));
+
+            std::cout << "  " << std::setw(8) << Kernels::isaName(isa) << ": " << std::scientific << std::setprecision(2)
+                << "exp " << expError << " relative, sigmoid " << sigmoidError << ", tanh " << tanhError << std::defaultfloat << "\n";
+        }
+    }
+
+    /**
+     * \brief One batched forward pass through the MNIST network, with exact and with approximate activations.
+     */
+    template <typename Scalar>
+    void benchmarkForwardPass()
+    {
+        const size_t batchSize = 128;
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1;
+        BasicNeuralNetwork<Scalar> network(nnInfo);
+
+        const std::vector<std::vector<double>> images = BenchmarkUtils::syntheticImages(batchSize);
+        std::vector<Scalar> inputs;
+        for (const std::vector<double>& image : images)
+            inputs.insert(inputs.end(), image.begin(), image.end());
+        std::vector<Scalar> outputs(batchSize * network.outputSize());
+
+        useApproximateActivations(false);
+        const double exactSeconds = BenchmarkUtils::bestOf(5, [&] { network.predictBatch(inputs.data(), batchSize, outputs.data()); });
+        const std::vector<Scalar> exactOutputs = outputs;
+
+        useApproximateActivations(true);
+        const double approximateSeconds = BenchmarkUtils::bestOf(5, [&] { network.predictBatch(inputs.data(), batchSize, outputs.data()); });
+
+        double maxDifference = 0.0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            maxDifference = std::max(maxDifference, (double)std::fabs(outputs[i] - exactOutputs[i]));
+
+        std::cout << "predictBatch of " << batchSize << " through the MNIST network: " << std::fixed << std::setprecision(2)
+            << exactSeconds * 1000.0 << " ms exact, " << approximateSeconds * 1000.0 << " ms approximate ("
+            << exactSeconds / approximateSeconds << "x), max output difference " << std::scientific << std::setprecision(1)
+            << maxDifference << std::defaultfloat << "\n\n";
+    }
+
+    template <typename Scalar>
+    static std::vector<Scalar> sweep(Scalar from, Scalar to)
+    {
+        const size_t count = 1 << 20;
+        std::vector<Scalar> values(count);
+        for (size_t i = 0; i < count; i++)
+            values[i] = from + (to - from) * (Scalar)i / (Scalar)(count - 1);
+        return values;
+    }
+
+    static void report(const char* variant, double seconds, double baselineSeconds)
+    {
+        std::cout << "  " << std::setw(30) << std::left << variant << std::right << ": " << std::fixed << std::setprecision(2)
+            << std::setw(7) << seconds * 1e9 / NUM_VALUES << " ns/value, " << std::setw(6) << baselineSeconds / seconds << "x"
+            << std::defaultfloat << "\n";
+    }
+
+    static const char* name(ActiviationFunction activationFunction)
+    {
+        switch (activationFunction)
+        {
+        case Sigmoid:
+            return "Sigmoid";
+        case ReLU:
+            return "ReLU";
+        case Tanh:
+            return "Tanh";
+        default:
+            return "Unknown";
+        }
+    }
+};
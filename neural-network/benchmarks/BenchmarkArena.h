@@ -0,0 +1,172 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../AllocationCounter.h"
+#include "../DataParallelTrainer.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Networks with one heap allocation per buffer against networks laid out in arenas, with and without huge pages.
+ * Checks that steady-state training doesn't allocate (train, both trainBatch and the DataParallelTrainer, with SGD and
+ * Adam) and that the arenas sized up front never need another block. Then measures training throughput and how much
+ * resident memory each network adds to the process. Allocations are only counted in builds with NN_COUNT_ALLOCATIONS
+ * (the Debug configurations).
+ */
+class BenchmarkArena : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        checkAllocations();
+        measure("heap", false, false);
+        measure("arena", true, false);
+        measure("arena, huge pages", true, true);
+    }
+
+protected:
+    static constexpr size_t BATCH_SIZE = 32;
+    static constexpr size_t NUM_SAMPLES = 128;
+
+    void checkAllocations()
+    {
+        std::cout << "Allocations per call in steady-state training, 784->128->10";
+        if (!AllocationCounter::enabled())
+            std::cout << " (allocation counting is off, build with NN_COUNT_ALLOCATIONS to count)";
+        std::cout << "\n";
+
+        std::vector<std::vector<double>> inputs, targets;
+        std::vector<double> flatInputs, flatTargets;
+        makeData(inputs, targets, flatInputs, flatTargets);
+
+        std::cout << std::left << std::setw(14) << "network" << std::setw(14) << "construction" << std::setw(8) << "train"
+            << std::setw(12) << "trainBatch" << std::setw(12) << "(pointer)" << std::setw(15) << "data parallel" << "arena blocks\n"
+            << std::right;
+
+        bool allocationFree = true;
+        for (const OptimizerInfo& optimizer : { OptimizerInfo::sgd(), OptimizerInfo::adam() })
+        {
+            for (bool useArena : { false, true })
+            {
+                NNConstructionInfo nnInfo(28 * 28, LayerInfo(10, 0.05, Softmax));
+                nnInfo.addHiddenLayer(LayerInfo(128, 0.05, ReLU));
+                nnInfo.seed = 1234;
+                nnInfo.optimizer = optimizer;
+                nnInfo.useArena = useArena;
+                nnInfo.maxBatchSize = BATCH_SIZE;
+
+                size_t allocations = AllocationCounter::allocations();
+                NeuralNetwork network(nnInfo);
+                const size_t construction = AllocationCounter::allocations() - allocations;
+                DataParallelTrainer<double> trainer(network, 2);
+
+                const size_t train = countAllocations([&] { network.train(inputs, targets); });
+                const size_t trainBatch = countAllocations([&] { network.trainBatch(inputs, targets, BATCH_SIZE); });
+                const size_t trainBatchPointer = countAllocations([&]
+                {
+                    for (size_t first = 0; first + BATCH_SIZE <= NUM_SAMPLES; first += BATCH_SIZE)
+                        network.trainBatch(flatInputs.data() + first * network.inputSize(), flatTargets.data() + first * network.outputSize(), BATCH_SIZE);
+                });
+                const size_t dataParallel = countAllocations([&] { trainer.train(inputs, targets, BATCH_SIZE); });
+
+                std::cout << std::left << std::setw(14) << (std::string(optimizer.type == SGD ? "SGD" : "Adam") + (useArena ? ", arena" : ", heap"))
+                    << std::setw(14) << construction << std::setw(8) << train << std::setw(12) << trainBatch << std::setw(12) << trainBatchPointer
+                    << std::setw(15) << dataParallel;
+                if (useArena)
+                    std::cout << network.memoryArena()->blockCount() << " + " << network.batchArena()->blockCount();
+                else
+                    std::cout << "-";
+                std::cout << std::right << "\n";
+
+                allocationFree = allocationFree && train == 0 && trainBatch == 0 && trainBatchPointer == 0 && dataParallel == 0;
+                if (useArena)
+                    allocationFree = allocationFree && network.memoryArena()->blockCount() == 1 && network.batchArena()->blockCount() == 1;
+            }
+        }
+
+        if (!allocationFree)
+            std::cout << "FAILED: steady-state training allocated, or an arena needed another block\n";
+        std::cout << "\n";
+    }
+
+    /**
+     * \brief Train the MNIST network with Adam, and report the throughput of trainBatch and train, and how much the
+     * resident memory of the process grew from building and training it.
+     */
+    void measure(const char* name, bool useArena, bool hugePages)
+    {
+        std::vector<std::vector<double>> inputs, targets;
+        std::vector<double> flatInputs, flatTargets;
+        makeData(inputs, targets, flatInputs, flatTargets);
+
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        nnInfo.optimizer = OptimizerInfo::adam();
+        nnInfo.useArena = useArena;
+        nnInfo.hugePages = hugePages;
+        nnInfo.maxBatchSize = BATCH_SIZE;
+
+        const size_t residentBefore = AllocationCounter::residentBytes();
+        Timer timer;
+        timer.Start();
+        NeuralNetwork network(nnInfo);
+        const double constructionSeconds = timer.Stop();
+
+        const double batchSeconds = BenchmarkUtils::bestOf(3, [&]
+        {
+            for (size_t first = 0; first + BATCH_SIZE <= NUM_SAMPLES; first += BATCH_SIZE)
+                network.trainBatch(flatInputs.data() + first * network.inputSize(), flatTargets.data() + first * network.outputSize(), BATCH_SIZE);
+        });
+        const std::vector<std::vector<double>> sampleInputs(inputs.begin(), inputs.begin() + BATCH_SIZE);
+        const std::vector<std::vector<double>> sampleTargets(targets.begin(), targets.begin() + BATCH_SIZE);
+        const double sampleSeconds = BenchmarkUtils::bestOf(3, [&] { network.train(sampleInputs, sampleTargets); });
+        const size_t residentAfter = AllocationCounter::residentBytes();
+
+        std::cout << std::setw(18) << name << ": " << std::fixed << std::setprecision(2) << constructionSeconds * 1000.0 << " ms to build, "
+            << std::setprecision(0) << (double)NUM_SAMPLES / batchSeconds << " samples/s in batches of " << BATCH_SIZE << ", "
+            << (double)BATCH_SIZE / sampleSeconds << " samples/s one at a time, resident memory +" << std::setprecision(1)
+            << (double)(residentAfter - std::min(residentAfter, residentBefore)) / (1 << 20) << " MB";
+        if (useArena)
+        {
+            std::cout << " (arenas " << (double)(network.memoryArena()->bytesReserved() + network.batchArena()->bytesReserved()) / (1 << 20) << " MB";
+            if (hugePages)
+                std::cout << (network.memoryArena()->usesHugePages() ? ", huge pages" : ", no huge pages");
+            std::cout << ")";
+        }
+        std::cout << std::defaultfloat << "\n";
+    }
+
+    static void makeData(std::vector<std::vector<double>>& inputs, std::vector<std::vector<double>>& targets,
+        std::vector<double>& flatInputs, std::vector<double>& flatTargets)
+    {
+        inputs = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        targets.assign(NUM_SAMPLES, std::vector<double>(10, 0.0));
+        flatInputs.clear();
+        flatTargets.clear();
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            targets[i][i % 10] = 1.0;
+            flatInputs.insert(flatInputs.end(), inputs[i].begin(), inputs[i].end());
+            flatTargets.insert(flatTargets.end(), targets[i].begin(), targets[i].end());
+        }
+    }
+
+    /**
+     * \brief Allocations of one call, after a first call to warm up.
+     */
+    template <typename Function>
+    static size_t countAllocations(const Function& function)
+    {
+        function();
+        const size_t before = AllocationCounter::allocations();
+        function();
+        return AllocationCounter::allocations() - before;
+    }
+};
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+#include "../ThreadPool.h"
+#include "../Timer.h"
+
+/**
+ * \brief Inference throughput of predictBatch against one predict per sample, for a range of batch
+ * sizes, on MNIST-shaped images and the MNIST topology. Also checks that both give the same outputs.
+ */
+class BenchmarkBatchPredict : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        NeuralNetwork network(nnInfo);
+
+        // One contiguous NUM_SAMPLES x 784 matrix, the way predictBatch wants it
+        const auto images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        std::vector<double> inputs;
+        inputs.reserve(NUM_SAMPLES * network.inputSize());
+        for (const auto& image : images)
+            inputs.insert(inputs.end(), image.begin(), image.end());
+
+        std::cout << "Batch predict benchmark, " << NUM_SAMPLES << " samples of 784->1568->1568->784->10, "
+            << ThreadPool::global().threadCount() << " threads\n";
+
+        std::vector<double> expected(NUM_SAMPLES * network.outputSize());
+        Timer timer;
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+            network.predict(inputs.data() + i * network.inputSize(), expected.data() + i * network.outputSize());
+        const double perSample = NUM_SAMPLES / timer.Stop();
+        std::cout << std::left << std::setw(20) << "predict:" << perSample << " samples/sec\n";
+
+        std::vector<double> outputs(NUM_SAMPLES * network.outputSize());
+        for (size_t batchSize : { 1, 2, 4, 8, 16, 32, 64, 128, 256 })
+        {
+            timer.Start();
+            for (size_t first = 0; first < NUM_SAMPLES; first += batchSize)
+            {
+                const size_t count = std::min(batchSize, NUM_SAMPLES - first);
+                network.predictBatch(inputs.data() + first * network.inputSize(), count, outputs.data() + first * network.outputSize());
+            }
+            const double batched = NUM_SAMPLES / timer.Stop();
+
+            double maxDifference = 0.0;
+            for (size_t i = 0; i < outputs.size(); i++)
+                maxDifference = std::max(maxDifference, std::abs(outputs[i] - expected[i]));
+
+            std::cout << std::left << std::setw(20) << "predictBatch(" + std::to_string(batchSize) + "):" << std::setw(14) << batched
+                << "samples/sec (" << batched / perSample << "x), max difference " << maxDifference << "\n";
+        }
+    }
+
+protected:
+    const size_t NUM_SAMPLES = 2048;
+};
@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../Checkpoint.h"
+#include "../MappedNetwork.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Saves the MNIST network, then checks that loading it back (copied and memory-mapped) gives exactly
+ * the same topology, weights and predictions. Times how long each way takes to get to the first prediction,
+ * against building a fresh network.
+ */
+class BenchmarkCheckpoint : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        const auto images = BenchmarkUtils::syntheticImages(1);
+
+        std::cout << "Checkpoint benchmark, 784->1568->1568->784->10\n";
+
+        Timer timer;
+        NeuralNetwork network(nnInfo);
+        std::cout << "construct:         " << timer.Stop() * 1000 << " ms\n";
+
+        timer.Start();
+        if (!Checkpoint::save(network, CHECKPOINT_PATH))
+            return;
+        std::cout << "save:              " << timer.Stop() * 1000 << " ms\n";
+
+        timer.Start();
+        std::optional<NeuralNetwork> loaded = Checkpoint::load<double>(CHECKPOINT_PATH);
+        std::cout << "load:              " << timer.Stop() * 1000 << " ms\n";
+
+        timer.Start();
+        MappedNetwork<double> mapped(CHECKPOINT_PATH);
+        std::cout << "map:               " << timer.Stop() * 1000 << " ms\n";
+
+        timer.Start();
+        const std::vector<double> mappedOutput = mapped.predict(images[0]);
+        std::cout << "first mapped predict: " << timer.Stop() * 1000 << " ms (pages the weights in)\n";
+
+        timer.Start();
+        mapped.predict(images[0]);
+        std::cout << "next mapped predict:  " << timer.Stop() * 1000 << " ms\n";
+
+        // Round trip: everything has to come back bit for bit. The input layer only has a size.
+        bool identical = loaded.has_value() && mapped.isOpen() && loaded->layers().size() == network.layers().size()
+            && loaded->inputSize() == network.inputSize() && mapped.inputSize() == network.inputSize();
+        for (size_t i = 1; identical && i < network.layers().size(); i++)
+        {
+            const NetworkLayer<double>& original = network.layers()[i];
+            const NetworkLayer<double>& copy = loaded->layers()[i];
+            identical = original.numNeurons == copy.numNeurons && original.numInputs == copy.numInputs
+                && original.learningRate == copy.learningRate && original.activationFunction == copy.activationFunction
+                && original.weights == copy.weights && original.biases == copy.biases
+                && mapped.topology[i].numNeurons == original.numNeurons;
+        }
+
+        // MappedNetwork always runs the dense first layer. The sparse one sums in another order, so it would
+        // only match within rounding.
+        network.setSparseInputThreshold(0.0);
+        const std::vector<double> expected = network.predict(images[0]);
+        if (identical)
+            loaded->setSparseInputThreshold(0.0);
+        identical = identical && loaded->predict(images[0]) == expected && mappedOutput == expected;
+        std::cout << "Round trip is " << (identical ? "identical" : "DIFFERENT") << "\n";
+
+        // Loading into the other precision converts the values
+        std::optional<NeuralNetworkFloat> converted = Checkpoint::load<float>(CHECKPOINT_PATH);
+        std::cout << "Loaded as float: " << (converted.has_value() ? "ok" : "FAILED") << "\n";
+
+        std::remove(CHECKPOINT_PATH);
+    }
+
+protected:
+    const char* CHECKPOINT_PATH = "benchmark_checkpoint.nnck";
+};
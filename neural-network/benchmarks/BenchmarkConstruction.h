@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+
+/**
+ * \brief Construction time of networks with millions of weights, in float and double, against filling
+ * the same number of weights one after the other from a std::mt19937 (how the layers used to be initialized).
+ * Also checks that two networks built from the same seed are identical.
+ */
+class BenchmarkConstruction : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo wide(1024, LayerInfo(10, 0.05, Sigmoid, XavierInit));
+        wide.addHiddenLayer(LayerInfo(4096, 0.05, ReLU, HeInit));
+        wide.addHiddenLayer(LayerInfo(4096, 0.05, ReLU, HeInit));
+        wide.addHiddenLayer(LayerInfo(1024, 0.05, ReLU, HeInit));
+
+        std::cout << "Construction benchmark\n";
+        run<double>("MNIST 784->1568->1568->784->10, double", BenchmarkUtils::mnistTopology());
+        run<float>("MNIST 784->1568->1568->784->10, float", BenchmarkUtils::mnistTopology());
+        run<double>("1024->4096->4096->1024->10, double", wide);
+        run<float>("1024->4096->4096->1024->10, float", wide);
+        std::cout << "\n";
+    }
+
+protected:
+    template <typename Scalar>
+    void run(const char* name, NNConstructionInfo nnInfo)
+    {
+        nnInfo.seed = 1234;
+
+        size_t numWeights = 0;
+        for (size_t i = 1; i < nnInfo.topology.size(); i++)
+            numWeights += nnInfo.topology[i].numNeurons * nnInfo.topology[i - 1].numNeurons;
+
+        // Both timed cold, without a warm-up run, like a program building its network once
+        const double constructionSeconds = BenchmarkUtils::bestOf(3, [&] { BasicNeuralNetwork<Scalar> network(nnInfo); }, [] {}, false);
+
+        // The same number of weights from one generator, in one contiguous array
+        const double mersenneSeconds = BenchmarkUtils::bestOf(3, [&]
+        {
+            std::mt19937 generator(nnInfo.seed);
+            std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+            std::vector<Scalar> weights(numWeights);
+            for (Scalar& weight : weights)
+                weight = (Scalar)distribution(generator);
+        }, [] {}, false);
+
+        const BasicNeuralNetwork<Scalar> first(nnInfo);
+        const BasicNeuralNetwork<Scalar> second(nnInfo);
+        bool identical = true;
+        for (size_t i = 0; i < first.layers().size(); i++)
+            identical = identical && first.layers()[i].weights == second.layers()[i].weights && first.layers()[i].biases == second.layers()[i].biases;
+
+        std::cout << name << ", " << std::fixed << std::setprecision(1) << numWeights / 1e6 << "M weights: "
+            << std::setprecision(2) << constructionSeconds * 1000.0 << " ms (" << numWeights / constructionSeconds / 1e6
+            << "M weights/sec), serial mt19937 fill " << mersenneSeconds * 1000.0 << " ms (" << mersenneSeconds / constructionSeconds
+            << "x), same seed " << (identical ? "identical" : "DIFFERENT") << std::defaultfloat << "\n";
+    }
+};
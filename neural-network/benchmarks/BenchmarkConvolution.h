@@ -0,0 +1,164 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BenchmarkTimeToAccuracy.h"
+#include "../Convolution.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Trains the all-dense MNIST network and a small convolutional network on the same digits, one pass with
+ * batches of 32, and compares the test accuracy they reach against what they cost: FLOPs per prediction and training
+ * time per sample. Then times the convolutional network's 3x3 layers with the direct kernels and with im2col + GEMM.
+ * Uses MNIST or the prototype digits, the same way as BenchmarkTimeToAccuracy.
+ */
+class BenchmarkConvolution : public BenchmarkTimeToAccuracy
+{
+public:
+    void Start() override
+    {
+        if (!loadMnist())
+            makePrototypeDigits();
+
+        std::cout << "Convolution benchmark, " << NUM_SAMPLES << " training samples in batches of " << BATCH_SIZE << ", "
+            << testLabels.size() << " test images\n";
+
+        NNConstructionInfo denseInfo = BenchmarkUtils::mnistTopology();
+        denseInfo.topology.back().activationFunction = Softmax;
+        denseInfo.seed = 1234;
+
+        const double denseAccuracy = run("784-1568-1568-784-10", denseInfo, denseFlops);
+        const double convolutionAccuracy = run("conv8-pool-conv16-pool-10", convolutionalTopology(), convolutionFlops);
+        std::cout << "The convolutional network needs " << std::fixed << std::setprecision(1) << denseFlops / convolutionFlops
+            << "x fewer FLOPs per prediction, for " << std::showpos << 100.0 * (convolutionAccuracy - denseAccuracy)
+            << std::noshowpos << " points of accuracy" << std::defaultfloat << "\n";
+
+        compareKernels();
+        std::cout << "\n";
+    }
+
+protected:
+    static constexpr size_t NUM_SAMPLES = 4000;
+
+    /**
+     * \brief 28x28 -> 8 3x3 filters -> 2x2 max pool -> 16 3x3 filters -> 2x2 max pool -> 10 softmax outputs.
+     */
+    static NNConstructionInfo convolutionalTopology()
+    {
+        NNConstructionInfo nnInfo(LayerInfo::image(28, 28), LayerInfo(10, 0.05, Softmax, XavierInit));
+        nnInfo.addHiddenLayer(LayerInfo::conv2D(8, 3, 0.05, ReLU, HeInit, 1, 1));
+        nnInfo.addHiddenLayer(LayerInfo::maxPool(2));
+        nnInfo.addHiddenLayer(LayerInfo::conv2D(16, 3, 0.05, ReLU, HeInit, 1, 1));
+        nnInfo.addHiddenLayer(LayerInfo::maxPool(2));
+        nnInfo.seed = 1234;
+        return nnInfo;
+    }
+
+    /**
+     * \return FLOPs of one prediction: 2 per multiply-add, 1 per MaxPool comparison.
+     */
+    static double predictionFlops(const NeuralNetwork& network)
+    {
+        double flops = 0.0;
+        for (const NetworkLayer<double>& layer : network.layers())
+            flops += (layer.type == MaxPool ? 1.0 : 2.0) * layer.multiplyAdds();
+        return flops;
+    }
+
+    /**
+     * \brief Train one pass over the first NUM_SAMPLES digits and test.
+     * \param flops Receives the FLOPs per prediction.
+     * \return The test accuracy.
+     */
+    double run(const char* name, const NNConstructionInfo& nnInfo, double& flops)
+    {
+        NeuralNetwork network(nnInfo);
+        flops = predictionFlops(network);
+
+        size_t numWeights = 0;
+        for (const NetworkLayer<double>& layer : network.layers())
+            numWeights += layer.weights.size() + (layer.type == Dense && &layer == &network.layers().front() ? 0 : layer.biases.size());
+
+        const double seconds = train(network);
+        double accuracy, confidence;
+        test(network, accuracy, confidence);
+
+        // The backward pass costs about twice the forward pass, once for the gradients and once for the weights
+        std::cout << std::setw(26) << name << ": " << numWeights << " weights, " << std::fixed << std::setprecision(2)
+            << flops / 1e6 << " MFLOP per prediction, " << 1e3 * seconds / NUM_SAMPLES << " ms per training sample ("
+            << 3.0 * flops * NUM_SAMPLES / seconds / 1e9 << " GFLOP/s), test accuracy " << std::setprecision(1) << 100.0 * accuracy
+            << "%, " << std::setprecision(2) << 100.0 * accuracy / (flops / 1e6) << "% per MFLOP" << std::defaultfloat << "\n";
+        return accuracy;
+    }
+
+    /**
+     * \return The seconds spent in trainBatch.
+     */
+    double train(NeuralNetwork& network)
+    {
+        const size_t numBatches = std::min(NUM_SAMPLES, trainingLabels.size()) / BATCH_SIZE;
+        std::vector<double> targets(BATCH_SIZE * 10);
+
+        Timer timer;
+        double seconds = 0.0;
+        for (size_t batch = 0; batch < numBatches; batch++)
+        {
+            std::fill(targets.begin(), targets.end(), 0.0);
+            for (size_t b = 0; b < BATCH_SIZE; b++)
+                targets[b * 10 + trainingLabels[batch * BATCH_SIZE + b]] = 1.0;
+
+            timer.Start();
+            network.trainBatch(trainingImages.data() + batch * BATCH_SIZE * PIXELS, targets.data(), BATCH_SIZE);
+            seconds += timer.Stop();
+        }
+        return seconds;
+    }
+
+    /**
+     * \brief Training and prediction time of the convolutional network with the direct 3x3 kernels, where they
+     * apply (the first layer, on 1 channel), and with im2col + GEMM everywhere. Best of a few repetitions.
+     */
+    void compareKernels()
+    {
+        const bool previousDirect = Convolution::directConvolution();
+        const size_t numBatches = 10;
+        std::vector<double> targets(BATCH_SIZE * 10, 0.1);
+        std::vector<double> outputs(BATCH_SIZE * 10);
+
+        for (bool direct : { true, false })
+        {
+            Convolution::useDirectConvolution(direct);
+            NeuralNetwork network(convolutionalTopology());
+
+            double trainingSeconds = 1e30;
+            double predictionSeconds = 1e30;
+            Timer timer;
+            for (int repetition = 0; repetition < 5; repetition++)
+            {
+                timer.Start();
+                for (size_t batch = 0; batch < numBatches; batch++)
+                    network.trainBatch(trainingImages.data() + batch * BATCH_SIZE * PIXELS, targets.data(), BATCH_SIZE);
+                trainingSeconds = std::min(trainingSeconds, timer.Stop());
+
+                timer.Start();
+                for (size_t batch = 0; batch < numBatches; batch++)
+                    network.predictBatch(trainingImages.data() + batch * BATCH_SIZE * PIXELS, BATCH_SIZE, outputs.data());
+                predictionSeconds = std::min(predictionSeconds, timer.Stop());
+            }
+
+            std::cout << std::setw(26) << (direct ? "direct 3x3 kernels" : "im2col + GEMM") << ": " << std::fixed << std::setprecision(1)
+                << 1e6 * trainingSeconds / (numBatches * BATCH_SIZE) << " us per training sample, "
+                << 1e6 * predictionSeconds / (numBatches * BATCH_SIZE) << " us per prediction" << std::defaultfloat << "\n";
+        }
+
+        Convolution::useDirectConvolution(previousDirect);
+    }
+
+    double denseFlops = 0.0;
+    double convolutionFlops = 0.0;
+};
@@ -0,0 +1,137 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../BatchPrefetcher.h"
+#include "../IdxFile.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Writes an MNIST-sized IDX training set to disk, then times opening it, and how much of a training
+ * run on the MNIST topology goes to preparing batches: on the training thread, and with BatchPrefetcher.
+ */
+class BenchmarkDataLoading : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        writeDataset();
+
+        std::cout << "Data loading benchmark, " << NUM_IMAGES << " 28x28 images, training on " << NUM_TRAINED
+            << " of them in batches of " << BATCH_SIZE << "\n";
+
+        Timer timer;
+        const IdxFile images(IMAGES_PATH);
+        const IdxFile labels(LABELS_PATH);
+        std::cout << "Opening the files took " << timer.Stop() * 1000 << " ms\n";
+
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+
+        // Batches prepared on the training thread, between training steps
+        {
+            NeuralNetwork network(nnInfo);
+            std::vector<double> inputs(BATCH_SIZE * images.itemSize());
+            std::vector<double> targets(BATCH_SIZE * 10);
+            std::mt19937 generator(1);
+            std::uniform_int_distribution<size_t> sample(0, NUM_IMAGES - 1);
+
+            double preparing = 0.0;
+            Timer total;
+            for (size_t first = 0; first < NUM_TRAINED; first += BATCH_SIZE)
+            {
+                timer.Start();
+                std::fill(targets.begin(), targets.end(), 0.0);
+                for (size_t b = 0; b < BATCH_SIZE; b++)
+                {
+                    const size_t index = sample(generator);
+                    const IdxFile::Span image = images.item(index);
+                    for (size_t k = 0; k < image.size; k++)
+                        inputs[b * image.size + k] = image[k] / 255.0;
+                    targets[b * 10 + labels.item(index)[0]] = 1.0;
+                }
+                preparing += timer.Stop();
+
+                network.trainBatch(inputs.data(), targets.data(), BATCH_SIZE);
+            }
+            report("inline:    ", total.Stop(), preparing);
+        }
+
+        // Batches prepared by the background thread while the previous one trains
+        {
+            NeuralNetwork network(nnInfo);
+            BatchPrefetcher<double> batches(images, labels, BATCH_SIZE, 10, 0, 1);
+
+            double waiting = 0.0;
+            Timer total;
+            for (size_t first = 0; first < NUM_TRAINED; first += BATCH_SIZE)
+            {
+                timer.Start();
+                const BatchPrefetcher<double>::Batch batch = batches.next();
+                waiting += timer.Stop();
+
+                network.trainBatch(batch.inputs, batch.targetOutputs, batch.size);
+            }
+            report("prefetched:", total.Stop(), waiting);
+        }
+
+        std::remove(IMAGES_PATH);
+        std::remove(LABELS_PATH);
+    }
+
+protected:
+    void report(const char* name, double seconds, double dataSeconds)
+    {
+        std::cout << name << " " << NUM_TRAINED / seconds << " samples/sec, " << dataSeconds * 1000 << " ms ("
+            << 100.0 * dataSeconds / seconds << "%) of the training thread spent on data\n";
+    }
+
+    /**
+     * \brief Write the synthetic images and labels in the same IDX layout as the real MNIST files.
+     */
+    void writeDataset()
+    {
+        const auto images = BenchmarkUtils::syntheticImages(NUM_IMAGES);
+        const auto labels = BenchmarkUtils::syntheticLabels(NUM_IMAGES);
+
+        std::ofstream imageFile(IMAGES_PATH, std::ios::binary);
+        writeHeader(imageFile, 0x803, { (uint32_t)NUM_IMAGES, 28, 28 });
+        std::vector<char> pixels(28 * 28);
+        for (const std::vector<double>& image : images)
+        {
+            for (size_t k = 0; k < pixels.size(); k++)
+                pixels[k] = (char)(uint8_t)(image[k] * 255.0);
+            imageFile.write(pixels.data(), pixels.size());
+        }
+
+        std::ofstream labelFile(LABELS_PATH, std::ios::binary);
+        writeHeader(labelFile, 0x801, { (uint32_t)NUM_IMAGES });
+        for (const std::vector<double>& label : labels)
+            labelFile.put((char)(std::max_element(label.begin(), label.end()) - label.begin()));
+    }
+
+    static void writeHeader(std::ofstream& file, uint32_t magic, std::vector<uint32_t> dimensions)
+    {
+        // Big-endian, like every IDX file
+        dimensions.insert(dimensions.begin(), magic);
+        for (uint32_t value : dimensions)
+        {
+            const char bytes[4] = { (char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char)value };
+            file.write(bytes, 4);
+        }
+    }
+
+    const size_t NUM_IMAGES = 60000;
+    const size_t NUM_TRAINED = 1024;
+    const size_t BATCH_SIZE = 32;
+    const char* IMAGES_PATH = "benchmark-images-idx3-ubyte";
+    const char* LABELS_PATH = "benchmark-labels-idx1-ubyte";
+};
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../DataParallelTrainer.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Training throughput of DataParallelTrainer from 1 thread up to one per hardware thread,
+ * on the MNIST topology. Also checks that two runs with the same seed and thread count end up
+ * with exactly the same network.
+ */
+class BenchmarkDataParallel : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+
+        const auto images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        const auto labels = BenchmarkUtils::syntheticLabels(NUM_SAMPLES);
+        const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::cout << "Data parallel benchmark, " << NUM_SAMPLES << " samples of 784->1568->1568->784->10, batch size "
+            << BATCH_SIZE << ", up to " << maxThreads << " threads\n";
+
+        // 1, 2, 4, ... and the hardware thread count itself
+        std::vector<size_t> threadCounts;
+        for (size_t threads = 1; threads < maxThreads; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(maxThreads);
+
+        double singleThreaded = 0.0;
+        for (size_t threads : threadCounts)
+        {
+            NeuralNetwork network(nnInfo);
+            DataParallelTrainer trainer(network, threads);
+
+            Timer timer;
+            trainer.train(images, labels, BATCH_SIZE);
+            const double samplesPerSecond = NUM_SAMPLES / timer.Stop();
+            if (threads == 1)
+                singleThreaded = samplesPerSecond;
+
+            std::cout << threads << " threads: " << samplesPerSecond << " samples/sec ("
+                << samplesPerSecond / singleThreaded << "x)\n";
+        }
+
+        // Determinism: same seed and thread count has to give bit-identical results
+        NeuralNetwork first(nnInfo);
+        NeuralNetwork second(nnInfo);
+        DataParallelTrainer(first, maxThreads).train(images, labels, BATCH_SIZE);
+        DataParallelTrainer(second, maxThreads).train(images, labels, BATCH_SIZE);
+
+        const bool identical = first.predict(images[0]) == second.predict(images[0]);
+        std::cout << "Two runs with " << maxThreads << " threads are " << (identical ? "identical" : "DIFFERENT") << "\n";
+    }
+
+protected:
+    const size_t NUM_SAMPLES = 512;
+    const size_t BATCH_SIZE = 64;
+};
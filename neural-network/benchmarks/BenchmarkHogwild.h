@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../HogwildTrainer.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Trains the MNIST network for one pass over the prototype digits with the single-threaded train,
+ * and with HogwildTrainer from 1 thread up to one per hardware thread, all from the same seed.
+ * Reports the throughput of each, and the test accuracy and loss they reach, to show what the lost updates cost.
+ */
+class BenchmarkHogwild : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        BenchmarkUtils::PrototypeDigits digits;
+        std::vector<double> pixels;
+        std::vector<uint8_t> labels;
+        digits.generate(NUM_TRAINING, pixels, labels);
+        toSamples(pixels, labels, trainingImages, trainingTargets);
+        digits.generate(NUM_TEST, testImages, testLabels);
+
+        const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << "Hogwild benchmark, " << NUM_TRAINING << " samples of 784->1568->1568->784->10 (softmax), "
+            << NUM_TEST << " test images, up to " << maxThreads << " threads\n";
+
+        NeuralNetwork baseline(constructionInfo());
+        Timer timer;
+        baseline.train(trainingImages, trainingTargets);
+        const double baselineSeconds = timer.Stop();
+        report("train", baselineSeconds, baselineSeconds, baseline);
+
+        // 1, 2, 4, ... and the hardware thread count itself
+        std::vector<size_t> threadCounts;
+        for (size_t threads = 1; threads < maxThreads; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(maxThreads);
+
+        for (size_t threads : threadCounts)
+        {
+            NeuralNetwork network(constructionInfo());
+            HogwildTrainer trainer(network, threads);
+
+            timer.Start();
+            trainer.train(trainingImages, trainingTargets);
+            const double seconds = timer.Stop();
+            report(("hogwild, " + std::to_string(threads) + " threads").c_str(), seconds, baselineSeconds, network);
+        }
+        std::cout << "\n";
+    }
+
+protected:
+    static constexpr size_t NUM_TRAINING = 2000;
+    static constexpr size_t NUM_TEST = 1000;
+
+    static NNConstructionInfo constructionInfo()
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.topology.back().activationFunction = Softmax;
+        nnInfo.seed = 1234;
+        return nnInfo;
+    }
+
+    void report(const char* name, double seconds, double baselineSeconds, NeuralNetwork& network)
+    {
+        std::vector<double> outputs(NUM_TEST * 10);
+        network.predictBatch(testImages.data(), NUM_TEST, outputs.data());
+
+        // Accuracy and cross-entropy on the test set
+        size_t correct = 0;
+        double loss = 0.0;
+        for (size_t i = 0; i < NUM_TEST; i++)
+        {
+            const double* result = outputs.data() + i * 10;
+            if ((size_t)(std::max_element(result, result + 10) - result) == testLabels[i])
+                correct++;
+            loss -= std::log(std::max(result[testLabels[i]], 1e-12));
+        }
+
+        std::cout << std::setw(20) << name << ": " << std::fixed << std::setprecision(0) << std::setw(6) << NUM_TRAINING / seconds
+            << " samples/sec (" << std::setprecision(2) << baselineSeconds / seconds << "x), test accuracy "
+            << std::setprecision(1) << 100.0 * correct / NUM_TEST << "%, test loss " << std::setprecision(4)
+            << loss / NUM_TEST << std::defaultfloat << "\n";
+    }
+
+    static void toSamples(const std::vector<double>& pixels, const std::vector<uint8_t>& labels,
+        std::vector<std::vector<double>>& images, std::vector<std::vector<double>>& targets)
+    {
+        const size_t size = BenchmarkUtils::PrototypeDigits::PIXELS;
+        images.resize(labels.size());
+        targets.assign(labels.size(), std::vector<double>(10, 0.0));
+        for (size_t i = 0; i < labels.size(); i++)
+        {
+            images[i].assign(pixels.begin() + i * size, pixels.begin() + (i + 1) * size);
+            targets[i][labels[i]] = 1.0;
+        }
+    }
+
+    std::vector<std::vector<double>> trainingImages;
+    std::vector<std::vector<double>> trainingTargets;
+    std::vector<double> testImages;
+    std::vector<uint8_t> testLabels;
+};
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "LoadGenerator.h"
+#include "../InferenceServer.h"
+#include "../NeuralNetwork.h"
+
+/**
+ * \brief Serves the MNIST network (float) from an InferenceServer, and loads it with many clients that
+ * each send one image per request. Compares turning batching off against a few batch size and wait
+ * time limits, by throughput, client-side p50/p99 latency and the batch sizes the server ended up with.
+ */
+class BenchmarkInferenceServer : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        NeuralNetworkFloat network(nnInfo);
+
+        std::vector<float> inputs;
+        for (const std::vector<double>& image : BenchmarkUtils::syntheticImages(NUM_IMAGES))
+            inputs.insert(inputs.end(), image.begin(), image.end());
+
+        std::cout << "Inference server benchmark, " << NUM_CLIENTS << " clients sending one image per request for "
+            << SECONDS << " seconds per policy\n";
+
+        if (!checkOutputs(network, inputs))
+            return;
+
+        struct Policy { size_t maxBatchSize; long long maxWaitMicroseconds; };
+        for (const Policy& policy : { Policy{ 1, 0 }, Policy{ 8, 200 }, Policy{ 32, 500 }, Policy{ 64, 2000 } })
+        {
+            InferenceServer<float> server(network, policy.maxBatchSize, std::chrono::microseconds(policy.maxWaitMicroseconds));
+            if (!server.start(SOCKET_PATH))
+                return;
+
+            const LoadGenerator::Result result = LoadGenerator(SOCKET_PATH, inputs).run(NUM_CLIENTS, SECONDS);
+            const InferenceServerStats stats = server.stats();
+            server.stop();
+
+            std::cout << "max batch " << std::setw(2) << policy.maxBatchSize << ", max wait " << std::setw(4) << policy.maxWaitMicroseconds
+                << " us: " << std::fixed << std::setprecision(0) << std::setw(6) << result.requestsPerSecond() << " requests/sec, latency p50 "
+                << std::setprecision(2) << result.p50Latency * 1000.0 << " ms, p99 " << result.p99Latency * 1000.0 << " ms (server p50 "
+                << stats.p50Latency * 1000.0 << " ms, p99 " << stats.p99Latency * 1000.0 << " ms), mean batch " << std::setprecision(1)
+                << stats.meanBatchSize() << std::defaultfloat;
+            if (result.failures > 0)
+                std::cout << ", " << result.failures << " FAILED clients";
+            std::cout << "\n";
+        }
+        std::cout << "\n";
+    }
+
+protected:
+    static constexpr size_t NUM_IMAGES = 256;
+    static constexpr size_t NUM_CLIENTS = 32;
+    static constexpr double SECONDS = 2.0;
+    const std::string SOCKET_PATH = "nn-inference.sock";
+
+    /**
+     * \brief A round trip through the server has to give the same outputs as predicting in process.
+     */
+    bool checkOutputs(NeuralNetworkFloat& network, const std::vector<float>& inputs)
+    {
+        std::vector<float> expected(network.outputSize());
+        network.predict(inputs.data(), expected.data());
+
+        InferenceServer<float> server(network);
+        InferenceClient client;
+        std::vector<float> outputs(network.outputSize());
+        if (!server.start(SOCKET_PATH) || !client.connect(SOCKET_PATH) || !client.predict(inputs.data(), 1, outputs.data()))
+        {
+            std::cout << "Couldn't reach the server on " << SOCKET_PATH << "\n";
+            return false;
+        }
+
+        float maxDifference = 0.0f;
+        for (size_t i = 0; i < outputs.size(); i++)
+            maxDifference = std::max(maxDifference, std::fabs(outputs[i] - expected[i]));
+        std::cout << "Max difference from predict: " << maxDifference << "\n";
+        return true;
+    }
+};
@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+#include "../ThreadPool.h"
+#include "../Timer.h"
+
+/**
+ * \brief Per-layer timings of the single-sample forward pass, hidden gradients and weight update,
+ * on the calling thread only and split over ThreadPool::global(). Shows which layers are wide enough
+ * for the split to pay off. Ends with per-sample train throughput of the whole MNIST network.
+ */
+class BenchmarkIntraLayer : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        ThreadPool& pool = ThreadPool::global();
+        const NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        const std::vector<LayerInfo>& topology = nnInfo.topology;
+
+        std::cout << "Intra-layer parallelism benchmark, " << pool.threadCount() << " threads, microseconds per call\n";
+        std::cout << std::left << std::setw(14) << "layer" << std::setw(12) << "pass"
+            << std::setw(12) << "serial" << std::setw(12) << "pool" << "speedup\n";
+
+        for (size_t i = 1; i < topology.size(); i++)
+        {
+            NetworkLayer<double> layer(topology[i], &topology[i - 1], 1234, nullptr);
+            // Only needed as the layer to the right when timing the hidden gradients
+            const size_t rightSize = i + 1 < topology.size() ? topology[i + 1].numNeurons : 10;
+            NetworkLayer<double> right(LayerInfo(rightSize), &topology[i], 4321, nullptr);
+
+            LayerState<double> previous(topology[i - 1].numNeurons);
+            LayerState<double> state(layer.size());
+            LayerState<double> rightState(rightSize);
+            for (size_t n = 0; n < previous.size(); n++)
+                previous.outputs[n] = (double)(n % 7) / 7.0;
+            for (size_t n = 0; n < rightState.size(); n++)
+                rightState.errorGradients[n] = 0.001 * (double)(n % 5);
+
+            const std::string name = std::to_string(layer.numInputs) + "->" + std::to_string(layer.size());
+
+            timePass(name, "forward", layer, pool, [&] { layer.feedForward(previous, state); });
+            timePass(name, "gradients", layer, pool, [&] { layer.calculateHiddenGradients(right, rightState, state); });
+            timePass(name, "update", layer, pool, [&] { layer.updateWeights(previous, state, false); });
+        }
+
+        const auto images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        const auto labels = BenchmarkUtils::syntheticLabels(NUM_SAMPLES);
+
+        NeuralNetwork network(nnInfo);
+        network.setThreadPool(nullptr);
+        Timer timer;
+        network.train(images, labels);
+        const double serial = NUM_SAMPLES / timer.Stop();
+
+        network.setThreadPool(&pool);
+        timer.Start();
+        network.train(images, labels);
+        const double parallel = NUM_SAMPLES / timer.Stop();
+
+        std::cout << "train, " << NUM_SAMPLES << " samples: " << serial << " samples/sec serial, "
+            << parallel << " samples/sec on the pool (" << parallel / serial << "x)\n";
+    }
+
+protected:
+    template <typename Pass>
+    void timePass(const std::string& layerName, const char* passName, NetworkLayer<double>& layer, ThreadPool& pool, const Pass& pass)
+    {
+        layer.threadPool = nullptr;
+        const double serial = timeCalls(pass);
+        layer.threadPool = &pool;
+        const double parallel = timeCalls(pass);
+
+        std::cout << std::left << std::setw(14) << layerName << std::setw(12) << passName
+            << std::setw(12) << serial << std::setw(12) << parallel << serial / parallel << "x\n";
+    }
+
+    template <typename Pass>
+    double timeCalls(const Pass& pass)
+    {
+        pass(); // Warm up caches and wake the pool
+        Timer timer;
+        for (size_t r = 0; r < REPETITIONS; r++)
+            pass();
+        return timer.Stop() * 1e6 / (double)REPETITIONS;
+    }
+
+    const size_t REPETITIONS = 200;
+    const size_t NUM_SAMPLES = 200;
+};
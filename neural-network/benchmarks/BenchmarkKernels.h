@@ -0,0 +1,140 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../Kernels.h"
+
+/**
+ * \brief Runs every dense kernel on the matrix shapes the MNIST topology produces, once per
+ * instruction set the CPU supports, and reports GFLOP/s and speedup against the scalar kernels.
+ * Also checks every result against the scalar one. Runs the double kernels, then the float ones.
+ */
+class BenchmarkKernels : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        run<double>("double");
+        run<float>("float");
+    }
+
+protected:
+    template <typename Scalar>
+    struct Case
+    {
+        const char* name;
+        double flops;
+        std::function<void(std::vector<Scalar>&)> prepare;
+        std::function<void(const Kernels::KernelTable<Scalar>&, std::vector<Scalar>&)> run;
+    };
+
+    template <typename Scalar>
+    void run(const char* scalarName)
+    {
+        const Kernels::Isa previousIsa = Kernels::activeIsa();
+
+        // 1568 x 1568 is the widest layer pair, 128 a typical mini-batch
+        const size_t rows = 1568;
+        const size_t cols = 1568;
+        const size_t batch = 128;
+
+        const auto A = randomVector<Scalar>(rows * cols, 1);
+        const auto x = randomVector<Scalar>(cols, 2);
+        const auto y = randomVector<Scalar>(rows, 3);
+        const auto batchInputs = randomVector<Scalar>(batch * cols, 4);
+        const auto batchErrors = randomVector<Scalar>(batch * rows, 5);
+
+        std::cout << "Kernel benchmark (" << scalarName << "), " << rows << "x" << cols << " matrix, batch of " << batch << "\n";
+
+        // The result buffer is reset outside of the timed part, so only the kernel itself is measured
+        auto zeros = [](size_t size) { return [size](std::vector<Scalar>& out) { out.assign(size, Scalar(0)); }; };
+        auto copyOf = [](const std::vector<Scalar>& source) { return [&source](std::vector<Scalar>& out) { out = source; }; };
+        const Scalar alpha = Scalar(0.001);
+
+        std::vector<Case<Scalar>> cases;
+        cases.push_back({ "dot", 2.0 * cols, zeros(1), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            out[0] = k.dot(A.data(), x.data(), cols);
+        } });
+        cases.push_back({ "axpy", 2.0 * rows * cols, copyOf(A), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            for (size_t r = 0; r < rows; r++)
+                k.axpy(alpha, x.data(), out.data() + r * cols, cols);
+        } });
+        cases.push_back({ "gemv", 2.0 * rows * cols, zeros(rows), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            k.gemv(A.data(), x.data(), out.data(), rows, cols);
+        } });
+        cases.push_back({ "gemvTransposed", 2.0 * rows * cols, zeros(cols), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            k.gemvTransposed(A.data(), cols, y.data(), out.data(), rows, cols);
+        } });
+        cases.push_back({ "ger", 2.0 * rows * cols, copyOf(A), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            k.ger(alpha, y.data(), x.data(), out.data(), rows, cols);
+        } });
+        cases.push_back({ "gemmNT", 2.0 * batch * rows * cols, zeros(batch * rows), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            k.gemmNT(batchInputs.data(), A.data(), out.data(), batch, rows, cols);
+        } });
+        cases.push_back({ "gemmNN", 2.0 * batch * rows * cols, zeros(batch * cols), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            k.gemmNN(batchErrors.data(), A.data(), out.data(), batch, cols, rows);
+        } });
+        cases.push_back({ "gemmTN", 2.0 * batch * rows * cols, copyOf(A), [&](const Kernels::KernelTable<Scalar>& k, std::vector<Scalar>& out) {
+            k.gemmTN(alpha, batchErrors.data(), rows, batchInputs.data(), out.data(), rows, cols, batch);
+        } });
+
+        for (const Case<Scalar>& benchmarkCase : cases)
+        {
+            std::cout << benchmarkCase.name << ":\n";
+
+            std::vector<Scalar> reference;
+            double scalarSeconds = 0.0;
+
+            for (Kernels::Isa isa : { Kernels::Isa::Scalar, Kernels::Isa::SSE, Kernels::Isa::AVX2, Kernels::Isa::AVX512 })
+            {
+                const Kernels::KernelTable<Scalar>* kernels = Kernels::table<Scalar>(isa);
+                if (kernels == nullptr)
+                {
+                    std::cout << "  " << std::setw(8) << Kernels::isaName(isa) << ": not supported\n";
+                    continue;
+                }
+
+                std::vector<Scalar> result;
+                const double seconds = BenchmarkUtils::bestOf(5, [&] { benchmarkCase.run(*kernels, result); },
+                    [&] { benchmarkCase.prepare(result); });
+
+                if (isa == Kernels::Isa::Scalar)
+                {
+                    reference = result;
+                    scalarSeconds = seconds;
+                }
+
+                double maxError = 0.0;
+                for (size_t i = 0; i < result.size(); i++)
+                    maxError = std::max(maxError, (double)std::fabs(result[i] - reference[i]));
+
+                std::cout << "  " << std::setw(8) << Kernels::isaName(isa) << ": "
+                    << std::setw(8) << std::fixed << std::setprecision(2) << benchmarkCase.flops / seconds / 1e9 << " GFLOP/s, "
+                    << std::setw(6) << scalarSeconds / seconds << "x scalar, max error "
+                    << std::scientific << std::setprecision(1) << maxError << std::defaultfloat << "\n";
+            }
+        }
+
+        Kernels::setIsa(previousIsa);
+    }
+
+    template <typename Scalar>
+    static std::vector<Scalar> randomVector(size_t size, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<Scalar> distribution(-1, 1);
+
+        std::vector<Scalar> values(size);
+        for (Scalar& value : values)
+            value = distribution(generator);
+        return values;
+    }
+};
@@ -0,0 +1,162 @@
+﻿#pragma once
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Compares the contiguous layer storage in NetworkLayer against the old layout,
+ * where every neuron was an object owning its own heap allocated weight vector.
+ */
+class BenchmarkLayerLayout : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        const NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        const auto images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        const auto labels = BenchmarkUtils::syntheticLabels(NUM_SAMPLES);
+
+        ObjectLayoutNetwork objectNetwork(nnInfo);
+        NeuralNetwork network(nnInfo);
+
+        std::cout << "Layer layout benchmark, " << NUM_SAMPLES << " samples of 784->1568->1568->784->10\n";
+
+        Timer timer;
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+            objectNetwork.forwardPropagate(images[i]);
+        const double objectForward = timer.Stop() / NUM_SAMPLES;
+
+        timer.Start();
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+            network.forwardPropagate(images[i]);
+        const double contiguousForward = timer.Stop() / NUM_SAMPLES;
+
+        timer.Start();
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            objectNetwork.forwardPropagate(images[i]);
+            objectNetwork.backPropagate(labels[i]);
+        }
+        const double objectTrain = timer.Stop() / NUM_SAMPLES;
+
+        timer.Start();
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            network.forwardPropagate(images[i]);
+            network.backPropagate(images[i], labels[i]);
+        }
+        const double contiguousTrain = timer.Stop() / NUM_SAMPLES;
+
+        report("Forward", objectForward, contiguousForward);
+        report("Forward + backward", objectTrain, contiguousTrain);
+    }
+
+protected:
+    static void report(const char* name, double objectSeconds, double contiguousSeconds)
+    {
+        std::cout << name << ": neuron objects " << objectSeconds * 1000.0 << " ms/sample, contiguous "
+            << contiguousSeconds * 1000.0 << " ms/sample, speedup " << objectSeconds / contiguousSeconds << "x\n";
+    }
+
+    /**
+     * \brief Minimal copy of the old per-neuron object layout, kept only as the baseline.
+     */
+    struct ObjectNeuron
+    {
+        double output{};
+        double errorGradient{};
+        double errorDelta{};
+        double bias{};
+        std::vector<double> weights;
+    };
+
+    class ObjectLayoutNetwork
+    {
+    public:
+        ObjectLayoutNetwork(const NNConstructionInfo& constructionInfo)
+        {
+            std::mt19937 generator(1);
+            std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+            for (size_t i = 0; i < constructionInfo.topology.size(); i++)
+            {
+                const LayerInfo& info = constructionInfo.topology[i];
+                const size_t numInputs = i == 0 ? 0 : constructionInfo.topology[i - 1].numNeurons;
+
+                layers.emplace_back(info.numNeurons);
+                functions.push_back(info.activationFunction);
+                learningRates.push_back(info.learningRate);
+                for (auto& neuron : layers.back())
+                {
+                    for (size_t k = 0; k < numInputs; k++)
+                        neuron.weights.push_back(distribution(generator));
+                    neuron.bias = distribution(generator);
+                }
+            }
+        }
+
+        void forwardPropagate(const std::vector<double>& input)
+        {
+            for (size_t i = 0; i < input.size(); i++)
+                layers[0][i].output = input[i];
+
+            for (size_t l = 1; l < layers.size(); l++)
+            {
+                for (auto& neuron : layers[l])
+                {
+                    double sum = 0.0;
+                    for (size_t i = 0; i < layers[l - 1].size(); i++)
+                        sum += layers[l - 1][i].output * neuron.weights[i];
+                    neuron.output = activate(functions[l], sum + neuron.bias);
+                }
+            }
+        }
+
+        void backPropagate(const std::vector<double>& targetOutput)
+        {
+            auto& outputLayer = layers.back();
+            for (size_t i = 0; i < outputLayer.size(); i++)
+            {
+                outputLayer[i].errorDelta = targetOutput[i] - outputLayer[i].output;
+                outputLayer[i].errorGradient = outputLayer[i].errorDelta * activateDerivative(functions.back(), outputLayer[i].output);
+            }
+
+            for (size_t l = layers.size() - 2; l > 0; l--)
+            {
+                for (size_t k = 0; k < layers[l].size(); k++)
+                {
+                    // Column access across every neuron of the next layer
+                    double sum = 0.0;
+                    for (const auto& neuron : layers[l + 1])
+                        sum += neuron.weights[k] * neuron.errorGradient;
+                    layers[l][k].errorGradient = sum * activateDerivative(functions[l], layers[l][k].output);
+                }
+            }
+
+            for (size_t l = layers.size() - 1; l > 0; l--)
+            {
+                const bool isOutputLayer = l == layers.size() - 1;
+                for (auto& neuron : layers[l])
+                {
+                    const double error = isOutputLayer ? neuron.errorDelta : neuron.errorGradient;
+                    for (size_t i = 0; i < neuron.weights.size(); i++)
+                        neuron.weights[i] += learningRates[l] * layers[l - 1][i].output * error;
+                    neuron.bias += learningRates[l] * neuron.errorGradient;
+                }
+            }
+        }
+
+    private:
+        std::vector<std::vector<ObjectNeuron>> layers;
+        std::vector<ActiviationFunction> functions;
+        std::vector<double> learningRates;
+    };
+
+    const size_t NUM_SAMPLES = 20;
+};
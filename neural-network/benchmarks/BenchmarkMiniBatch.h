@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Training throughput of the per-sample path (train) against trainBatch
+ * with a range of batch sizes, on the MNIST topology.
+ */
+class BenchmarkMiniBatch : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        const NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        const auto images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        const auto labels = BenchmarkUtils::syntheticLabels(NUM_SAMPLES);
+
+        std::cout << "Mini-batch benchmark, " << NUM_SAMPLES << " samples of 784->1568->1568->784->10\n";
+
+        NeuralNetwork perSampleNetwork(nnInfo);
+        Timer timer;
+        perSampleNetwork.train(images, labels);
+        const double perSample = NUM_SAMPLES / timer.Stop();
+        std::cout << "train:              " << perSample << " samples/sec\n";
+
+        for (size_t batchSize : { 1, 8, 32, 128 })
+        {
+            NeuralNetwork network(nnInfo);
+            timer.Start();
+            network.trainBatch(images, labels, batchSize);
+            const double batched = NUM_SAMPLES / timer.Stop();
+
+            std::cout << "trainBatch(" << batchSize << "):" << std::string(batchSize < 10 ? 3 : batchSize < 100 ? 2 : 1, ' ')
+                << batched << " samples/sec (" << batched / perSample << "x)\n";
+        }
+    }
+
+protected:
+    const size_t NUM_SAMPLES = 256;
+};
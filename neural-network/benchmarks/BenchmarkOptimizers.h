@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "BenchmarkTimeToAccuracy.h"
+#include "BenchmarkUtils.h"
+#include "../Kernels.h"
+#include "../NeuralNetwork.h"
+
+/**
+ * \brief Trains the MNIST network with a softmax output from the same seed with every optimizer, and reports how long
+ * each takes to reach the target test accuracy, the same way as BenchmarkTimeToAccuracy. Then times one step of every
+ * optimizer over the weights of a 1568 x 1568 layer on every instruction set the CPU supports.
+ */
+class BenchmarkOptimizers : public BenchmarkTimeToAccuracy
+{
+public:
+    void Start() override
+    {
+        if (!loadMnist())
+            makePrototypeDigits();
+
+        std::cout << "Optimizers, time to " << 100.0 * TARGET_ACCURACY << "% test accuracy, batches of " << BATCH_SIZE << ", "
+            << trainingLabels.size() << " training and " << testLabels.size() << " test images\n";
+
+        // Momentum takes steps about 1 / (1 - momentum) times as large as SGD, and Adam's steps are about the
+        // learning rate itself, so each gets a learning rate of its own
+        run("SGD", OptimizerInfo::sgd(), 0.08);
+        run("momentum", OptimizerInfo::withMomentum(0.9), 0.008);
+        run("Nesterov", OptimizerInfo::withMomentum(0.9, true), 0.008);
+        run("Adam", OptimizerInfo::adam(), 0.001);
+        run("AdamW", OptimizerInfo::adam(0.01), 0.001);
+
+        timeSteps();
+        std::cout << "\n";
+    }
+
+protected:
+    static constexpr size_t NUM_PARAMETERS = 1568 * 1568;
+
+    void run(const char* name, const OptimizerInfo& optimizer, double learningRate)
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.topology.back().activationFunction = Softmax;
+        for (LayerInfo& layerInfo : nnInfo.topology)
+            layerInfo.learningRate = learningRate;
+        nnInfo.optimizer = optimizer;
+        nnInfo.seed = 1234;
+        BenchmarkTimeToAccuracy::run(name, nnInfo);
+    }
+
+    /**
+     * \brief Best time of one step over NUM_PARAMETERS weights, per optimizer and instruction set.
+     * The changes are cleared by every step, which doesn't change how long the next one takes.
+     */
+    void timeSteps()
+    {
+        std::vector<double> parameters(NUM_PARAMETERS, 0.5);
+        std::vector<double> changes(NUM_PARAMETERS, 0.0);
+        std::vector<double> first(NUM_PARAMETERS, 0.0);
+        std::vector<double> second(NUM_PARAMETERS, 0.0);
+
+        std::cout << "One step over " << NUM_PARAMETERS << " weights (double):\n";
+        for (Kernels::Isa isa : { Kernels::Isa::Scalar, Kernels::Isa::SSE, Kernels::Isa::AVX2, Kernels::Isa::AVX512 })
+        {
+            const Kernels::KernelTable<double>* kernels = Kernels::table<double>(isa);
+            if (kernels == nullptr)
+                continue;
+
+            const double momentumSeconds = BenchmarkUtils::bestOf(5, [&] { kernels->momentumStep(0.01, 0.9, parameters.data(), changes.data(), first.data(), NUM_PARAMETERS); });
+            const double nesterovSeconds = BenchmarkUtils::bestOf(5, [&] { kernels->nesterovStep(0.01, 0.9, parameters.data(), changes.data(), first.data(), NUM_PARAMETERS); });
+            const double adamSeconds = BenchmarkUtils::bestOf(5, [&]
+            {
+                kernels->adamStep(0.001, 0.9, 0.999, 1e-8, 1e-5, parameters.data(), changes.data(), first.data(), second.data(), NUM_PARAMETERS);
+            });
+
+            std::cout << "  " << std::setw(8) << Kernels::isaName(isa) << ": " << std::fixed << std::setprecision(2)
+                << "momentum " << momentumSeconds * 1000.0 << " ms, Nesterov " << nesterovSeconds * 1000.0 << " ms, Adam "
+                << adamSeconds * 1000.0 << " ms" << std::defaultfloat << "\n";
+        }
+    }
+};
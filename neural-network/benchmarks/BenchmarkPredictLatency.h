@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../AllocationCounter.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Single-sample latency of predict returning a new vector, against predict writing into buffers
+ * owned by the caller. Prints mean, p50 and p99 in microseconds, and heap allocations per call
+ * (only counted in builds with NN_COUNT_ALLOCATIONS, the Debug configurations).
+ */
+class BenchmarkPredictLatency : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        std::cout << "Predict latency benchmark, microseconds per call";
+        if (!AllocationCounter::enabled())
+            std::cout << " (allocation counting is off, build with NN_COUNT_ALLOCATIONS to count)";
+        std::cout << "\n";
+
+        NNConstructionInfo small(2, LayerInfo(1, 0.1, Sigmoid));
+        small.addHiddenLayer(LayerInfo(32, 0.1, Tanh));
+        run("2->32->1", small);
+        run("784->1568->1568->784->10", BenchmarkUtils::mnistTopology());
+    }
+
+protected:
+    void run(const char* name, NNConstructionInfo nnInfo)
+    {
+        nnInfo.seed = 1234;
+        NeuralNetwork network(nnInfo);
+        // Keep the pool out of it, this is about the per-call overhead
+        network.setThreadPool(nullptr);
+
+        std::vector<double> input(network.inputSize());
+        for (size_t i = 0; i < input.size(); i++)
+            input[i] = (double)(i % 7) / 7.0;
+        std::vector<double> output(network.outputSize());
+
+        std::cout << name << "\n";
+        std::cout << std::left << std::setw(16) << "api" << std::setw(12) << "mean" << std::setw(12) << "p50"
+            << std::setw(12) << "p99" << "allocations\n";
+
+        timeCalls("vector", [&] { output = network.predict(input); });
+        timeCalls("buffer", [&] { network.predict(input.data(), output.data()); });
+    }
+
+    template <typename Call>
+    void timeCalls(const char* apiName, const Call& call)
+    {
+        call(); // Warm up
+
+        std::vector<double> latencies(REPETITIONS);
+        const size_t allocationsBefore = AllocationCounter::allocations();
+        Timer timer;
+        for (double& latency : latencies)
+        {
+            timer.Start();
+            call();
+            latency = timer.Stop() * 1e6;
+        }
+        const size_t allocations = AllocationCounter::allocations() - allocationsBefore;
+
+        double sum = 0.0;
+        for (double latency : latencies)
+            sum += latency;
+        std::sort(latencies.begin(), latencies.end());
+
+        std::cout << std::left << std::setw(16) << apiName << std::setw(12) << sum / (double)REPETITIONS
+            << std::setw(12) << latencies[REPETITIONS / 2] << std::setw(12) << latencies[REPETITIONS * 99 / 100];
+        if (AllocationCounter::enabled())
+            std::cout << (double)allocations / (double)REPETITIONS;
+        else
+            std::cout << "-";
+        std::cout << "\n";
+    }
+
+    const size_t REPETITIONS = 500;
+};
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+#include "../Profiler.h"
+#include "../Timer.h"
+
+/**
+ * \brief Profiles mini-batch and single-sample training of the MNIST network layer by layer, prints
+ * where the time goes, and writes the report to profile.json and profile.csv and the timeline to
+ * profile-trace.json (open it in chrome://tracing or Perfetto). Also measures what leaving the
+ * profiler enabled costs.
+ */
+class BenchmarkProfile : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        NeuralNetwork network(nnInfo);
+
+        const auto images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        const auto labels = BenchmarkUtils::syntheticLabels(NUM_SAMPLES);
+
+        std::cout << "Profile of the MNIST network, " << NUM_SAMPLES << " samples in batches of " << BATCH_SIZE
+            << " and " << NUM_SINGLE_SAMPLES << " one at a time\n";
+
+        const bool wasEnabled = Profiler::enabled();
+        Profiler::enable(false);
+        Timer timer;
+        network.trainBatch(images, labels, BATCH_SIZE);
+        const double disabledSeconds = timer.Stop();
+
+        Profiler::reset();
+        Profiler::enable(true);
+        Profiler::enableTrace(true);
+        timer.Start();
+        network.trainBatch(images, labels, BATCH_SIZE);
+        const double enabledSeconds = timer.Stop();
+
+        const std::vector<std::vector<double>> singleImages(images.begin(), images.begin() + NUM_SINGLE_SAMPLES);
+        const std::vector<std::vector<double>> singleLabels(labels.begin(), labels.begin() + NUM_SINGLE_SAMPLES);
+        network.train(singleImages, singleLabels);
+
+        Profiler::enableTrace(false);
+        Profiler::enable(wasEnabled);
+
+        std::cout << "trainBatch takes " << std::fixed << std::setprecision(3) << disabledSeconds << " seconds with the profiler disabled, "
+            << enabledSeconds << " enabled (" << std::setprecision(1) << 100.0 * (enabledSeconds / disabledSeconds - 1.0) << "% overhead)\n";
+
+        std::vector<Profiler::LayerProfile> profiles = Profiler::report();
+        double totalSeconds = 0.0;
+        for (const Profiler::LayerProfile& profile : profiles)
+            totalSeconds += profile.seconds;
+        std::sort(profiles.begin(), profiles.end(),
+            [](const Profiler::LayerProfile& a, const Profiler::LayerProfile& b) { return a.seconds > b.seconds; });
+
+        std::cout << "layer      phase  calls   seconds  share  GFLOP/s   GB/s  allocations\n";
+        for (const Profiler::LayerProfile& profile : profiles)
+        {
+            std::cout << std::setw(5) << profile.layer << std::setw(11) << Profiler::phaseName(profile.phase) << std::setw(7) << profile.calls
+                << std::setprecision(3) << std::setw(10) << profile.seconds << std::setprecision(1) << std::setw(6)
+                << 100.0 * profile.seconds / totalSeconds << "%" << std::setprecision(2) << std::setw(9) << profile.gflopsPerSecond()
+                << std::setw(7) << profile.gigabytesPerSecond() << std::setw(13) << profile.allocations << "\n";
+        }
+        std::cout << std::defaultfloat;
+
+        std::ofstream json("profile.json");
+        Profiler::writeJson(json);
+        std::ofstream csv("profile.csv");
+        Profiler::writeCsv(csv);
+        std::ofstream trace("profile-trace.json");
+        Profiler::writeChromeTrace(trace);
+        std::cout << "Wrote profile.json, profile.csv and profile-trace.json\n\n";
+    }
+
+protected:
+    static constexpr size_t NUM_SAMPLES = 512;
+    static constexpr size_t BATCH_SIZE = 32;
+    static constexpr size_t NUM_SINGLE_SAMPLES = 32;
+};
@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../NeuralNetwork.h"
+#include "../ServingNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Prediction latency of a ServingNetwork on the MNIST topology, with reader threads predicting one
+ * image at a time as fast as they can. Runs once with nothing else going on, and once while a training
+ * thread trains in mini-batches and publishes a new snapshot after every few batches. Reports the latency
+ * percentiles of every prediction, and how many predictions and publishes there were.
+ */
+class BenchmarkServing : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        NeuralNetwork network(nnInfo);
+        ServingNetwork<double> serving(network);
+
+        images = BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        labels = BenchmarkUtils::syntheticLabels(NUM_SAMPLES);
+
+        // Leave one hardware thread for the trainer
+        const size_t numReaders = std::max(1u, std::thread::hardware_concurrency() - 1);
+        std::cout << "Serving benchmark, " << numReaders << " reader threads predicting for " << SECONDS
+            << " seconds, publishing every " << BATCHES_PER_PUBLISH << " batches of " << BATCH_SIZE << "\n";
+
+        run("predict only", serving, network, numReaders, false);
+        run("predict while training", serving, network, numReaders, true);
+        std::cout << "\n";
+    }
+
+protected:
+    static constexpr size_t NUM_SAMPLES = 512;
+    static constexpr size_t BATCH_SIZE = 32;
+    static constexpr size_t BATCHES_PER_PUBLISH = 4;
+    static constexpr double SECONDS = 3.0;
+
+    void run(const char* name, ServingNetwork<double>& serving, NeuralNetwork& network, size_t numReaders, bool train)
+    {
+        std::atomic<bool> stop(false);
+        std::vector<std::vector<double>> latencies(numReaders);
+        const uint64_t firstVersion = serving.version();
+
+        std::vector<std::thread> readers;
+        for (size_t r = 0; r < numReaders; r++)
+        {
+            readers.emplace_back([&, r]
+            {
+                std::vector<LayerState<double>> states = serving.createLayerStates();
+                std::vector<double> output(10);
+                std::vector<double>& readerLatencies = latencies[r];
+                readerLatencies.reserve(100000);
+
+                Timer timer;
+                for (size_t i = r; !stop.load(std::memory_order_relaxed); i++)
+                {
+                    timer.Start();
+                    serving.predict(images[i % NUM_SAMPLES].data(), output.data(), states);
+                    readerLatencies.push_back(timer.Stop());
+                }
+            });
+        }
+
+        Timer duration;
+        size_t batches = 0;
+        while (duration.Stop() < SECONDS)
+        {
+            if (!train)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            const size_t first = (batches * BATCH_SIZE) % NUM_SAMPLES;
+            const std::vector<std::vector<double>> batchImages(images.begin() + first, images.begin() + first + BATCH_SIZE);
+            const std::vector<std::vector<double>> batchLabels(labels.begin() + first, labels.begin() + first + BATCH_SIZE);
+            network.trainBatch(batchImages, batchLabels, BATCH_SIZE);
+
+            if (++batches % BATCHES_PER_PUBLISH == 0)
+                serving.publish(network);
+        }
+        stop = true;
+        for (std::thread& reader : readers)
+            reader.join();
+
+        std::vector<double> all;
+        for (const std::vector<double>& readerLatencies : latencies)
+            all.insert(all.end(), readerLatencies.begin(), readerLatencies.end());
+        std::sort(all.begin(), all.end());
+
+        auto percentile = [&](double fraction) { return all.empty() ? 0.0 : all[std::min(all.size() - 1, (size_t)(fraction * all.size()))] * 1000.0; };
+        std::cout << std::setw(24) << name << ": " << all.size() << " predictions, " << serving.version() - firstVersion
+            << " publishes, latency in ms: p50 " << std::fixed << std::setprecision(3) << percentile(0.5) << ", p99 "
+            << percentile(0.99) << ", p99.9 " << percentile(0.999) << ", max " << (all.empty() ? 0.0 : all.back() * 1000.0)
+            << std::defaultfloat << "\n";
+    }
+
+    std::vector<std::vector<double>> images;
+    std::vector<std::vector<double>> labels;
+};
@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../IdxFile.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Per-sample predict and train throughput of the MNIST network with the sparse first-layer kernels
+ * against the dense ones. Uses the real MNIST training images when they are in vendor/_mnist_dataset, since
+ * their non-zero pixels cluster in the middle of the image, and synthetic images otherwise.
+ */
+class BenchmarkSparseInput : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        const std::vector<std::vector<double>> images = loadImages();
+        const auto labels = BenchmarkUtils::syntheticLabels(images.size());
+
+        size_t nonZero = 0;
+        for (const std::vector<double>& image : images)
+            nonZero += std::count_if(image.begin(), image.end(), [](double pixel) { return pixel != 0.0; });
+        std::cout << "Sparse input benchmark, " << images.size() << " samples, " << 100.0 * nonZero / (images.size() * 28 * 28)
+            << "% of the pixels non-zero\n";
+
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.seed = 1234;
+        NeuralNetwork dense(nnInfo);
+        NeuralNetwork sparse(nnInfo);
+        dense.setSparseInputThreshold(0.0);
+        dense.setThreadPool(nullptr);
+        sparse.setThreadPool(nullptr);
+
+        const double densePredict = predictThroughput(dense, images);
+        const double sparsePredict = predictThroughput(sparse, images);
+        std::cout << "predict: " << densePredict << " samples/sec dense, " << sparsePredict << " sparse ("
+            << sparsePredict / densePredict << "x)\n";
+
+        // Same math, only the order of the additions differs. Checked before training, because training
+        // amplifies rounding differences until the two networks have nothing in common.
+        double maxDifference = 0.0;
+        for (const std::vector<double>& image : images)
+        {
+            const std::vector<double> a = dense.predict(image);
+            const std::vector<double> b = sparse.predict(image);
+            for (size_t i = 0; i < a.size(); i++)
+                maxDifference = std::max(maxDifference, std::abs(a[i] - b[i]));
+        }
+        std::cout << "Max difference between dense and sparse predict: " << maxDifference << "\n";
+
+        Timer timer;
+        dense.train(images, labels);
+        const double denseTrain = images.size() / timer.Stop();
+        timer.Start();
+        sparse.train(images, labels);
+        const double sparseTrain = images.size() / timer.Stop();
+        std::cout << "train:   " << denseTrain << " samples/sec dense, " << sparseTrain << " sparse ("
+            << sparseTrain / denseTrain << "x)\n";
+
+    }
+
+protected:
+    std::vector<std::vector<double>> loadImages()
+    {
+        const IdxFile file(MNIST_IMAGES);
+        if (!file.isOpen())
+        {
+            std::cout << "No MNIST images at " << MNIST_IMAGES << ", using synthetic ones\n";
+            return BenchmarkUtils::syntheticImages(NUM_SAMPLES);
+        }
+
+        std::vector<std::vector<double>> images;
+        for (size_t i = 0; i < std::min(NUM_SAMPLES, file.count()); i++)
+        {
+            const IdxFile::Span pixels = file.item(i);
+            images.emplace_back(pixels.size);
+            for (size_t k = 0; k < pixels.size; k++)
+                images.back()[k] = pixels[k] / 255.0;
+        }
+        return images;
+    }
+
+    double predictThroughput(NeuralNetwork& network, const std::vector<std::vector<double>>& images)
+    {
+        std::vector<double> output(network.outputSize());
+        Timer timer;
+        for (const std::vector<double>& image : images)
+            network.predict(image.data(), output.data());
+        return images.size() / timer.Stop();
+    }
+
+    const size_t NUM_SAMPLES = 500;
+    const char* MNIST_IMAGES = "vendor/_mnist_dataset/train-images-idx3-.ubyte";
+};
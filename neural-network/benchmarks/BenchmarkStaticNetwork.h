@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "../NeuralNetwork.h"
+#include "../StaticNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Epochs per second on XOR with the 2->300->1 network of ExampleXOR, built as a NeuralNetwork and as a
+ * StaticNetwork from the same seed. Both start out with the same weights, so their predictions after
+ * training should only differ by rounding.
+ */
+class BenchmarkStaticNetwork : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        std::cout << "Static network benchmark, XOR on 2->300->1, " << NUM_EPOCHS << " epochs\n";
+        run<double>("double");
+        run<float>("float");
+        std::cout << "\n";
+    }
+
+protected:
+    static constexpr int NUM_EPOCHS = 2000;
+    static constexpr double LEARNING_RATE = 0.1;
+    static constexpr unsigned int SEED = 1234;
+
+    template <typename Scalar>
+    void run(const char* scalarName)
+    {
+        const std::vector<std::vector<Scalar>> trainingData = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+        const std::vector<std::vector<Scalar>> targetOutput = { { 0 }, { 1 }, { 1 }, { 0 } };
+
+        NNConstructionInfo nnInfo(2, LayerInfo(1, LEARNING_RATE, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(300, LEARNING_RATE, Tanh));
+        nnInfo.seed = SEED;
+        BasicNeuralNetwork<Scalar> dynamicNetwork(nnInfo);
+        auto staticNetwork = std::make_unique<BasicStaticNetwork<Scalar, 2, Layer<300, Tanh>, Layer<1, Sigmoid>>>(LEARNING_RATE, SEED);
+
+        Timer timer;
+        double dynamicLoss = 0.0;
+        for (int epoch = 0; epoch < NUM_EPOCHS; epoch++)
+            dynamicLoss = dynamicNetwork.train(trainingData, targetOutput);
+        const double dynamicSeconds = timer.Stop();
+
+        timer.Start();
+        double staticLoss = 0.0;
+        for (int epoch = 0; epoch < NUM_EPOCHS; epoch++)
+            staticLoss = staticNetwork->train(trainingData, targetOutput);
+        const double staticSeconds = timer.Stop();
+
+        double maxDifference = 0.0;
+        for (const std::vector<Scalar>& input : trainingData)
+            maxDifference = std::max(maxDifference, (double)std::fabs(dynamicNetwork.predict(input)[0] - staticNetwork->predict(input)[0]));
+
+        std::cout << scalarName << ": NeuralNetwork " << std::fixed << std::setprecision(0) << NUM_EPOCHS / dynamicSeconds
+            << " epochs/sec, StaticNetwork " << NUM_EPOCHS / staticSeconds << " epochs/sec (" << std::setprecision(2)
+            << dynamicSeconds / staticSeconds << "x), final MSE " << std::scientific << dynamicLoss << " and " << staticLoss
+            << ", max prediction difference " << maxDifference << std::defaultfloat << "\n";
+    }
+};
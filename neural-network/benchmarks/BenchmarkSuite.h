@@ -0,0 +1,398 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../Kernels.h"
+#include "../NeuralNetwork.h"
+#include "../ThreadPool.h"
+#include "../Timer.h"
+
+/**
+ * \brief The regression suite: construction, a single-sample forward pass, a single-sample forward + backward pass and
+ * a training epoch on MNIST-shaped synthetic data for several topologies, and XOR epochs. Every case runs once to warm
+ * up and then a number of timed repetitions, and is reported as JSON with the median time per operation, the median
+ * absolute deviation (MAD) of the repetitions and the throughput at the median.
+ * Given the JSON of an earlier run as a baseline, every case is compared against it, and run returns 1 when one
+ * of them got slower by more than the threshold. Timings only compare on the same machine and build, so no baseline
+ * ships with the repo: keep the output of a run on your own machine as the baseline for the next ones.
+ * CMakeLists.txt builds it as its own executable, see BenchmarkSuiteMain.cpp for the command line.
+ */
+class BenchmarkSuite : public IBenchmark
+{
+public:
+    struct Options
+    {
+        // Timed repetitions per case, after one warm-up run
+        size_t repetitions = 9;
+
+        // Every repetition runs a case as many times as it takes to last at least this long, so short cases
+        // aren't lost in the timer's resolution
+        double minRepetitionSeconds = 0.02;
+
+        // Only run the cases whose name contains this. Empty runs every case.
+        std::string filter;
+
+        // Where to write the JSON. Empty writes it to std::cout.
+        std::string outputPath;
+
+        // JSON from an earlier run to compare against. Empty skips the comparison.
+        std::string baselinePath;
+
+        // A case regresses when its median is this fraction slower than the baseline's, and the difference is
+        // larger than NOISE_MADS times the larger of the two MADs
+        double threshold = 0.1;
+    };
+
+    struct Result
+    {
+        std::string name;
+        // What one operation processes, e.g. "samples"
+        std::string unit;
+        double itemsPerOperation = 1.0;
+        size_t iterations = 0;
+        double medianSeconds = 0.0;
+        double madSeconds = 0.0;
+
+        double throughput() const { return itemsPerOperation / medianSeconds; }
+    };
+
+    BenchmarkSuite() = default;
+    BenchmarkSuite(const Options& options) : options(options) {}
+
+    void Start() override
+    {
+        run();
+    }
+
+    /**
+     * \brief Run every selected case, write the JSON and compare against the baseline. Progress and the comparison
+     * go to std::cerr, so the JSON on std::cout can be piped.
+     * \return 0 if nothing regressed, 1 if a case regressed, 2 if the output or the baseline couldn't be written or read.
+     * The baseline is read before any case runs, so a bad path fails right away.
+     */
+    int run()
+    {
+        results.clear();
+
+        std::vector<Result> baseline;
+        if (!options.baselinePath.empty())
+        {
+            if (samePath(options.baselinePath, options.outputPath))
+            {
+                std::cerr << "BenchmarkSuite: The output would overwrite the baseline " << options.baselinePath << "\n";
+                return 2;
+            }
+            if (!readBaseline(options.baselinePath, baseline))
+            {
+                std::cerr << "BenchmarkSuite: Couldn't read the baseline " << options.baselinePath << "\n";
+                return 2;
+            }
+        }
+
+        std::cerr << "Benchmark suite, " << Kernels::isaName(Kernels::activeIsa()) << ", " << ThreadPool::global().threadCount()
+            << " threads, " << options.repetitions << " repetitions per case\n";
+
+        for (const Topology& topology : topologies())
+            runTopology(topology);
+        runXor();
+
+        if (!writeJson())
+            return 2;
+        return options.baselinePath.empty() ? 0 : compareWithBaseline(baseline);
+    }
+
+    const std::vector<Result>& lastResults() const { return results; }
+
+protected:
+    static constexpr size_t EPOCH_SAMPLES = 512;
+    static constexpr size_t EPOCH_BATCH_SIZE = 32;
+    static constexpr size_t XOR_EPOCHS = 10;
+    static constexpr double NOISE_MADS = 3.0;
+
+    struct Topology
+    {
+        std::string name;
+        NNConstructionInfo nnInfo;
+    };
+
+    static std::vector<Topology> topologies()
+    {
+        NNConstructionInfo small(28 * 28, LayerInfo(10, 0.05, Softmax, XavierInit));
+        small.addHiddenLayer(LayerInfo(128, 0.05, Sigmoid, XavierInit));
+
+        NNConstructionInfo medium(28 * 28, LayerInfo(10, 0.05, Softmax, XavierInit));
+        medium.addHiddenLayer(LayerInfo(512, 0.05, ReLU, HeInit));
+        medium.addHiddenLayer(LayerInfo(256, 0.05, ReLU, HeInit));
+
+        std::vector<Topology> result = { { "784-128-10", small }, { "784-512-256-10", medium },
+            { "784-1568-1568-784-10", BenchmarkUtils::mnistTopology() } };
+        for (Topology& topology : result)
+            topology.nnInfo.seed = 1234;
+        return result;
+    }
+
+    void runTopology(const Topology& topology)
+    {
+        const std::vector<std::vector<double>> images = BenchmarkUtils::syntheticImages(EPOCH_SAMPLES);
+        const std::vector<std::vector<double>> labels = BenchmarkUtils::syntheticLabels(EPOCH_SAMPLES);
+
+        if (selected("construction/" + topology.name))
+            measure("construction/" + topology.name, "networks", 1.0, [&] { NeuralNetwork network(topology.nnInfo); });
+
+        if (selected("forward/" + topology.name))
+        {
+            NeuralNetwork network(topology.nnInfo);
+            std::vector<double> output(network.outputSize());
+            size_t sample = 0;
+            measure("forward/" + topology.name, "samples", 1.0, [&]
+            {
+                network.forwardPropagate(images[sample].data(), output.data());
+                sample = (sample + 1) % images.size();
+            });
+        }
+
+        if (selected("train_sample/" + topology.name))
+        {
+            NeuralNetwork network(topology.nnInfo);
+            std::vector<double> output(network.outputSize());
+            size_t sample = 0;
+            measure("train_sample/" + topology.name, "samples", 1.0, [&]
+            {
+                network.forwardPropagate(images[sample].data(), output.data());
+                network.backPropagate(images[sample], labels[sample]);
+                sample = (sample + 1) % images.size();
+            });
+        }
+
+        if (selected("epoch/" + topology.name))
+        {
+            NeuralNetwork network(topology.nnInfo);
+            measure("epoch/" + topology.name, "samples", (double)EPOCH_SAMPLES, [&] { network.trainBatch(images, labels, EPOCH_BATCH_SIZE); });
+        }
+    }
+
+    void runXor()
+    {
+        if (!selected("xor/2-300-1"))
+            return;
+
+        // The same network and data as ExampleXOR
+        const std::vector<std::vector<double>> trainingData = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+        const std::vector<std::vector<double>> targetOutput = { { 0 }, { 1 }, { 1 }, { 0 } };
+        NNConstructionInfo nnInfo(2, LayerInfo(1, 0.1, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(300, 0.1, Tanh));
+        nnInfo.seed = 1234;
+        NeuralNetwork network(nnInfo);
+
+        measure("xor/2-300-1", "epochs", (double)XOR_EPOCHS, [&]
+        {
+            for (size_t epoch = 0; epoch < XOR_EPOCHS; epoch++)
+                network.train(trainingData, targetOutput);
+        });
+    }
+
+    bool selected(const std::string& name) const
+    {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    /**
+     * \brief Time operation and add its result.
+     * \param itemsPerOperation How many units (samples, epochs...) one call of operation processes, for the throughput.
+     */
+    template <typename Function>
+    void measure(const std::string& name, const char* unit, double itemsPerOperation, const Function& operation)
+    {
+        Timer timer;
+        operation();
+
+        // Double the iterations until a repetition is long enough
+        size_t iterations = 1;
+        while (true)
+        {
+            timer.Start();
+            for (size_t i = 0; i < iterations; i++)
+                operation();
+            if (timer.Stop() >= options.minRepetitionSeconds || iterations >= (1 << 24))
+                break;
+            iterations *= 2;
+        }
+
+        std::vector<double> seconds(std::max<size_t>(1, options.repetitions));
+        for (double& repetitionSeconds : seconds)
+        {
+            timer.Start();
+            for (size_t i = 0; i < iterations; i++)
+                operation();
+            repetitionSeconds = timer.Stop() / (double)iterations;
+        }
+
+        Result result;
+        result.name = name;
+        result.unit = unit;
+        result.itemsPerOperation = itemsPerOperation;
+        result.iterations = iterations;
+        result.medianSeconds = median(seconds);
+        for (double& repetitionSeconds : seconds)
+            repetitionSeconds = std::fabs(repetitionSeconds - result.medianSeconds);
+        result.madSeconds = median(seconds);
+        results.push_back(result);
+
+        std::cerr << "  " << std::setw(32) << std::left << name << std::right << std::fixed << std::setprecision(3) << std::setw(12)
+            << result.medianSeconds * 1e6 << " us +- " << std::setw(9) << result.madSeconds * 1e6 << " us, " << std::setprecision(1)
+            << std::setw(10) << result.throughput() << " " << unit << "/s" << std::defaultfloat << "\n";
+    }
+
+    static double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        const size_t middle = values.size() / 2;
+        return values.size() % 2 == 1 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+    }
+
+    /**
+     * \brief The results as JSON, one case per line. readBaseline reads the same layout back.
+     */
+    bool writeJson() const
+    {
+        std::ostringstream json;
+        json << std::setprecision(6) << "{\n  \"version\": 1,\n  \"isa\": \"" << Kernels::isaName(Kernels::activeIsa())
+            << "\",\n  \"threads\": " << ThreadPool::global().threadCount() << ",\n  \"repetitions\": " << options.repetitions
+            << ",\n  \"cases\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& result = results[i];
+            json << "    {\"name\": \"" << result.name << "\", \"unit\": \"" << result.unit << "\", \"iterations\": " << result.iterations
+                << ", \"median_ns\": " << result.medianSeconds * 1e9 << ", \"mad_ns\": " << result.madSeconds * 1e9
+                << ", \"throughput_per_s\": " << result.throughput() << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        json << "  ]\n}\n";
+
+        if (options.outputPath.empty())
+        {
+            std::cout << json.str();
+            return true;
+        }
+
+        std::ofstream file(options.outputPath);
+        file << json.str();
+        if (!file)
+        {
+            std::cerr << "BenchmarkSuite: Couldn't write " << options.outputPath << "\n";
+            return false;
+        }
+        std::cerr << "Results written to " << options.outputPath << "\n";
+        return true;
+    }
+
+    /**
+     * \brief Read the name, median_ns and mad_ns of every case from JSON written by writeJson. Not a general JSON
+     * parser: it relies on every case being one object with the name first.
+     */
+    static bool readBaseline(const std::string& path, std::vector<Result>& baseline)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+
+        std::stringstream contents;
+        contents << file.rdbuf();
+        const std::string json = contents.str();
+
+        const std::string nameKey = "\"name\": \"";
+        for (size_t position = json.find(nameKey); position != std::string::npos; position = json.find(nameKey, position))
+        {
+            position += nameKey.size();
+            const size_t nameEnd = json.find('"', position);
+            const size_t objectEnd = json.find('}', position);
+            if (nameEnd == std::string::npos || objectEnd == std::string::npos)
+                return false;
+
+            Result result;
+            result.name = json.substr(position, nameEnd - position);
+            const std::string object = json.substr(nameEnd, objectEnd - nameEnd);
+            if (!readNumber(object, "median_ns", result.medianSeconds) || !readNumber(object, "mad_ns", result.madSeconds))
+                return false;
+            result.medianSeconds *= 1e-9;
+            result.madSeconds *= 1e-9;
+            baseline.push_back(result);
+        }
+        return !baseline.empty();
+    }
+
+    static bool readNumber(const std::string& object, const std::string& key, double& value)
+    {
+        const size_t position = object.find("\"" + key + "\": ");
+        if (position == std::string::npos)
+            return false;
+        value = std::strtod(object.c_str() + position + key.size() + 4, nullptr);
+        return true;
+    }
+
+    /**
+     * \return Whether both paths name the same file, also when it doesn't exist yet. An empty output goes to std::cout.
+     */
+    static bool samePath(const std::string& first, const std::string& second)
+    {
+        if (first.empty() || second.empty())
+            return false;
+
+        std::error_code error;
+        const std::filesystem::path firstPath = std::filesystem::weakly_canonical(first, error);
+        const std::filesystem::path secondPath = std::filesystem::weakly_canonical(second, error);
+        return error ? first == second : firstPath == secondPath;
+    }
+
+    /**
+     * \param baseline The cases of the baseline, from readBaseline.
+     * \return 1 if a case regressed, 0 otherwise. Cases that aren't in the baseline are reported but never fail the run.
+     */
+    int compareWithBaseline(const std::vector<Result>& baseline) const
+    {
+        std::cerr << "Against " << options.baselinePath << ", threshold " << std::fixed << std::setprecision(1) << 100.0 * options.threshold
+            << "%:" << std::defaultfloat << "\n";
+        size_t regressions = 0;
+        for (const Result& result : results)
+        {
+            auto match = std::find_if(baseline.begin(), baseline.end(), [&](const Result& old) { return old.name == result.name; });
+            std::cerr << "  " << std::setw(32) << std::left << result.name << std::right;
+            if (match == baseline.end())
+            {
+                std::cerr << " not in the baseline\n";
+                continue;
+            }
+
+            const double slower = result.medianSeconds - match->medianSeconds;
+            const bool regressed = slower > options.threshold * match->medianSeconds
+                && slower > NOISE_MADS * std::max(result.madSeconds, match->madSeconds);
+            if (regressed)
+                regressions++;
+
+            std::cerr << std::fixed << std::setprecision(3) << std::setw(12) << match->medianSeconds * 1e6 << " us -> " << std::setw(12)
+                << result.medianSeconds * 1e6 << " us (" << std::showpos << std::setprecision(1) << 100.0 * slower / match->medianSeconds
+                << std::noshowpos << "%)" << (regressed ? "  REGRESSED" : "") << std::defaultfloat << "\n";
+        }
+
+        if (regressions > 0)
+        {
+            std::cerr << regressions << " case(s) regressed\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    Options options;
+    std::vector<Result> results;
+};
@@ -0,0 +1,75 @@
+﻿#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "BenchmarkSuite.h"
+
+/*
+ * The benchmark suite as its own executable, built by CMakeLists.txt. Doesn't need anything Windows-only, unlike main.cpp.
+ *
+ *   neural-network-bench [--output results.json] [--baseline baseline.json] [--threshold 0.1]
+ *                        [--repetitions 9] [--min-time 0.02] [--filter forward/]
+ *
+ * A baseline is the --output of an earlier run on the same machine, copied to a file of its own: the output can't be
+ * the baseline. Exits with 1 if a case regressed against it, 2 on bad arguments or files.
+ */
+namespace
+{
+    void printUsage()
+    {
+        std::cerr << "Usage: neural-network-bench [--output FILE] [--baseline FILE] [--threshold FRACTION]\n"
+            "                            [--repetitions N] [--min-time SECONDS] [--filter TEXT]\n"
+            "  --output       Write the JSON results to FILE instead of stdout\n"
+            "  --baseline     Compare against the JSON of an earlier run, and exit with 1 if a case regressed\n"
+            "  --threshold    How much slower a case can get before it counts as a regression (default 0.1)\n"
+            "  --repetitions  Timed repetitions per case (default 9)\n"
+            "  --min-time     Shortest time of one repetition in seconds (default 0.02)\n"
+            "  --filter       Only run the cases whose name contains TEXT, e.g. forward/ or 784-128-10\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkSuite::Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argument, "--help") == 0 || std::strcmp(argument, "-h") == 0)
+        {
+            printUsage();
+            return 0;
+        }
+        if (value == nullptr)
+        {
+            std::cerr << "Missing value for " << argument << "\n";
+            printUsage();
+            return 2;
+        }
+
+        if (std::strcmp(argument, "--output") == 0)
+            options.outputPath = value;
+        else if (std::strcmp(argument, "--baseline") == 0)
+            options.baselinePath = value;
+        else if (std::strcmp(argument, "--threshold") == 0)
+            options.threshold = std::atof(value);
+        else if (std::strcmp(argument, "--repetitions") == 0)
+            options.repetitions = (size_t)std::max(1, std::atoi(value));
+        else if (std::strcmp(argument, "--min-time") == 0)
+            options.minRepetitionSeconds = std::atof(value);
+        else if (std::strcmp(argument, "--filter") == 0)
+            options.filter = value;
+        else
+        {
+            std::cerr << "Unknown option " << argument << "\n";
+            printUsage();
+            return 2;
+        }
+        i++;
+    }
+
+    BenchmarkSuite suite(options);
+    return suite.run();
+}
@@ -0,0 +1,168 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "IBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "../IdxFile.h"
+#include "../NeuralNetwork.h"
+#include "../Timer.h"
+
+/**
+ * \brief Trains the MNIST network from the same seed twice, once with 10 sigmoid outputs on the mean squared
+ * error and once with a softmax output on the cross-entropy, and reports how long each takes to reach a target
+ * test accuracy. Uses the MNIST dataset when it is in vendor/_mnist_dataset. Otherwise every digit is a noisy
+ * copy of one of 10 random prototype images, which is easier than MNIST but just as learnable for both setups.
+ */
+class BenchmarkTimeToAccuracy : public IBenchmark
+{
+public:
+    void Start() override
+    {
+        if (!loadMnist())
+            makePrototypeDigits();
+
+        std::cout << "Time to " << 100.0 * TARGET_ACCURACY << "% test accuracy, batches of " << BATCH_SIZE << ", "
+            << trainingLabels.size() << " training and " << testLabels.size() << " test images\n";
+
+        run("sigmoid + MSE", Sigmoid);
+        run("softmax + cross-entropy", Softmax);
+    }
+
+protected:
+    static constexpr double TARGET_ACCURACY = 0.9;
+    static constexpr size_t BATCH_SIZE = 32;
+    static constexpr size_t NUM_TRAINING = 10000;
+    static constexpr size_t NUM_TEST = 1000;
+    static constexpr size_t MAX_EPOCHS = 3;
+    static constexpr size_t PIXELS = 28 * 28;
+
+    // Test accuracy is checked after every this many batches, outside of the timed part
+    static constexpr size_t BATCHES_PER_CHECK = 10;
+
+    void run(const char* name, ActiviationFunction outputActivation)
+    {
+        NNConstructionInfo nnInfo = BenchmarkUtils::mnistTopology();
+        nnInfo.topology.back().activationFunction = outputActivation;
+        nnInfo.seed = 1234;
+        run(name, nnInfo);
+    }
+
+    /**
+     * \brief Train a network built from nnInfo until it reaches TARGET_ACCURACY or MAX_EPOCHS, and report the time.
+     */
+    void run(const char* name, const NNConstructionInfo& nnInfo)
+    {
+        NeuralNetwork network(nnInfo);
+
+        const size_t numBatches = trainingLabels.size() / BATCH_SIZE;
+        std::vector<double> targets(BATCH_SIZE * 10);
+
+        Timer timer;
+        double trainingSeconds = 0.0;
+        double accuracy = 0.0;
+        double confidence = 0.0;
+        size_t samples = 0;
+        bool reached = false;
+
+        for (size_t epoch = 0; epoch < MAX_EPOCHS && !reached; epoch++)
+        {
+            for (size_t batch = 0; batch < numBatches && !reached; batch++)
+            {
+                std::fill(targets.begin(), targets.end(), 0.0);
+                for (size_t b = 0; b < BATCH_SIZE; b++)
+                    targets[b * 10 + trainingLabels[batch * BATCH_SIZE + b]] = 1.0;
+
+                timer.Start();
+                network.trainBatch(trainingImages.data() + batch * BATCH_SIZE * PIXELS, targets.data(), BATCH_SIZE);
+                trainingSeconds += timer.Stop();
+                samples += BATCH_SIZE;
+
+                if ((batch + 1) % BATCHES_PER_CHECK == 0 || batch + 1 == numBatches)
+                {
+                    test(network, accuracy, confidence);
+                    reached = accuracy >= TARGET_ACCURACY;
+                }
+            }
+        }
+
+        std::cout << std::setw(24) << name << ": ";
+        if (reached)
+            std::cout << std::fixed << std::setprecision(2) << trainingSeconds << " seconds, " << samples << " samples";
+        else
+            std::cout << "not reached in " << MAX_EPOCHS << " epochs (" << std::fixed << std::setprecision(2) << trainingSeconds << " seconds)";
+        std::cout << ", test accuracy " << std::setprecision(1) << 100.0 * accuracy << "%, mean confidence "
+            << 100.0 * confidence << "%" << std::defaultfloat << "\n";
+    }
+
+    /**
+     * \brief Accuracy on the test set, and the mean output of the predicted digit.
+     */
+    void test(NeuralNetwork& network, double& accuracy, double& confidence)
+    {
+        std::vector<double> outputs(testLabels.size() * 10);
+        network.predictBatch(testImages.data(), testLabels.size(), outputs.data());
+
+        size_t correct = 0;
+        double confidenceSum = 0.0;
+        for (size_t i = 0; i < testLabels.size(); i++)
+        {
+            const double* result = outputs.data() + i * 10;
+            const double* best = std::max_element(result, result + 10);
+            if ((size_t)(best - result) == testLabels[i])
+                correct++;
+            confidenceSum += *best;
+        }
+
+        accuracy = (double)correct / testLabels.size();
+        confidence = confidenceSum / testLabels.size();
+    }
+
+    bool loadMnist()
+    {
+        const IdxFile trainingImageFile(MNIST_DATA_LOCATION + "/train-images-idx3-.ubyte");
+        const IdxFile trainingLabelFile(MNIST_DATA_LOCATION + "/train-labels-idx1-.ubyte");
+        const IdxFile testImageFile(MNIST_DATA_LOCATION + "/t10k-images-idx3-.ubyte");
+        const IdxFile testLabelFile(MNIST_DATA_LOCATION + "/t10k-labels-idx1-.ubyte");
+        if (!trainingImageFile.isOpen() || !trainingLabelFile.isOpen() || !testImageFile.isOpen() || !testLabelFile.isOpen())
+        {
+            std::cout << "No MNIST dataset in " << MNIST_DATA_LOCATION << ", using prototype digits\n";
+            return false;
+        }
+
+        load(trainingImageFile, trainingLabelFile, std::min(NUM_TRAINING, trainingImageFile.count()), trainingImages, trainingLabels);
+        load(testImageFile, testLabelFile, std::min(NUM_TEST, testImageFile.count()), testImages, testLabels);
+        return true;
+    }
+
+    static void load(const IdxFile& images, const IdxFile& labels, size_t count, std::vector<double>& pixels, std::vector<uint8_t>& digits)
+    {
+        pixels.resize(count * PIXELS);
+        digits.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const IdxFile::Span image = images.item(i);
+            for (size_t k = 0; k < PIXELS; k++)
+                pixels[i * PIXELS + k] = image[k] / 255.0;
+            digits[i] = labels.item(i)[0];
+        }
+    }
+
+    void makePrototypeDigits()
+    {
+        BenchmarkUtils::PrototypeDigits digits;
+        digits.generate(NUM_TRAINING, trainingImages, trainingLabels);
+        digits.generate(NUM_TEST, testImages, testLabels);
+    }
+
+    const std::string MNIST_DATA_LOCATION = "vendor/_mnist_dataset";
+
+    std::vector<double> trainingImages;
+    std::vector<uint8_t> trainingLabels;
+    std::vector<double> testImages;
+    std::vector<uint8_t> testLabels;
+};
@@ -0,0 +1,137 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../NNConstructionInfo.h"
+#include "../Timer.h"
+
+namespace BenchmarkUtils
+{
+    /**
+     * \brief Best time out of a few repetitions, after one warm-up run.
+     * \param prepare Runs before the warm-up and every repetition, outside of the timed part.
+     * \param warmUp false to time from the first run on, for code that should be measured cold.
+     */
+    template <typename Function, typename Prepare = void (*)()>
+    double bestOf(int repetitions, const Function& function, const Prepare& prepare = [] {}, bool warmUp = true)
+    {
+        if (warmUp)
+        {
+            prepare();
+            function();
+        }
+
+        double best = 1e30;
+        Timer timer;
+        for (int repetition = 0; repetition < repetitions; repetition++)
+        {
+            prepare();
+            timer.Start();
+            function();
+            best = std::min(best, timer.Stop());
+        }
+        return best;
+    }
+
+    /**
+     * \brief The 784->1568->1568->784->10 topology used by ExampleImageRecognition.
+     */
+    inline NNConstructionInfo mnistTopology()
+    {
+        NNConstructionInfo nnInfo(28 * 28, LayerInfo(10, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(28 * 28 * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(28 * 28 * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(28 * 28, 0.08, Sigmoid));
+        return nnInfo;
+    }
+
+    /**
+     * \brief Generate MNIST-shaped input data without needing the dataset on disk.
+     * Roughly 20% of the pixels are non-zero, which is about the same as real MNIST digits.
+     * \param count The number of images to generate.
+     * \param seed Seed for the generator, so every run benchmarks the same data.
+     */
+    inline std::vector<std::vector<double>> syntheticImages(size_t count, unsigned seed = 42)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> pixel(0.0, 1.0);
+        std::bernoulli_distribution inked(0.2);
+
+        std::vector<std::vector<double>> images(count, std::vector<double>(28 * 28, 0.0));
+        for (auto& image : images)
+        {
+            for (double& value : image)
+            {
+                if (inked(generator))
+                    value = pixel(generator);
+            }
+        }
+        return images;
+    }
+
+    /**
+     * \brief Generate one-hot target vectors to go with syntheticImages.
+     */
+    inline std::vector<std::vector<double>> syntheticLabels(size_t count, unsigned seed = 42)
+    {
+        std::mt19937 generator(seed + 1);
+        std::uniform_int_distribution<int> digit(0, 9);
+
+        std::vector<std::vector<double>> labels(count, std::vector<double>(10, 0.0));
+        for (auto& label : labels)
+            label[digit(generator)] = 1.0;
+        return labels;
+    }
+
+    /**
+     * \brief A learnable stand-in for MNIST when the dataset isn't on disk. Every digit is a noisy copy of one
+     * of 10 random prototype images, which is easier than MNIST but has to be learned the same way.
+     */
+    class PrototypeDigits
+    {
+    public:
+        explicit PrototypeDigits(unsigned seed = 7)
+            : generator(seed), prototypes(10, std::vector<double>(PIXELS, 0.0))
+        {
+            std::bernoulli_distribution inked(0.2);
+            for (std::vector<double>& prototype : prototypes)
+            {
+                for (double& value : prototype)
+                    value = inked(generator) ? pixel(generator) : 0.0;
+            }
+        }
+
+        /**
+         * \brief Copies of random prototypes with every pixel flipped between ink and background with a
+         * probability of 10%. Every call continues the sequence, so the training and test sets differ.
+         * \param pixels Receives count x 784 values, row-major.
+         * \param digits Receives the digit of every image.
+         */
+        void generate(size_t count, std::vector<double>& pixels, std::vector<uint8_t>& digits)
+        {
+            std::bernoulli_distribution flipped(0.1);
+            std::uniform_int_distribution<int> digit(0, 9);
+
+            pixels.resize(count * PIXELS);
+            digits.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                digits[i] = (uint8_t)digit(generator);
+                for (size_t k = 0; k < PIXELS; k++)
+                {
+                    const double value = prototypes[digits[i]][k];
+                    pixels[i * PIXELS + k] = flipped(generator) ? (value > 0.0 ? 0.0 : pixel(generator)) : value;
+                }
+            }
+        }
+
+        static constexpr size_t PIXELS = 28 * 28;
+
+    private:
+        std::mt19937 generator;
+        std::uniform_real_distribution<double> pixel{ 0.0, 1.0 };
+        std::vector<std::vector<double>> prototypes;
+    };
+}
@@ -0,0 +1,8 @@
+﻿#pragma once
+
+class IBenchmark
+{
+public:
+    virtual ~IBenchmark() = default;
+    virtual void Start() = 0;
+};
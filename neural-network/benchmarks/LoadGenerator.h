@@ -0,0 +1,111 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../InferenceServer.h"
+#include "../Timer.h"
+
+/**
+ * \brief Load generator for InferenceServer. Every client thread opens its own connection and sends
+ * requests in a closed loop, each one as soon as the answer to the last one is in, for a fixed time.
+ * Works against any server listening on the socket, in this process or another one. LoadGeneratorMain.cpp
+ * builds it into neural-network-loadgen, to load a server from outside its process.
+ */
+class LoadGenerator
+{
+public:
+    struct Result
+    {
+        size_t requests = 0;
+        size_t failures = 0;
+        double seconds = 0.0;
+        double p50Latency = 0.0; // Seconds
+        double p99Latency = 0.0; // Seconds
+        double maxLatency = 0.0; // Seconds
+
+        double requestsPerSecond() const { return seconds > 0.0 ? requests / seconds : 0.0; }
+    };
+
+    /**
+     * \param socketPath Where the server listens.
+     * \param inputs Samples to cycle through, numSamples x the server's input size.
+     * \param samplesPerRequest How many samples each request carries.
+     */
+    LoadGenerator(const std::string& socketPath, const std::vector<float>& inputs, size_t samplesPerRequest = 1)
+        : socketPath(socketPath), inputs(inputs), samplesPerRequest(samplesPerRequest)
+    {
+    }
+
+    /**
+     * \brief Run numClients clients for the given time, and gather the latency of every request they sent.
+     */
+    Result run(size_t numClients, double seconds)
+    {
+        std::vector<std::vector<double>> latencies(numClients);
+        std::atomic<size_t> failures(0);
+        std::atomic<bool> stop(false);
+
+        Timer duration;
+        std::vector<std::thread> clients;
+        for (size_t c = 0; c < numClients; c++)
+        {
+            clients.emplace_back([&, c]
+            {
+                InferenceClient client;
+                if (!client.connect(socketPath))
+                {
+                    failures++;
+                    return;
+                }
+
+                const size_t requestSize = samplesPerRequest * client.inputSize();
+                const size_t numRequests = std::max<size_t>(1, inputs.size() / requestSize);
+                std::vector<float> outputs(samplesPerRequest * client.outputSize());
+
+                Timer timer;
+                for (size_t i = c; !stop.load(std::memory_order_relaxed); i++)
+                {
+                    timer.Start();
+                    if (!client.predict(inputs.data() + (i % numRequests) * requestSize, samplesPerRequest, outputs.data()))
+                    {
+                        failures++;
+                        return;
+                    }
+                    latencies[c].push_back(timer.Stop());
+                }
+            });
+        }
+
+        while (duration.Stop() < seconds)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        stop = true;
+        for (std::thread& client : clients)
+            client.join();
+
+        Result result;
+        result.seconds = duration.Stop();
+        result.failures = failures;
+
+        std::vector<double> all;
+        for (const std::vector<double>& clientLatencies : latencies)
+            all.insert(all.end(), clientLatencies.begin(), clientLatencies.end());
+        std::sort(all.begin(), all.end());
+        result.requests = all.size();
+        if (!all.empty())
+        {
+            result.p50Latency = all[all.size() / 2];
+            result.p99Latency = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+            result.maxLatency = all.back();
+        }
+        return result;
+    }
+
+protected:
+    std::string socketPath;
+    std::vector<float> inputs;
+    size_t samplesPerRequest;
+};
@@ -0,0 +1,116 @@
+﻿#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "LoadGenerator.h"
+
+/*
+ * LoadGenerator as its own executable, built by CMakeLists.txt, to load an InferenceServer running in another process.
+ *
+ *   neural-network-loadgen --socket nn-inference.sock [--clients 32] [--seconds 2] [--samples 1]
+ *
+ * The requests carry random values in [0, 1), sized for the network the server reports. Prints the throughput and
+ * the client-side latencies. Exits with 1 if a client failed, 2 on bad arguments or if the server can't be reached.
+ */
+namespace
+{
+    // Distinct requests every client cycles through
+    constexpr size_t NUM_REQUESTS = 64;
+
+    void printUsage()
+    {
+        std::cerr << "Usage: neural-network-loadgen --socket PATH [--clients N] [--seconds SECONDS] [--samples N]\n"
+            "  --socket   Where the server listens\n"
+            "  --clients  Connections sending requests at the same time (default 32)\n"
+            "  --seconds  How long to send requests for (default 2)\n"
+            "  --samples  Samples per request (default 1)\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string socketPath;
+    size_t numClients = 32;
+    double seconds = 2.0;
+    size_t samplesPerRequest = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argument, "--help") == 0 || std::strcmp(argument, "-h") == 0)
+        {
+            printUsage();
+            return 0;
+        }
+        if (value == nullptr)
+        {
+            std::cerr << "Missing value for " << argument << "\n";
+            printUsage();
+            return 2;
+        }
+
+        if (std::strcmp(argument, "--socket") == 0)
+            socketPath = value;
+        else if (std::strcmp(argument, "--clients") == 0)
+            numClients = (size_t)std::max(1, std::atoi(value));
+        else if (std::strcmp(argument, "--seconds") == 0)
+            seconds = std::atof(value);
+        else if (std::strcmp(argument, "--samples") == 0)
+            samplesPerRequest = (size_t)std::max(1, std::atoi(value));
+        else
+        {
+            std::cerr << "Unknown option " << argument << "\n";
+            printUsage();
+            return 2;
+        }
+        i++;
+    }
+
+    if (socketPath.empty())
+    {
+        std::cerr << "Missing --socket\n";
+        printUsage();
+        return 2;
+    }
+    if (samplesPerRequest > InferenceProtocol::MAX_REQUEST_SAMPLES)
+    {
+        std::cerr << "The server rejects requests with more than " << InferenceProtocol::MAX_REQUEST_SAMPLES << " samples\n";
+        return 2;
+    }
+
+    // Only to learn the network's input size
+    size_t inputSize;
+    {
+        InferenceClient client;
+        if (!client.connect(socketPath))
+        {
+            std::cerr << "Couldn't reach a server on " << socketPath << "\n";
+            return 2;
+        }
+        inputSize = client.inputSize();
+    }
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<float> inputs(NUM_REQUESTS * samplesPerRequest * inputSize);
+    for (float& input : inputs)
+        input = distribution(generator);
+
+    std::cout << numClients << " clients sending " << samplesPerRequest << " samples per request to " << socketPath
+        << " for " << seconds << " seconds\n";
+    const LoadGenerator::Result result = LoadGenerator(socketPath, inputs, samplesPerRequest).run(numClients, seconds);
+
+    std::cout << std::fixed << std::setprecision(0) << result.requestsPerSecond() << " requests/sec, "
+        << result.requestsPerSecond() * samplesPerRequest << " samples/sec, latency p50 " << std::setprecision(2)
+        << result.p50Latency * 1000.0 << " ms, p99 " << result.p99Latency * 1000.0 << " ms, max "
+        << result.maxLatency * 1000.0 << " ms" << std::defaultfloat;
+    if (result.failures > 0)
+        std::cout << ", " << result.failures << " FAILED clients";
+    std::cout << "\n";
+    return result.failures > 0 ? 1 : 0;
+}
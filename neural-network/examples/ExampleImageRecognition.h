@@ -1,10 +1,19 @@
 ﻿#pragma once
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <vector>
 
 #include "ITrainingExample.h"
+#include "../BatchPrefetcher.h"
+#include "../Checkpoint.h"
+#include "../DataParallelTrainer.h"
+#include "../IdxFile.h"
+#include "../MagnitudePruner.h"
+#include "../MappedNetwork.h"
 #include "../NeuralNetwork.h"
+#include "../QuantizedNetwork.h"
+#include "../SparseNetwork.h"
 #include "../Timer.h"
 #include "vendor/termcolor.hpp"
 #include "vendor/mnist_sdk/mnist_reader.hpp"
@@ -25,8 +34,9 @@ typedef mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> MNIST;
         mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
             mnist::read_dataset<std::vector, std::vector, uint8_t, uint8_t>(MNIST_DATA_LOCATION);
 
-        // Settings for input & output layer
-        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Sigmoid));
+        // Settings for input & output layer. Softmax turns the outputs into probabilities for each digit,
+        // and trains on the cross-entropy, which converges a lot faster than sigmoid outputs on the MSE.
+        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Softmax));
 
         // Hidden layers, num neurons usually 2x input layer
         nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
@@ -37,12 +47,15 @@ typedef mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> MNIST;
         Timer timer;
         timer.Start();
 
+        // Reused for every image, so training doesn't allocate anything per image
+        std::vector<double> inputs(IMAGE_PIXEL_SIZE*IMAGE_PIXEL_SIZE, 0);
+        std::vector<double> outputs(10, 0);
+        std::vector<double> prediction(10, 0);
+
         // For each image in the training set
         for (size_t i = 0; i < 10000/*dataset.training_images.size()*/; i++)
         {
-            // For some reason this is much faster then reserving the size
-            std::vector<double> inputs(IMAGE_PIXEL_SIZE*IMAGE_PIXEL_SIZE, 0);
-            std::vector<double> outputs(10, 0);
+            std::fill(outputs.begin(), outputs.end(), 0.0);
 
             // Prepare the input to the neural network
             for (size_t k = 0; k < IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE; k++)
@@ -57,13 +70,16 @@ typedef mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> MNIST;
             outputs[dataset.training_labels[i]] = 1;
 
             // Train the network
-            nn.forwardPropagate(inputs);
-            double MSE = nn.backPropagate(inputs, outputs);
+            nn.forwardPropagate(inputs.data(), prediction.data());
+            double loss = nn.backPropagate(inputs, outputs);
 
-            if (i % 10 == 0) std::cout << "Trained on " << i << " images. MSE: " << MSE << "\n";
+            if (i % 10 == 0) std::cout << "Trained on " << i << " images. Cross-entropy: " << loss << "\n";
         }
         
         std::cout << "Training took " << timer.Stop() << " seconds.\n";
+
+        if (Checkpoint::save(nn, CHECKPOINT_LOCATION))
+            std::cout << "Saved the network to " << CHECKPOINT_LOCATION << "\n";
         
         testResult(nn, dataset, 200);
         testResult(nn, dataset, 5789);
@@ -71,6 +87,369 @@ typedef mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> MNIST;
         testResult(nn, dataset, 377);
     }
     
+    /**
+     * \brief Skip training and test the network that run saved, straight from the memory-mapped checkpoint.
+     */
+    void runFromCheckpoint() const
+    {
+        mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
+            mnist::read_dataset<std::vector, std::vector, uint8_t, uint8_t>(MNIST_DATA_LOCATION);
+
+        Timer timer;
+        timer.Start();
+        MappedNetwork<double> nn(CHECKPOINT_LOCATION);
+        if (!nn.isOpen())
+        {
+            std::cout << "No network at " << CHECKPOINT_LOCATION << ", run trains one and saves it there.\n";
+            return;
+        }
+        std::cout << "Loading the network took " << timer.Stop() << " seconds.\n";
+
+        const size_t numTests = std::min<size_t>(1000, dataset.test_images.size());
+        size_t correct = 0;
+        std::vector<double> image(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+        std::vector<double> results(10);
+        for (size_t i = 0; i < numTests; i++)
+        {
+            loadImage(dataset.test_images, i, image.data());
+            nn.predict(image.data(), results.data());
+            if ((size_t)(std::max_element(results.begin(), results.end()) - results.begin()) == dataset.test_labels[i])
+                correct++;
+        }
+        std::cout << "Test accuracy " << 100.0 * correct / numTests << "%\n";
+    }
+
+    /**
+     * \brief Same network and data as run, but trained in mini-batches spread over every core.
+     */
+    void runDataParallel() const
+    {
+        mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
+            mnist::read_dataset<std::vector, std::vector, uint8_t, uint8_t>(MNIST_DATA_LOCATION);
+
+        // Settings for input & output layer
+        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Sigmoid));
+
+        // Hidden layers, num neurons usually 2x input layer
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, 0.08, Sigmoid));
+
+        NeuralNetwork nn(nnInfo);
+        DataParallelTrainer trainer(nn);
+
+        // Prepare the whole training set up front, the trainer splits it into batches
+        std::vector<std::vector<double>> inputs;
+        std::vector<std::vector<double>> outputs;
+        for (size_t i = 0; i < 10000/*dataset.training_images.size()*/; i++)
+        {
+            inputs.push_back(loadImage(dataset, i));
+            outputs.emplace_back(10, 0);
+            outputs.back()[dataset.training_labels[i]] = 1;
+        }
+
+        Timer timer;
+        timer.Start();
+
+        const size_t batchSize = 32;
+        const size_t batchesPerReport = 10;
+        for (size_t first = 0; first < inputs.size(); first += batchSize * batchesPerReport)
+        {
+            const size_t last = std::min(first + batchSize * batchesPerReport, inputs.size());
+            std::vector<std::vector<double>> chunkInputs(inputs.begin() + first, inputs.begin() + last);
+            std::vector<std::vector<double>> chunkOutputs(outputs.begin() + first, outputs.begin() + last);
+
+            double MSE = trainer.train(chunkInputs, chunkOutputs, batchSize);
+            std::cout << "Trained on " << last << " images using " << trainer.threadCount() << " threads. MSE: " << MSE << "\n";
+        }
+
+        std::cout << "Training took " << timer.Stop() << " seconds.\n";
+
+        testResult(nn, dataset, 200);
+        testResult(nn, dataset, 5789);
+        testResult(nn, dataset, 2);
+        testResult(nn, dataset, 377);
+    }
+
+    /**
+     * \brief Same network and data as run, but the batches stream straight out of the memory-mapped IDX files.
+     * A background thread prepares the next batch while the current one trains, so the dataset is never loaded
+     * into memory as a whole, and converting it doesn't hold up training.
+     */
+    void runStreaming() const
+    {
+        const IdxFile trainingImages(MNIST_DATA_LOCATION + "/train-images-idx3-.ubyte");
+        const IdxFile trainingLabels(MNIST_DATA_LOCATION + "/train-labels-idx1-.ubyte");
+        const IdxFile testImages(MNIST_DATA_LOCATION + "/t10k-images-idx3-.ubyte");
+        const IdxFile testLabels(MNIST_DATA_LOCATION + "/t10k-labels-idx1-.ubyte");
+        if (!trainingImages.isOpen() || !trainingLabels.isOpen() || !testImages.isOpen() || !testLabels.isOpen())
+            return;
+
+        // Settings for input & output layer
+        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Sigmoid));
+
+        // Hidden layers, num neurons usually 2x input layer
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, 0.08, Sigmoid));
+
+        NeuralNetwork nn(nnInfo);
+        BatchPrefetcher<double> batches(trainingImages, trainingLabels, 32, 10, 10000/*trainingImages.count()*/);
+        if (!batches.isValid())
+            return;
+
+        Timer timer;
+        Timer waitTimer;
+        double waiting = 0.0;
+        size_t trained = 0;
+        for (size_t i = 0; i < batches.batchesPerEpoch(); i++)
+        {
+            waitTimer.Start();
+            const BatchPrefetcher<double>::Batch batch = batches.next();
+            waiting += waitTimer.Stop();
+
+            double MSE = nn.trainBatch(batch.inputs, batch.targetOutputs, batch.size);
+            trained += batch.size;
+
+            if (i % 10 == 0) std::cout << "Trained on " << trained << " images. MSE: " << MSE << "\n";
+        }
+
+        std::cout << "Training took " << timer.Stop() << " seconds, " << waiting << " of them waiting for data.\n";
+
+        const size_t numTests = std::min<size_t>(1000, testImages.count());
+        size_t correct = 0;
+        std::vector<double> image(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+        std::vector<double> results(10);
+        for (size_t i = 0; i < numTests; i++)
+        {
+            const IdxFile::Span pixels = testImages.item(i);
+            for (size_t k = 0; k < pixels.size; k++)
+                image[k] = pixels[k] / 255.0;
+
+            nn.predict(image.data(), results.data());
+            if ((size_t)(std::max_element(results.begin(), results.end()) - results.begin()) == testLabels.item(i)[0])
+                correct++;
+        }
+        std::cout << "Test accuracy " << 100.0 * correct / numTests << "%\n";
+    }
+
+    /**
+     * \brief Train the same network in double and in float precision, from the same seed and on the same
+     * images, and compare training speed and accuracy on the test set.
+     */
+    void runPrecisionComparison() const
+    {
+        mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
+            mnist::read_dataset<std::vector, std::vector, uint8_t, uint8_t>(MNIST_DATA_LOCATION);
+
+        trainAndTest<double>("double", dataset);
+        trainAndTest<float>("float", dataset);
+    }
+
+    template <typename Scalar>
+    void trainAndTest(const char* precisionName, const MNIST& dataset) const
+    {
+        // Settings for input & output layer
+        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Sigmoid));
+
+        // Hidden layers, num neurons usually 2x input layer
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, 0.08, Sigmoid));
+        nnInfo.seed = 1234;
+
+        BasicNeuralNetwork<Scalar> nn(nnInfo);
+
+        std::vector<std::vector<Scalar>> inputs;
+        std::vector<std::vector<Scalar>> outputs;
+        for (size_t i = 0; i < 10000/*dataset.training_images.size()*/; i++)
+        {
+            inputs.push_back(loadImage<Scalar>(dataset.training_images, i));
+            outputs.emplace_back(10, Scalar(0));
+            outputs.back()[dataset.training_labels[i]] = 1;
+        }
+
+        Timer timer;
+        timer.Start();
+        nn.trainBatch(inputs, outputs, 32);
+        const double trainingSeconds = timer.Stop();
+
+        const size_t numTests = std::min<size_t>(1000, dataset.test_images.size());
+        size_t correct = 0;
+        std::vector<Scalar> image(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+        std::vector<Scalar> results(10);
+        timer.Start();
+        for (size_t i = 0; i < numTests; i++)
+        {
+            // Reuse the same buffers for every image, so the loop doesn't allocate
+            loadImage(dataset.test_images, i, image.data());
+            nn.predict(image.data(), results.data());
+            const size_t predicted = std::max_element(results.begin(), results.end()) - results.begin();
+            if (predicted == dataset.test_labels[i])
+                correct++;
+        }
+        const double predictionSeconds = timer.Stop();
+
+        std::cout << std::setw(6) << precisionName << ": trained on " << inputs.size() << " images in " << trainingSeconds
+            << " seconds, " << numTests / predictionSeconds << " predictions/sec, test accuracy "
+            << 100.0 * correct / numTests << "%\n";
+    }
+
+    /**
+     * \brief Train a network, quantize it to int8 and compare the accuracy, latency and size of the two
+     * on the test set.
+     */
+    void runQuantized() const
+    {
+        mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
+            mnist::read_dataset<std::vector, std::vector, uint8_t, uint8_t>(MNIST_DATA_LOCATION);
+
+        // Settings for input & output layer
+        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Sigmoid));
+
+        // Hidden layers, num neurons usually 2x input layer
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, 0.08, Sigmoid));
+
+        NeuralNetwork nn(nnInfo);
+
+        std::vector<std::vector<double>> inputs;
+        std::vector<std::vector<double>> outputs;
+        for (size_t i = 0; i < 10000/*dataset.training_images.size()*/; i++)
+        {
+            inputs.push_back(loadImage(dataset, i));
+            outputs.emplace_back(10, 0);
+            outputs.back()[dataset.training_labels[i]] = 1;
+        }
+        nn.trainBatch(inputs, outputs, 32);
+
+        // Calibrate on a slice of the training set, never on the test set
+        const std::vector<std::vector<double>> calibration(inputs.begin(), inputs.begin() + 500);
+        Timer timer;
+        timer.Start();
+        QuantizedNetwork quantized(nn, calibration);
+        std::cout << "Quantization took " << timer.Stop() << " seconds.\n";
+
+        const size_t numTests = std::min<size_t>(1000, dataset.test_images.size());
+        std::vector<std::vector<double>> testImages;
+        for (size_t i = 0; i < numTests; i++)
+            testImages.push_back(loadImage<double>(dataset.test_images, i));
+
+        size_t correct = 0;
+        std::vector<double> results(10);
+        timer.Start();
+        for (size_t i = 0; i < numTests; i++)
+        {
+            nn.predict(testImages[i].data(), results.data());
+            if ((size_t)(std::max_element(results.begin(), results.end()) - results.begin()) == dataset.test_labels[i])
+                correct++;
+        }
+        const double doubleSeconds = timer.Stop();
+
+        size_t quantizedCorrect = 0;
+        std::vector<float> quantizedResults(10);
+        timer.Start();
+        for (size_t i = 0; i < numTests; i++)
+        {
+            quantized.predict(testImages[i].data(), quantizedResults.data());
+            if ((size_t)(std::max_element(quantizedResults.begin(), quantizedResults.end()) - quantizedResults.begin()) == dataset.test_labels[i])
+                quantizedCorrect++;
+        }
+        const double quantizedSeconds = timer.Stop();
+
+        size_t doubleSize = 0;
+        for (const NetworkLayer<double>& layer : nn.layers())
+            doubleSize += (layer.weights.size() + layer.biases.size()) * sizeof(double);
+
+        std::cout << "double: accuracy " << 100.0 * correct / numTests << "%, " << 1e6 * doubleSeconds / numTests
+            << " us per prediction, " << doubleSize / 1024 << " KiB\n";
+        std::cout << "  int8: accuracy " << 100.0 * quantizedCorrect / numTests << "%, " << 1e6 * quantizedSeconds / numTests
+            << " us per prediction, " << quantized.modelSize() / 1024 << " KiB\n";
+        std::cout << "Accuracy delta " << 100.0 * ((double)quantizedCorrect - (double)correct) / numTests
+            << " points, " << doubleSeconds / quantizedSeconds << "x the throughput\n";
+    }
+
+    /**
+     * \brief Train a network, then prune it to a range of sparsities and compare the accuracy before and after
+     * fine-tuning, the latency and the size of the sparse network with the dense one.
+     */
+    void runPruned() const
+    {
+        mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
+            mnist::read_dataset<std::vector, std::vector, uint8_t, uint8_t>(MNIST_DATA_LOCATION);
+
+        // Settings for input & output layer
+        NNConstructionInfo nnInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, LayerInfo(10, 0.08, Sigmoid));
+
+        // Hidden layers, num neurons usually 2x input layer
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE * 2, 0.08, Sigmoid));
+        nnInfo.addHiddenLayer(LayerInfo(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, 0.08, Sigmoid));
+
+        NeuralNetwork nn(nnInfo);
+
+        std::vector<std::vector<double>> inputs;
+        std::vector<std::vector<double>> outputs;
+        for (size_t i = 0; i < 10000/*dataset.training_images.size()*/; i++)
+        {
+            inputs.push_back(loadImage(dataset, i));
+            outputs.emplace_back(10, 0);
+            outputs.back()[dataset.training_labels[i]] = 1;
+        }
+        nn.trainBatch(inputs, outputs, 32);
+
+        // Fine-tune on a slice of the training set
+        const std::vector<std::vector<double>> fineTuneInputs(inputs.begin(), inputs.begin() + 2000);
+        const std::vector<std::vector<double>> fineTuneOutputs(outputs.begin(), outputs.begin() + 2000);
+
+        const size_t numTests = std::min<size_t>(1000, dataset.test_images.size());
+        std::vector<double> testInputs(numTests * IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+        for (size_t i = 0; i < numTests; i++)
+            loadImage(dataset.test_images, i, testInputs.data() + i * IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+
+        // Accuracy on the test set, and microseconds per single-sample prediction
+        auto test = [&](auto& network, double& microseconds)
+        {
+            std::vector<double> results(10);
+            size_t correct = 0;
+            Timer timer;
+            for (size_t i = 0; i < numTests; i++)
+            {
+                network.predict(testInputs.data() + i * IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE, results.data());
+                if ((size_t)(std::max_element(results.begin(), results.end()) - results.begin()) == dataset.test_labels[i])
+                    correct++;
+            }
+            microseconds = 1e6 * timer.Stop() / numTests;
+            return 100.0 * correct / numTests;
+        };
+
+        double denseMicroseconds;
+        const double denseAccuracy = test(nn, denseMicroseconds);
+        const SparseNetwork<double> denseCopy(nn, 0.0);
+        std::cout << "  dense: accuracy " << denseAccuracy << "%, " << denseMicroseconds << " us per prediction, "
+            << denseCopy.modelSize() / 1024 << " KiB\n";
+
+        for (double sparsity : { 0.5, 0.8, 0.9, 0.95, 0.98 })
+        {
+            NeuralNetwork pruned = nn;
+            MagnitudePruner<double> pruner(pruned);
+            pruner.pruneToSparsity(sparsity);
+
+            double microseconds;
+            const double prunedAccuracy = test(pruned, microseconds);
+            pruner.fineTune(fineTuneInputs, fineTuneOutputs, 32);
+
+            SparseNetwork<double> sparse(pruned);
+            const double fineTunedAccuracy = test(sparse, microseconds);
+
+            std::cout << std::setw(5) << 100.0 * pruner.sparsity() << "% pruned: accuracy " << prunedAccuracy << "%, "
+                << fineTunedAccuracy << "% fine-tuned, " << microseconds << " us per prediction ("
+                << denseMicroseconds / microseconds << "x), " << sparse.modelSize() / 1024 << " KiB, "
+                << sparse.numSparseLayers() << " sparse layers\n";
+        }
+    }
+
     void runVerbose() const
     {
         mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> dataset =
@@ -145,17 +524,29 @@ typedef mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> MNIST;
     
     std::vector<double> loadImage(const MNIST& dataset, size_t index) const
     {
-        std::vector<double> inputs;
-        inputs.reserve(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+        return loadImage<double>(dataset.training_images, index);
+    }
 
+    template <typename Scalar>
+    std::vector<Scalar> loadImage(const std::vector<std::vector<uint8_t>>& images, size_t index) const
+    {
+        std::vector<Scalar> inputs(IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE);
+        loadImage(images, index, inputs.data());
+        return inputs;
+    }
+
+    /**
+     * \brief Load an image into a buffer owned by the caller, with room for IMAGE_PIXEL_SIZE^2 values.
+     */
+    template <typename Scalar>
+    void loadImage(const std::vector<std::vector<uint8_t>>& images, size_t index, Scalar* inputs) const
+    {
+        const std::vector<uint8_t>& image = images.at(index);
         for (size_t k = 0; k < IMAGE_PIXEL_SIZE * IMAGE_PIXEL_SIZE; k++)
         {
             // Normalize the value for each pixel to between 0 - 1
-            double pixelValue = (unsigned)(dataset.training_images.at(index).at(k)) / 255.0;
-            inputs.push_back(pixelValue);
+            inputs[k] = (unsigned)(image.at(k)) / Scalar(255);
         }
-
-        return inputs;
     }
     
     void testResult(NeuralNetwork& nn, const MNIST& dataset, size_t index) const
@@ -186,5 +577,6 @@ typedef mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> MNIST;
     }
     
     const std::string MNIST_DATA_LOCATION = "vendor/_mnist_dataset";
+    const std::string CHECKPOINT_LOCATION = "mnist.nnck";
     const size_t IMAGE_PIXEL_SIZE = 28;
 };
@@ -7,6 +7,28 @@
 #include "NeuralNetwork.h"
 #include "examples/ExampleImageRecognition.h"
 #include "examples/ExampleXOR.h"
+#include "benchmarks/BenchmarkActivations.h"
+#include "benchmarks/BenchmarkArena.h"
+#include "benchmarks/BenchmarkBatchPredict.h"
+#include "benchmarks/BenchmarkCheckpoint.h"
+#include "benchmarks/BenchmarkConstruction.h"
+#include "benchmarks/BenchmarkConvolution.h"
+#include "benchmarks/BenchmarkDataLoading.h"
+#include "benchmarks/BenchmarkDataParallel.h"
+#include "benchmarks/BenchmarkHogwild.h"
+#include "benchmarks/BenchmarkInferenceServer.h"
+#include "benchmarks/BenchmarkIntraLayer.h"
+#include "benchmarks/BenchmarkKernels.h"
+#include "benchmarks/BenchmarkLayerLayout.h"
+#include "benchmarks/BenchmarkMiniBatch.h"
+#include "benchmarks/BenchmarkOptimizers.h"
+#include "benchmarks/BenchmarkPredictLatency.h"
+#include "benchmarks/BenchmarkProfile.h"
+#include "benchmarks/BenchmarkServing.h"
+#include "benchmarks/BenchmarkSparseInput.h"
+#include "benchmarks/BenchmarkStaticNetwork.h"
+#include "benchmarks/BenchmarkSuite.h"
+#include "benchmarks/BenchmarkTimeToAccuracy.h"
 
 
 
@@ -19,6 +41,72 @@ int main()
     /*ExampleXOR exampleXOR;
     exampleXOR.Start();*/
 
+    /*BenchmarkLayerLayout benchmarkLayerLayout;
+    benchmarkLayerLayout.Start();*/
+
+    /*BenchmarkMiniBatch benchmarkMiniBatch;
+    benchmarkMiniBatch.Start();*/
+
+    /*BenchmarkKernels benchmarkKernels;
+    benchmarkKernels.Start();*/
+
+    /*BenchmarkDataParallel benchmarkDataParallel;
+    benchmarkDataParallel.Start();*/
+
+    /*BenchmarkIntraLayer benchmarkIntraLayer;
+    benchmarkIntraLayer.Start();*/
+
+    /*BenchmarkPredictLatency benchmarkPredictLatency;
+    benchmarkPredictLatency.Start();*/
+
+    /*BenchmarkBatchPredict benchmarkBatchPredict;
+    benchmarkBatchPredict.Start();*/
+
+    /*BenchmarkCheckpoint benchmarkCheckpoint;
+    benchmarkCheckpoint.Start();*/
+
+    /*BenchmarkDataLoading benchmarkDataLoading;
+    benchmarkDataLoading.Start();*/
+
+    /*BenchmarkSparseInput benchmarkSparseInput;
+    benchmarkSparseInput.Start();*/
+
+    /*BenchmarkActivations benchmarkActivations;
+    benchmarkActivations.Start();*/
+
+    /*BenchmarkTimeToAccuracy benchmarkTimeToAccuracy;
+    benchmarkTimeToAccuracy.Start();*/
+
+    /*BenchmarkHogwild benchmarkHogwild;
+    benchmarkHogwild.Start();*/
+
+    /*BenchmarkServing benchmarkServing;
+    benchmarkServing.Start();*/
+
+    /*BenchmarkConstruction benchmarkConstruction;
+    benchmarkConstruction.Start();*/
+
+    /*BenchmarkInferenceServer benchmarkInferenceServer;
+    benchmarkInferenceServer.Start();*/
+
+    /*BenchmarkProfile benchmarkProfile;
+    benchmarkProfile.Start();*/
+
+    /*BenchmarkStaticNetwork benchmarkStaticNetwork;
+    benchmarkStaticNetwork.Start();*/
+
+    /*BenchmarkConvolution benchmarkConvolution;
+    benchmarkConvolution.Start();*/
+
+    /*BenchmarkOptimizers benchmarkOptimizers;
+    benchmarkOptimizers.Start();*/
+
+    /*BenchmarkSuite benchmarkSuite;
+    benchmarkSuite.Start();*/
+
+    /*BenchmarkArena benchmarkArena;
+    benchmarkArena.Start();*/
+
     ExampleImageRecognition exampleImageRecognition;
     exampleImageRecognition.Start();
     